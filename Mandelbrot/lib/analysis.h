@@ -0,0 +1,61 @@
+#ifndef ANALYSIS_H
+#define ANALYSIS_H
+
+#include <stdint.h>
+#include "fractal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The set lies in this box; only the upper half is sampled and doubled,
+// since the set is symmetric about the real axis
+#define AREA_X_MIN -2.0
+#define AREA_X_MAX 0.5
+#define AREA_Y_MAX 1.25
+#define AREA_BUCKETS 32          // escape-time histogram, bucket k holds counts in [2^k, 2^(k+1))
+#define AREA_CHUNK 65536         // samples per task, each with its own RNG stream
+#define AREA_BAND 32             // pixel rows per task when counting pixels
+#define AREA_Z95 1.959963984540054
+
+typedef struct {
+    int max_iter;
+    int strata;                  // stratum rows; the upper half box gets 2 * strata columns
+    uint64_t samples;            // Monte Carlo samples in total
+    double pilot;                // share of samples spread evenly before the rest is allocated
+    uint64_t seed;
+} AreaParams;
+
+typedef struct {
+    double area;                 // both halves
+    double std_error;            // Monte Carlo only, 0 for pixel counting
+    double low, high;            // 95% confidence interval, or the boundary-pixel bracket
+    double undecided_area;       // reached max_iter without being proven interior:
+                                 // the estimate is high by at most about this much
+    double escape_area[AREA_BUCKETS]; // area of the box escaping in each bucket
+    double mean_escape;          // area-weighted mean escape count of escaping points
+    uint64_t samples;            // points evaluated
+    uint64_t interior;           // of those, counted as members
+    uint64_t boundary;           // pixel counting: pixels with a neighbour of the other kind
+    double seconds;
+} AreaEstimate;
+
+// Stratified Monte Carlo: the box is cut into strata, a pilot share of the
+// samples is spread evenly to estimate each stratum's membership p, and the
+// rest goes out in proportion to sqrt(p(1-p)) (Neyman allocation), so
+// strata wholly inside or outside the set cost almost nothing. Samples run
+// in AREA_CHUNK tasks with counter-based seeds, so the result does not depend
+// on the thread count. strata = 1 is plain Monte Carlo. Returns 1 on success.
+int estimate_area_monte_carlo(const AreaParams *params, AreaEstimate *out);
+
+// Pixel counting: evaluates pixel centers on a grid with resolution pixels
+// per unit and counts the interior ones. The bracket [low, high] moves every
+// boundary pixel to the other side, a heuristic error bound that shrinks
+// with resolution. Returns 1 on success.
+int estimate_area_pixels(int resolution, int max_iter, AreaEstimate *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
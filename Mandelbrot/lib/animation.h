@@ -0,0 +1,66 @@
+#ifndef ANIMATION_H
+#define ANIMATION_H
+
+#include "fractal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ANIM_ENCODERS 2  // default color/encode threads
+
+typedef struct {
+    int frame;        // position in the output sequence, increasing
+    double center_x, center_y, scale;
+    int max_iter;
+} AnimKey;
+
+typedef struct {
+    int width, height;
+    int palette;
+    int format, level;   // image_io format and PNG level for frame files
+    const char *prefix;  // frames go to <prefix>_00000.<ext>; NULL streams raw RGB24 to stdout
+    const char *shm_name; // if set, frames are published to a shm_ring.h ring instead
+    int encoders;        // 0 = ANIM_ENCODERS
+} AnimOptions;
+
+typedef struct {
+    int frames;
+    double prepare_time; // exp-map strip and center render, before the first frame
+    double render_time;  // time the render stage was busy
+    double total_time;
+} AnimStats;
+
+// Reads "frame center_x center_y scale max_iter" lines ('#' starts a comment).
+// The returned array is owned by the caller (free()). Returns 1 on success.
+int anim_load_keys(const char *path, AnimKey **keys, int *count);
+
+// View for a frame between keyframes: scale is interpolated geometrically
+// (constant zoom speed) and the center in step with the scale, so the
+// target point stays put on screen while zooming
+void anim_view_at(const AnimKey *keys, int count, int frame, FractalView *view);
+
+// Renders frames keys[0].frame .. keys[count-1].frame. The calling thread
+// renders iteration counts with the parallel engine into a small ring of
+// buffers while encoder threads colorize and write earlier frames, so frame
+// N+1 renders while frame N is encoded. Raw output keeps frame order.
+int render_animation(const AnimKey *keys, int count, const AnimOptions *opt, AnimStats *stats);
+
+// Same output, rendered as an exponential map: one log-polar strip around the
+// last keyframe's center covers every radius from the inner disc of the
+// deepest frame to the corners of the widest, plus one full render at the
+// deepest scale for that disc. Each frame is then a bilinear resample. The
+// strip is 2*pi*half_diagonal columns by about ln(zoom * half_diagonal /
+// half_short_side) / step rows, step = 2*pi / columns: for 16:9 frames about
+// 3.7 * (ln(zoom) + 0.7) frames' worth of pixels at any resolution, e.g.
+// 4614 x 10672 = 49 Mpx, 53 frames' worth, for 1280x720 at a 1e6 zoom.
+// It pays off when the zoom has more frames than that. Only pure zooms fit:
+// earlier keyframe centers are ignored and every frame uses the largest
+// max_iter.
+int render_animation_expmap(const AnimKey *keys, int count, const AnimOptions *opt, AnimStats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef BUDDHABROT_H
+#define BUDDHABROT_H
+
+#include <stdint.h>
+#include "fractal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BUDDHA_CHUNK 16384            // samples per task, each with its own RNG stream
+#define BUDDHA_GRID_X 512             // importance map cells over c in [-2, 2] x [0, 2]
+#define BUDDHA_GRID_Y 256
+#define BUDDHA_PROBE 4                // probe points per cell edge
+#define BUDDHA_HIST_BUDGET (1u << 30) // bytes of per-thread histograms before switching to atomics
+
+typedef struct {
+    int width, height;
+    double center_x, center_y, scale; // window the orbits are plotted in, as in FractalView
+    int min_iter, max_iter;           // orbits escaping after [min_iter, max_iter) steps are traced
+    int anti;                         // anti-Buddhabrot: trace orbits that never escape instead
+    uint64_t samples;
+    uint64_t seed;
+} BuddhaParams;
+
+typedef struct {
+    uint64_t samples;                 // c values drawn so far
+    uint64_t orbits;                  // orbits that were traced
+    uint64_t hits;                    // orbit points that landed in the frame
+    double active_fraction;           // share of the c domain the importance map samples
+    int atomics;                      // 1 if threads added straight into the shared buffer
+    double map_time, total_time;
+} BuddhaStats;
+
+// Called between rounds with the density so far; return 0 to stop early
+typedef int (*BuddhaProgressFn)(const uint64_t *density, const BuddhaStats *stats, void *user);
+
+// Accumulates orbit hit counts into density (width * height, zeroed here).
+// c is drawn uniformly from the cells of a coarse importance map whose probe
+// points showed contributing orbits (plus their neighbours), so samples are
+// not wasted deep inside the set or far outside it; the map covers the upper
+// half plane and every orbit is also plotted mirrored, which is exact because
+// conj(c) has the conjugate orbit. Samples come in BUDDHA_CHUNK tasks with
+// counter-based seeds, so the image does not depend on the thread count.
+// Threads count into private 32-bit histograms that are merged in parallel
+// after every round, unless they would exceed BUDDHA_HIST_BUDGET, in which
+// case they add atomically into density. progress is called roughly every
+// progress_interval seconds (0 = only at the end). Returns 1 on success.
+int render_buddhabrot(uint64_t *density, const BuddhaParams *params, double progress_interval,
+                      BuddhaProgressFn progress, void *user, BuddhaStats *stats);
+
+// Tone-maps density to RGB: square root of the count relative to the
+// 99.9th percentile, looked up in a 256-step ramp of the palette
+void buddha_colorize(unsigned char *rgb, const uint64_t *density, size_t count, int palette);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
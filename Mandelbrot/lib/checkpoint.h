@@ -0,0 +1,28 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include "fractal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CHECKPOINT_TILE 256
+#define CHECKPOINT_INTERVAL 30.0
+
+// Reads the frame size and view stored in a checkpoint file. Returns 0 if the
+// file is missing or its header has invalid sizes or view parameters.
+int checkpoint_read_params(const char *path, int *width, int *height, FractalView *view);
+
+// Tiled parallel render that flushes completed tiles to path every interval
+// seconds. With resume set, tiles already saved in path are loaded instead of
+// recomputed. Returns 1 on success.
+int generate_parallel_checkpointed(unsigned char *image, int width, int height,
+                                   const FractalView *view, const char *path,
+                                   double interval, int resume);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,96 @@
+#ifndef DISTRIBUTED_H
+#define DISTRIBUTED_H
+
+#include <stdint.h>
+#include "fractal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DIST_TILE 256          // tile edge dispatched to workers
+#define DIST_PIPELINE 2        // tiles in flight per worker: one rendering, one queued
+#define DIST_WINDOW_ROWS 4     // tile rows buffered ahead of the output writer
+#define DIST_TIMEOUT 30.0      // seconds a worker may hold a tile before it is declared lost
+#define DIST_NAME 64
+
+// Coordinator and workers speak a small binary protocol over TCP: each
+// message is a DistHeader followed by length bytes of payload. Structs are
+// sent as they are in memory, so every machine must share the coordinator's
+// byte order and double layout.
+enum {
+    DIST_HELLO = 1,   // worker -> coordinator: DistHello
+    DIST_RENDER,      // coordinator -> worker: DistTileRequest
+    DIST_RESULT,      // worker -> coordinator: DistTileResult + RGB24 pixels
+    DIST_BYE          // coordinator -> worker: no more tiles
+};
+
+typedef struct {
+    uint32_t type, length;
+} DistHeader;
+
+typedef struct {
+    int32_t threads;
+    char name[DIST_NAME];    // host:pid, for the report
+} DistHello;
+
+typedef struct {
+    int32_t id;
+    int32_t width, height;   // whole frame
+    int32_t x0, y0, tile_w, tile_h;
+    FractalView view;
+} DistTileRequest;
+
+typedef struct {
+    int32_t id;
+    int32_t tile_w, tile_h;
+    double seconds;          // render time on the worker
+} DistTileResult;
+
+typedef struct {
+    const char *bind;        // listen address, NULL = 127.0.0.1
+    int port;                // 0 = any free port
+    int spawn;               // local workers, forked before any threads start
+    int worker_threads;      // threads per spawned worker, 0 = cores / spawn
+    double timeout;          // 0 = DIST_TIMEOUT; also how long to wait with no workers
+    int format, level;       // image_io output format; PNG is streamed by tile row
+} DistOptions;
+
+typedef struct {
+    char name[DIST_NAME];
+    int threads;
+    long tiles;
+    double pixels;
+    double busy;             // summed worker-side render seconds
+    double connected;        // seconds between hello and disconnect (or the end)
+    int lost;                // dropped mid-render; its tiles were reassigned
+} DistWorkerStats;
+
+typedef struct {
+    long tiles, reassigned;
+    double total_time;
+    int worker_count;
+    DistWorkerStats *workers; // owned by the caller (free())
+} DistStats;
+
+// Splits the frame into DIST_TILE tiles and hands them to every worker that
+// connects, keeping DIST_PIPELINE tiles queued per worker. A worker that
+// disconnects or exceeds the timeout is dropped and its tiles go back to the
+// front of the queue. Tiles are dispatched in row order and the window of
+// buffered tile rows is bounded, so PNG output streams to disk with memory
+// independent of frame height; other formats are assembled in memory first.
+// Returns 1 if the image was written.
+int render_distributed(const char *path, int width, int height, const FractalView *view,
+                       const DistOptions *opt, DistStats *stats);
+
+// Worker side: connects to host:port and renders tiles on threads cores
+// (0 = all) until the coordinator says goodbye. fail_after >= 0 drops the
+// connection after that many tiles, to exercise reassignment. Returns 1 on a
+// clean goodbye.
+int dist_worker_run(const char *host, int port, int threads, long fail_after);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
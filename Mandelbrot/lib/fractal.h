@@ -1,15 +1,92 @@
 #ifndef MANDELBROT_H
 #define MANDELBROT_H
 
+#include <stddef.h>
+#include <stdint.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+#define AUTO_ITER_MIN 32
+#define AUTO_ITER_MAX (1 << 20)
+#define AUTO_ITER_FIXED 1000     // the limit the CLI and GUI use when auto is off
+#define AUTO_PROBE_SIZE 64
+#define AUTO_ITER_PERCENTILE 0.995
+
+typedef struct {
+    int max_iter;           // limit chosen for the render
+    int depth_iter;         // estimate from zoom depth alone
+    int probe_iter;         // iteration ceiling used by the probe
+    double interior_ratio;  // probe pixels that never escaped
+    double work_auto;       // estimated iterations per pixel at max_iter
+    double work_fixed;      // estimated iterations per pixel at the fixed limit
+} AutoIter;
+
+// Pixel formats the kernels can write directly
+enum {
+    OUTPUT_RGB = 0,   // 3 bytes, colored through the view's palette
+    OUTPUT_INDEXED,   // 1 byte palette index, 255 = interior
+    OUTPUT_ITER16     // native uint16_t escape count, clamped at 65535
+};
+
+typedef struct {
+    int max_iter;
+    double center_x, center_y, scale;
+    int julia;
+    double c_real, c_imag;
+    int palette;            // PALETTE_* from palette.h, 0 = engine default
+} FractalView;
+
 void generate_serial(unsigned char *image, int width, int height,
                      int max_iter, double center_x, double center_y, double scale);
 void generate_parallel(unsigned char *image, int width, int height,
                        int max_iter, double center_x, double center_y, double scale);
 
+// Renders pixels [x0, x0+tile_w) x [y0, y0+tile_h) of a width x height frame.
+// dst points at the tile's top-left pixel, rows are stride bytes apart.
+void render_tile(unsigned char *dst, size_t stride, int width, int height,
+                 const FractalView *view, int x0, int y0, int tile_w, int tile_h);
+
+// render_tile that polls *cancel (read atomically) at least every
+// RENDER_POLL_ITERATIONS iterations, inside a pixel as well as between
+// pixels, so even one interior pixel at a huge max_iter stops within
+// microseconds of a cancel. Returns the number of complete rows: tile_h if
+// the tile finished, fewer if it was cancelled part way, 0 if the palette
+// table could not be allocated.
+#define RENDER_POLL_ITERATIONS 8192
+int render_tile_polled(unsigned char *dst, size_t stride, int width, int height,
+                       const FractalView *view, int x0, int y0, int tile_w, int tile_h,
+                       const int *cancel);
+
+// Exponential map: column x is angle x * 2pi / strip_w around the view
+// center, row y is radius exp(log_r0 + y * 2pi / strip_w), so pixels stay
+// square and one strip holds every zoom level between its radii
+void render_expmap_tile(unsigned char *dst, size_t stride, int strip_w, double log_r0,
+                        const FractalView *view, int x0, int y0, int tile_w, int tile_h);
+
+size_t output_pixel_bytes(int mode);
+void render_tile_output(void *dst, size_t stride, int width, int height, const FractalView *view,
+                        int x0, int y0, int tile_w, int tile_h, int mode);
+void generate_output_parallel(void *image, int width, int height, const FractalView *view, int mode);
+
+// 1 if c lies in the main cardioid or the period-2 bulb, where the orbit of 0
+// never escapes; a few multiplies instead of max_iter iterations
+int mandelbrot_interior(double cx, double cy);
+
+// Escape count of c as the renderers compute it (max_iter if it never
+// escapes), but interior points are cut short: the cardioid/bulb test, then
+// a periodicity check that saves the orbit point at iterations 2, 4, 8, ...
+// and stops once a later point comes back within 1e-13 of the saved one.
+// *proven is 1 when either test classified c as interior rather than it
+// merely running out of iterations; the periodicity check is numerical, so
+// an orbit that lingers that close to a point without being periodic is
+// also counted as interior.
+int mandelbrot_escape(double cx, double cy, int max_iter, int *proven);
+
+// Raw escape counts (0..max_iter) for later coloring
+void generate_iter_parallel(uint32_t *iters, int width, int height, const FractalView *view);
+
 int save_png(const char *path, const unsigned char *image, int width, int height);
 
 void generate_julia_serial(unsigned char *img, int width, int height,
@@ -19,6 +96,9 @@ void generate_julia_parallel(unsigned char *img, int width, int height,
         int max_iter, double center_x, double center_y, double scale,
         double c_real, double c_imag);
 
+int auto_max_iter(int width, int height, double center_x, double center_y, double scale,
+                  int julia, double c_real, double c_imag, int fixed_iter, AutoIter *info);
+
 int generate_gpu(unsigned char *image, int width, int height, int max_iter,
                  double center_x, double center_y, double scale, int julia,
                  double c_real, double c_imag);
@@ -0,0 +1,33 @@
+#ifndef IMAGE_IO_H
+#define IMAGE_IO_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum {
+    IMAGE_PNG = 0,  // parallel deflate, see png_stream.h
+    IMAGE_QOI,      // lossless, single pass, several times faster than deflate
+    IMAGE_PPM,      // raw binary P6
+    IMAGE_PAM,      // raw binary P7, RGB tuple type
+    IMAGE_BMP,      // uncompressed 24-bit
+    IMAGE_TGA,      // uncompressed 24-bit, top-left origin
+    IMAGE_JPG,      // lossy, stb_image_write
+    IMAGE_FORMAT_COUNT
+};
+
+#define IMAGE_IO_BUFFER (1 << 22)  // stdio buffer for the raw writers
+
+const char *image_format_ext(int format);
+int image_format_from_name(const char *name);  // extension without dot, -1 if unknown
+
+// Writes an RGB buffer in the given format; level is only used by PNG.
+// Returns 1 on success.
+int save_image(const char *path, const unsigned char *rgb, int width, int height,
+               int format, int level);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef ITERFILE_H
+#define ITERFILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "fractal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ITERFILE_TILE 256   // tiles are coded independently for random access
+#define ITERFILE_BLOCK 16   // residuals sharing one Rice parameter
+
+typedef struct IterFile IterFile;
+
+// Writes an iteration buffer (values 0..view->max_iter) as a tiled .mbi file:
+// header with the view, tile offset index, then per-tile median-edge
+// prediction residuals, zigzag mapped and Rice coded. Tiles are encoded in
+// parallel one tile row at a time. Returns 1 on success.
+int iterfile_save(const char *path, const uint32_t *iters, int width, int height,
+                  const FractalView *view);
+
+// Opens a file for reading; width, height and view may be NULL. NULL if the
+// header is invalid: wrong magic, a tile size other than ITERFILE_TILE, or
+// dimensions that do not match the tile counts.
+IterFile *iterfile_open(const char *path, int *width, int *height, FractalView *view);
+int iterfile_tile_size(const IterFile *f);
+
+// Decodes tile (tx, ty) into dst, stride in pixels. Safe to call from several threads.
+int iterfile_read_tile(IterFile *f, int tx, int ty, uint32_t *dst, size_t stride);
+
+// Decodes every tile in parallel into a width * height buffer
+int iterfile_read_all(IterFile *f, uint32_t *iters);
+void iterfile_close(IterFile *f);
+
+// open + read_all; the returned buffer is owned by the caller (free())
+uint32_t *iterfile_load(const char *path, int *width, int *height, FractalView *view);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef JULIA_SWEEP_H
+#define JULIA_SWEEP_H
+
+#include "fractal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SWEEP_LANES 4   // neighbouring c values iterated together per pixel
+
+typedef struct {
+    int cols, rows;               // thumbnails across and down
+    int thumb;                    // thumbnail edge in pixels
+    double re_min, im_min;        // c of the first column / row
+    double re_max, im_max;        // c of the last column / row
+} JuliaSweep;
+
+// c of the thumbnail at (col, row); rows run down from im_min like image rows
+void julia_sweep_c(const JuliaSweep *sweep, int col, int row, double *c_real, double *c_imag);
+
+// Renders one Julia thumbnail per c of the grid into an RGB atlas of
+// (cols * thumb) x (rows * thumb) pixels. view gives max_iter, palette and
+// the z-plane window (center, scale) every thumbnail shows; its c is ignored.
+// Work is split into tasks of SWEEP_LANES neighbouring thumbnails that
+// iterate the same starting z for all their c values at once, so one task
+// keeps several independent iterations in flight. interior (cols * rows, may be
+// NULL) receives each thumbnail's fraction of pixels that never escaped.
+void generate_julia_sweep(unsigned char *atlas, const JuliaSweep *sweep, const FractalView *view,
+                          float *interior);
+
+// CSV index of the atlas: col, row, pixel offset, c and interior fraction
+int save_julia_sweep_index(const char *path, const JuliaSweep *sweep, const float *interior);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
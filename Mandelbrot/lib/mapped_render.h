@@ -0,0 +1,22 @@
+#ifndef MAPPED_RENDER_H
+#define MAPPED_RENDER_H
+
+#include "fractal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MAPPED_TILE 256
+
+// Renders the view into a binary PPM at path through a shared file mapping,
+// one band of MAPPED_TILE rows at a time (tiles in parallel). Finished bands
+// are written back and dropped with madvise, so the resident set stays near
+// one band regardless of image size. Returns 1 on success.
+int generate_parallel_mapped(const char *path, int width, int height, const FractalView *view);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define METRICS_MAX_THREADS 256  // live threads with a private slot; more share one atomically
+#define METRICS_BUCKETS 22       // latency bounds 10us .. 50s in 1-2.5-5 steps, then +Inf
+
+enum {
+    METRIC_PIXELS = 0,       // pixels computed by the escape-time kernels
+    METRIC_ITERATIONS,       // z -> z^2 + c steps taken for them
+    METRIC_ESCAPED,          // pixels whose loop exited before max_iter
+    METRIC_TILES,            // tiles finished by the tiled paths
+    METRIC_CACHE_HITS,       // tile server cache
+    METRIC_CACHE_MISSES,
+    METRIC_COUNTER_COUNT
+};
+
+enum {
+    METRIC_TILE_SECONDS = 0, // one tile, any tiled path
+    METRIC_FRAME_SECONDS,    // one whole frame (CLI, batch)
+    METRIC_ENCODE_SECONDS,   // save_image, any format
+    METRIC_REQUEST_SECONDS,  // tile server, request parsed to response queued
+    METRIC_HISTOGRAM_COUNT
+};
+
+// Counters and histograms live in per-thread slots, each on its own cache
+// lines and written only by its thread with plain relaxed stores, so
+// recording costs a thread-local lookup and an add, with no locks or shared
+// cache lines. A thread's slot goes back to a free list when it exits and is
+// handed, counts and all, to the next thread that records, so short-lived
+// threads do not use up the private slots. Readers sum the slots with
+// relaxed loads; totals only grow. Call sites record once per row or tile,
+// never per pixel.
+void metrics_add(int counter, uint64_t value);
+void metrics_observe(int histogram, double seconds);
+
+// METRIC_TILES + 1 and a METRIC_TILE_SECONDS sample
+void metrics_tile(double seconds);
+
+// Totals so far, summed over every slot
+uint64_t metrics_counter(int counter);
+
+// Prometheus text exposition format (version 0.0.4). Returns the length of
+// the full text, writing at most size bytes (NUL included) like snprintf.
+size_t metrics_format(char *buf, size_t size);
+
+// Writes the exposition to path through a temporary file and rename, so a
+// scraper (e.g. the node exporter textfile collector) never sees a partial
+// file. Returns 1 on success.
+int metrics_write(const char *path);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef MIIM_H
+#define MIIM_H
+
+#include <stdint.h>
+#include "fractal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MIIM_SPLIT 10      // tree levels expanded up front: 2^10 branches shared among threads
+#define MIIM_COARSE 2048   // edge of the bitmap over the whole set that prunes points off the frame
+
+typedef struct {
+    uint64_t points;       // preimages computed
+    uint64_t pixels;       // frame pixels on the boundary
+    int depth;             // deepest level reached
+} MiimStats;
+
+// Julia set boundary by modified inverse iteration: starting from the
+// repelling fixed point, which lies on the Julia set, both preimages
+// +-sqrt(z - c) are followed depth first. A branch stops when it lands on a
+// pixel that is already marked in a visited bitmap (or on a cell of a coarse
+// bitmap, for points outside the frame) or after view->max_iter levels, so
+// the work grows with the boundary length in pixels, not the frame area.
+// The first MIIM_SPLIT levels are expanded serially and the branches below
+// them run as parallel tasks sharing the bitmap through atomic bit sets;
+// which task marks a pixel first varies between runs, the set of marked
+// pixels barely does. Boundary pixels get the Julia palette's color for the
+// slowest escapes, everything else its color for the fastest. Best for a
+// view of the whole set: deep zooms prune on the coarse bitmap and miss
+// detail. Returns 1 on success.
+int generate_julia_miim(unsigned char *image, int width, int height, const FractalView *view,
+                        MiimStats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
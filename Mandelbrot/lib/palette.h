@@ -0,0 +1,64 @@
+#ifndef PALETTE_H
+#define PALETTE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "fractal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// PALETTE_DEFAULT keeps each engine's original look: classic for Mandelbrot, gray for Julia
+enum {
+    PALETTE_DEFAULT = 0,
+    PALETTE_CLASSIC,
+    PALETTE_GRAY,
+    PALETTE_FIRE,
+    PALETTE_OCEAN,
+    PALETTE_COUNT
+};
+
+const char *palette_name(int palette);
+int palette_from_name(const char *name);    // -1 if unknown
+int palette_resolve(int palette, int julia); // maps PALETTE_DEFAULT to the engine's palette
+
+// Shared lookup table of max_iter + 1 packed colors (0x00BBGGRR), indexed by
+// iteration count; entry max_iter is the interior color. Each call takes a
+// reference that palette_lut_release() drops. Tables are cached per
+// (palette, max_iter); once unreferenced, the most recently used stay as
+// long as there are at most PALETTE_CACHE_ENTRIES tables of at most
+// PALETTE_CACHE_BYTES in total, and older ones are freed. Tables in use
+// count towards both bounds but are never freed. NULL if out of memory.
+#define PALETTE_CACHE_ENTRIES 8
+#define PALETTE_CACHE_BYTES ((size_t)64 << 20)
+const uint32_t *palette_lut(int palette, int max_iter);
+void palette_lut_release(const uint32_t *lut);  // NULL is ignored
+size_t palette_cache_bytes(void);               // bytes of all cached tables
+
+// Uncached table, owned by the caller (free()); for callers whose max_iter
+// changes every frame and would otherwise fill the cache
+uint32_t *palette_lut_build(int palette, int max_iter);
+
+// 256-entry PLTE for OUTPUT_INDEXED images: entry k is the palette at
+// k/255 of the escape range, entry 255 the interior color
+void palette_plte(int palette, unsigned char plte[256 * 3]);
+
+// Histogram-equalized table for an iteration buffer, built from per-thread
+// histograms; counts above max_iter are treated as interior. Returned table
+// is owned by the caller (free()).
+uint32_t *palette_lut_equalized(int palette, const uint32_t *iters, size_t count, int max_iter);
+
+// Parallel LUT colorize pass, 3 bytes per pixel. Uses AVX2 gathers, 8
+// pixels at a time, on CPUs that have them (checked at run time).
+void colorize(unsigned char *rgb, const uint32_t *iters, size_t count, const uint32_t *lut);
+
+// Iteration pass, optional equalization, then colorize with view->palette
+int generate_palette_parallel(unsigned char *image, int width, int height,
+                              const FractalView *view, int equalize);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
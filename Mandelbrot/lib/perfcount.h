@@ -0,0 +1,50 @@
+#ifndef PERFCOUNT_H
+#define PERFCOUNT_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PERF_MAX_THREADS 256
+
+enum {
+    PERF_CYCLES = 0,
+    PERF_INSTRUCTIONS,
+    PERF_BRANCH_MISSES,
+    PERF_CACHE_MISSES,      // last-level cache misses
+    PERF_FP_SCALAR,         // scalar double-precision FP instructions (Intel only)
+    PERF_FP_PACKED,         // 128/256/512-bit packed double instructions (Intel only)
+    PERF_COUNTER_COUNT
+};
+
+typedef struct {
+    uint64_t value[PERF_COUNTER_COUNT];
+} PerfCounts;
+
+typedef struct {
+    int threads;                          // threads that opened counters
+    int available[PERF_COUNTER_COUNT];    // 1 if the counter opened on every thread
+    PerfCounts total;
+    PerfCounts thread[PERF_MAX_THREADS];  // by OpenMP thread number
+} PerfReport;
+
+// Opens and starts hardware counters for the calling thread and every
+// OpenMP thread, counting user-space events of each thread only. Counters
+// are opened separately, so the kernel may multiplex them when there are
+// more than the PMU holds; reads are scaled by time enabled over time
+// running. Returns 0 if cycles cannot be counted (no PMU, as in many VMs,
+// or perf_event_paranoid too high), with a reason in why; the other
+// counters are optional and marked in PerfReport.available.
+int perf_start(char *why, int why_size);
+
+// Stops the counters opened by perf_start, reads them and closes them.
+// Call with the same OpenMP thread count as perf_start. Returns 1 on success.
+int perf_stop(PerfReport *report);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,65 @@
+#ifndef PNG_STREAM_H
+#define PNG_STREAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "fractal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PNG_GRAY 0
+#define PNG_RGB 2
+#define PNG_INDEXED 3
+
+#define PNG_STREAM_BAND 64            // rows rendered per band
+#define PNG_STREAM_CHUNK (1 << 18)    // IDAT payload size
+#define PNG_PAR_BLOCK (1 << 19)       // filtered bytes per independently deflated block
+
+typedef struct PngStream PngStream;
+
+// Opens path and writes the PNG signature and IHDR. level is the zlib
+// compression level (-1 = default, 0-9). Rows are buffered into bands of
+// about two PNG_PAR_BLOCKs per thread, which are filtered and deflated on
+// all cores as independent blocks; memory is independent of image height.
+PngStream *png_stream_open(const char *path, uint32_t width, uint32_t height,
+                           int color_type, int bit_depth, int level);
+
+// Writes a PLTE chunk for PNG_INDEXED images; call before the first row
+int png_stream_set_palette(PngStream *png, const unsigned char *plte, int entries);
+
+// Appends count rows of packed pixel data (row_bytes apart). Returns 1 on success.
+int png_stream_write_rows(PngStream *png, const unsigned char *rows, uint32_t count);
+
+// Finishes the zlib stream, writes IEND and closes the file. Returns 1 only
+// if every row was written and the file is complete.
+int png_stream_close(PngStream *png);
+
+size_t png_stream_row_bytes(const PngStream *png);
+
+// Whole-image convenience wrapper around the stream API
+int png_write_image(const char *path, const unsigned char *pixels, uint32_t width, uint32_t height,
+                    int color_type, int bit_depth, int level);
+
+// Small RGB image to a malloc'd PNG in memory, single-threaded so callers
+// can encode many images concurrently. Returns NULL on failure.
+unsigned char *png_encode_rgb(const unsigned char *pixels, uint32_t width, uint32_t height,
+                              int level, size_t *out_len);
+
+// OUTPUT_INDEXED buffer as an 8-bit indexed PNG with palette_plte(palette)
+int save_png_indexed(const char *path, const unsigned char *indices, int width, int height,
+                     int palette, int level);
+
+// OUTPUT_ITER16 buffer as a 16-bit grayscale PNG holding the raw escape counts
+int save_png_iter16(const char *path, const uint16_t *iters, int width, int height, int level);
+
+// Renders the view band by band straight into a streamed RGB PNG
+int generate_png_streamed(const char *path, int width, int height,
+                          const FractalView *view, int level);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef PYRAMID_H
+#define PYRAMID_H
+
+#include "fractal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PYRAMID_TILE 256
+
+typedef struct {
+    int levels;    // DZI levels written, 0 (1x1) .. levels - 1 (full size)
+    long tiles;    // tile files written across all levels
+} PyramidInfo;
+
+// Renders the view as a Deep Zoom (DZI) tile pyramid: dzi_path is the .dzi
+// descriptor, tiles go to <name>_files/<level>/<col>_<row>.<ext> in any
+// image_io format. The full-size level is rendered one tile row at a time in
+// parallel; every lower level is built by parallel 2x2 averaging of the level
+// above as its rows arrive, so memory is about two tile rows of the full
+// width and nothing is rendered twice. info may be NULL. Returns 1 on success.
+int generate_dzi(const char *dzi_path, int width, int height, const FractalView *view,
+                 int format, int level, PyramidInfo *info);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef RENDER_ASYNC_H
+#define RENDER_ASYNC_H
+
+#include "fractal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define RENDER_ASYNC_TILE 64
+
+// RENDER_FAILED: a tile could not be rendered (its palette table could not be
+// allocated); the remaining tiles are skipped
+enum { RENDER_RUNNING = 0, RENDER_DONE = 1, RENDER_CANCELLED = 2, RENDER_FAILED = 3 };
+
+typedef struct RenderJob RenderJob;
+
+// Called from a worker thread as soon as a tile's pixels are in the image buffer
+typedef void (*RenderTileFn)(void *user, int x0, int y0, int tile_w, int tile_h);
+
+// Starts a tiled parallel render in the background and returns immediately.
+// image must stay valid until the job is finished and freed. on_tile may be NULL.
+RenderJob *render_async_start(unsigned char *image, int width, int height,
+                              const FractalView *view, RenderTileFn on_tile, void *user);
+
+double render_async_progress(const RenderJob *job);  // fraction of pixels done, 0..1
+int render_async_status(const RenderJob *job);       // RENDER_RUNNING, _DONE, _CANCELLED or _FAILED
+
+// Blocks until the job stops or timeout seconds pass (timeout < 0 waits forever).
+// Returns the status at that point.
+int render_async_wait(RenderJob *job, double timeout);
+
+// Requests cooperative cancellation. Workers poll the flag every
+// RENDER_POLL_ITERATIONS iterations, mid-pixel included, so they stop within
+// microseconds; tiles cut short are left partly drawn and get no on_tile
+// call. A job whose tiles had all finished still ends RENDER_DONE.
+void render_async_cancel(RenderJob *job);
+
+// Cancels if still running, joins the driver thread and releases the handle
+void render_async_free(RenderJob *job);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef SHM_RING_H
+#define SHM_RING_H
+
+#include <stdint.h>
+#include "fractal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SHM_RING_SLOTS 4
+
+// Single-writer frame ring in POSIX shared memory (shm_open name, e.g.
+// "/mandelbrot"). Frames are RGB24, width * 3 bytes per row. The writer never
+// waits: each publish overwrites the oldest slot. Every slot carries a
+// seqlock, so readers use frames in place and check afterwards that the
+// slot was not reused while they read it. New frames are signalled through
+// a futex, which is only woken when a reader is actually waiting.
+typedef struct ShmRing ShmRing;
+
+typedef struct {
+    uint64_t seq;           // publish sequence, 1 for the first frame
+    int frame;              // caller's frame number
+    int width, height;
+    int64_t timestamp_ns;   // CLOCK_MONOTONIC at publish
+    FractalView view;
+    const unsigned char *pixels;  // points into the shared mapping
+    int slot;
+} ShmFrame;
+
+// Writer side. create replaces any ring with the same name.
+ShmRing *shm_ring_create(const char *name, int width, int height, int slots);
+unsigned char *shm_ring_acquire(ShmRing *ring);  // slot the next frame is drawn into
+void shm_ring_publish(ShmRing *ring, int frame, const FractalView *view);
+int shm_ring_unlink(const char *name);
+
+// Reader side. open returns NULL unless the header describes slots that fit
+// in the shared mapping.
+ShmRing *shm_ring_open(const char *name);
+void shm_ring_size(const ShmRing *ring, int *width, int *height);
+
+// Newest published frame, without blocking. Returns 0 if there is none yet.
+int shm_ring_latest(ShmRing *ring, ShmFrame *out);
+
+// Blocks until a frame newer than after_seq is published or timeout seconds
+// pass (negative waits forever), then returns the newest frame. Returns 0 on timeout.
+int shm_ring_wait(ShmRing *ring, uint64_t after_seq, double timeout, ShmFrame *out);
+
+// 1 if the frame's pixels have not been overwritten since it was returned;
+// call after using them to detect a torn read
+int shm_ring_valid(const ShmRing *ring, const ShmFrame *frame);
+
+void shm_ring_close(ShmRing *ring);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
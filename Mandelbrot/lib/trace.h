@@ -0,0 +1,38 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TRACE_DEFAULT_EVENTS (1 << 20)   // 48 MB of address space, touched only as events arrive
+
+// Spans (tile, row, thread, colorize, deflate, encode, frame) go into one
+// preallocated buffer: a thread claims an entry with an atomic add, fills
+// it and publishes it with a release store, so recording never locks and
+// threads never wait on each other. Until trace_start is called, begin and
+// end cost one relaxed load. Once the buffer is full, further spans are
+// dropped and counted.
+int trace_start(size_t max_events);
+
+// Start of a span: a monotonic timestamp, or 0 when tracing is off
+uint64_t trace_begin(void);
+
+// Records the span from begin to now on the calling thread. name must be a
+// string literal (only the pointer is stored). x, y, w, h describe the
+// image region it worked on; w = 0 for none.
+void trace_end(const char *name, uint64_t begin, int x, int y, int w, int h);
+
+// Stops recording and writes every published span as Chrome trace event
+// JSON, which chrome://tracing and ui.perfetto.dev open directly. Returns 1
+// on success.
+int trace_write(const char *path);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,236 @@
+#include <omp.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "analysis.h"
+
+// splitmix64, one stream per task
+static inline uint64_t next_random(uint64_t *state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+static inline double next_unit(uint64_t *state) {
+    return (double)(next_random(state) >> 11) * 0x1.0p-53;
+}
+
+// Bucket of an escape count: floor(log2(iterations run)), iterations = iter + 1
+static inline int escape_bucket(int iter) {
+    int k = 31 - __builtin_clz((unsigned)iter + 1u);
+    return k < AREA_BUCKETS ? k : AREA_BUCKETS - 1;
+}
+
+typedef struct {
+    uint64_t *hits, *undecided, *escape_sum;
+    uint64_t *buckets;           // strata x AREA_BUCKETS
+} StratumCounts;
+
+// Draws count[h] samples in every stratum h, split into AREA_CHUNK tasks
+// found through a prefix sum of chunks per stratum
+static int sample_strata(const AreaParams *p, int phase, const uint64_t *count,
+                         StratumCounts *sc, int cols, double sw, double sh) {
+    size_t strata = (size_t)cols * p->strata;
+    uint64_t *first = malloc((strata + 1) * sizeof(uint64_t));
+    if (!first) return 0;
+    first[0] = 0;
+    for (size_t h = 0; h < strata; h++)
+        first[h + 1] = first[h] + (count[h] + AREA_CHUNK - 1) / AREA_CHUNK;
+    int64_t tasks = (int64_t)first[strata];
+
+    #pragma omp parallel for schedule(dynamic)
+    for (int64_t t = 0; t < tasks; t++) {
+        size_t lo = 0, hi = strata;
+        while (hi - lo > 1) {
+            size_t mid = (lo + hi) / 2;
+            if (first[mid] <= (uint64_t)t) lo = mid;
+            else hi = mid;
+        }
+        size_t h = lo;
+        uint64_t chunk = (uint64_t)t - first[h];
+        uint64_t n = count[h] - chunk * AREA_CHUNK;
+        if (n > AREA_CHUNK) n = AREA_CHUNK;
+
+        uint64_t rng = p->seed ^ ((h * 2 + (uint64_t)phase) * 0xD1B54A32D192ED03ull)
+                       ^ (chunk * 0x8CB92BA72F3D8DD7ull);
+        double x0 = AREA_X_MIN + (double)(h % cols) * sw, y0 = (double)(h / cols) * sh;
+        uint64_t hits = 0, undecided = 0, escape_sum = 0, buckets[AREA_BUCKETS] = { 0 };
+        for (uint64_t s = 0; s < n; s++) {
+            double cx = x0 + next_unit(&rng) * sw;
+            double cy = y0 + next_unit(&rng) * sh;
+            int proven, iter = mandelbrot_escape(cx, cy, p->max_iter, &proven);
+            if (iter >= p->max_iter) {
+                hits++;
+                undecided += !proven;
+            } else {
+                escape_sum += (uint64_t)iter;
+                buckets[escape_bucket(iter)]++;
+            }
+        }
+        // Tasks of one stratum may run at once
+        __atomic_fetch_add(&sc->hits[h], hits, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&sc->undecided[h], undecided, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&sc->escape_sum[h], escape_sum, __ATOMIC_RELAXED);
+        for (int k = 0; k < AREA_BUCKETS; k++)
+            if (buckets[k]) __atomic_fetch_add(&sc->buckets[h * AREA_BUCKETS + k], buckets[k], __ATOMIC_RELAXED);
+    }
+    free(first);
+    return 1;
+}
+
+// Membership estimate used for allocation and variance; pulled off 0 and 1
+// so strata that showed no mix are not declared certain
+static inline double smoothed_p(uint64_t hits, uint64_t n) {
+    return (hits + 0.5) / (n + 1.0);
+}
+
+int estimate_area_monte_carlo(const AreaParams *p, AreaEstimate *out) {
+    double start = omp_get_wtime();
+    memset(out, 0, sizeof(*out));
+    if (p->max_iter <= 0 || p->strata <= 0 || p->samples == 0) return 0;
+    int cols = 2 * p->strata;
+    size_t strata = (size_t)cols * p->strata;
+    double sw = (AREA_X_MAX - AREA_X_MIN) / cols, sh = AREA_Y_MAX / p->strata;
+    double cell_area = sw * sh;
+
+    StratumCounts sc;
+    uint64_t *n = calloc(strata, sizeof(uint64_t));
+    uint64_t *extra = calloc(strata, sizeof(uint64_t));
+    sc.hits = calloc(strata, sizeof(uint64_t));
+    sc.undecided = calloc(strata, sizeof(uint64_t));
+    sc.escape_sum = calloc(strata, sizeof(uint64_t));
+    sc.buckets = calloc(strata * AREA_BUCKETS, sizeof(uint64_t));
+    int ok = n && extra && sc.hits && sc.undecided && sc.escape_sum && sc.buckets;
+
+    // Pilot: the same number of samples everywhere
+    uint64_t pilot = (uint64_t)(p->samples * p->pilot / strata);
+    if (pilot < 2) pilot = 2;
+    for (size_t h = 0; ok && h < strata; h++) n[h] = pilot;
+    ok = ok && sample_strata(p, 0, n, &sc, cols, sw, sh);
+
+    // Neyman allocation of the rest: strata areas are equal, so the share
+    // follows the pilot's standard deviation alone
+    uint64_t used = pilot * strata;
+    if (ok && p->samples > used) {
+        double total_weight = 0.0;
+        for (size_t h = 0; h < strata; h++) {
+            double q = smoothed_p(sc.hits[h], n[h]);
+            total_weight += sqrt(q * (1.0 - q));
+        }
+        uint64_t rest = p->samples - used;
+        for (size_t h = 0; h < strata; h++) {
+            double q = smoothed_p(sc.hits[h], n[h]);
+            extra[h] = (uint64_t)(rest * sqrt(q * (1.0 - q)) / total_weight);
+        }
+        ok = sample_strata(p, 1, extra, &sc, cols, sw, sh);
+        for (size_t h = 0; h < strata; h++) n[h] += extra[h];
+    }
+
+    if (ok) {
+        double area = 0.0, variance = 0.0, undecided = 0.0, escape_sum = 0.0, escaped = 0.0;
+        for (size_t h = 0; h < strata; h++) {
+            double weight = cell_area / n[h];
+            double q = smoothed_p(sc.hits[h], n[h]);
+            area += weight * sc.hits[h];
+            variance += cell_area * cell_area * q * (1.0 - q) / n[h];
+            undecided += weight * sc.undecided[h];
+            escape_sum += weight * sc.escape_sum[h];
+            escaped += weight * (n[h] - sc.hits[h]);
+            for (int k = 0; k < AREA_BUCKETS; k++)
+                out->escape_area[k] += 2.0 * weight * sc.buckets[h * AREA_BUCKETS + k];
+            out->samples += n[h];
+            out->interior += sc.hits[h];
+        }
+        // Both halves: the lower half mirrors the upper exactly
+        out->area = 2.0 * area;
+        out->std_error = 2.0 * sqrt(variance);
+        out->low = out->area - AREA_Z95 * out->std_error;
+        out->high = out->area + AREA_Z95 * out->std_error;
+        out->undecided_area = 2.0 * undecided;
+        out->mean_escape = escaped > 0.0 ? escape_sum / escaped : 0.0;
+    }
+    free(n);
+    free(extra);
+    free(sc.hits);
+    free(sc.undecided);
+    free(sc.escape_sum);
+    free(sc.buckets);
+    out->seconds = omp_get_wtime() - start;
+    return ok;
+}
+
+int estimate_area_pixels(int resolution, int max_iter, AreaEstimate *out) {
+    double start = omp_get_wtime();
+    memset(out, 0, sizeof(*out));
+    if (resolution <= 0 || max_iter <= 0) return 0;
+    int width = (int)ceil((AREA_X_MAX - AREA_X_MIN) * resolution);
+    int height = (int)ceil(AREA_Y_MAX * resolution);
+    int bands = (height + AREA_BAND - 1) / AREA_BAND;
+    double step = 1.0 / resolution;
+    uint64_t interior = 0, boundary_in = 0, boundary_out = 0, undecided = 0, escape_sum = 0;
+    uint64_t buckets[AREA_BUCKETS] = { 0 };
+    int failed = 0;
+
+    #pragma omp parallel reduction(+:interior, boundary_in, boundary_out, undecided, escape_sum, failed) \
+                         reduction(+:buckets[:AREA_BUCKETS])
+    {
+        // Band rows plus one above and below for the neighbour test
+        unsigned char *inside = malloc((size_t)(AREA_BAND + 2) * width);
+        if (!inside) failed = 1;
+        #pragma omp for schedule(dynamic)
+        for (int band = 0; band < bands; band++) {
+            if (!inside) continue;
+            int y0 = band * AREA_BAND, y1 = y0 + AREA_BAND < height ? y0 + AREA_BAND : height;
+            for (int y = y0 - 1; y <= y1; y++) {
+                unsigned char *row = inside + (size_t)(y - y0 + 1) * width;
+                // Row -1 is the mirror of row 0; rows past the box are outside the set
+                int src = y < 0 ? 0 : y;
+                if (src >= height) {
+                    memset(row, 0, width);
+                    continue;
+                }
+                double cy = (src + 0.5) * step;
+                int own = y >= y0 && y < y1;
+                for (int x = 0; x < width; x++) {
+                    int proven, iter = mandelbrot_escape(AREA_X_MIN + (x + 0.5) * step, cy, max_iter, &proven);
+                    row[x] = iter >= max_iter;
+                    if (!own) continue;
+                    if (row[x]) {
+                        interior++;
+                        undecided += !proven;
+                    } else {
+                        escape_sum += (uint64_t)iter;
+                        buckets[escape_bucket(iter)]++;
+                    }
+                }
+            }
+            for (int y = y0; y < y1; y++) {
+                const unsigned char *row = inside + (size_t)(y - y0 + 1) * width;
+                for (int x = 0; x < width; x++) {
+                    unsigned char v = row[x];
+                    int edge = (x > 0 ? row[x - 1] : 0) != v || (x + 1 < width ? row[x + 1] : 0) != v
+                               || row[x - width] != v || row[x + width] != v;
+                    if (edge && v) boundary_in++;
+                    else if (edge) boundary_out++;
+                }
+            }
+        }
+        free(inside);
+    }
+    if (failed) return 0;
+
+    double pixel = 2.0 * step * step;   // both halves
+    uint64_t pixels = (uint64_t)width * height;
+    out->area = interior * pixel;
+    out->low = (interior - boundary_in) * pixel;
+    out->high = (interior + boundary_out) * pixel;
+    out->undecided_area = undecided * pixel;
+    for (int k = 0; k < AREA_BUCKETS; k++) out->escape_area[k] = buckets[k] * pixel;
+    out->mean_escape = pixels > interior ? (double)escape_sum / (pixels - interior) : 0.0;
+    out->samples = pixels;
+    out->interior = interior;
+    out->boundary = boundary_in + boundary_out;
+    out->seconds = omp_get_wtime() - start;
+    return 1;
+}
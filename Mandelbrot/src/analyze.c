@@ -0,0 +1,98 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <omp.h>
+#include "analysis.h"
+
+// Numerical analysis of the set: area by stratified Monte Carlo and/or pixel
+// counting, with error bounds and the escape-time distribution
+static void print_estimate(const char *method, const AreaEstimate *e, int json) {
+    double total = 0.0;
+    for (int k = 0; k < AREA_BUCKETS; k++) total += e->escape_area[k];
+    if (json) {
+        printf("{\"method\":\"%s\",\"area\":%.10f,\"std_error\":%.3e,\"low\":%.10f,\"high\":%.10f,"
+               "\"undecided_area\":%.3e,\"samples\":%llu,\"interior\":%llu,\"boundary\":%llu,"
+               "\"mean_escape\":%.3f,\"seconds\":%.6f,\"samples_per_s\":%.0f,\"escape_area\":[",
+               method, e->area, e->std_error, e->low, e->high, e->undecided_area,
+               (unsigned long long)e->samples, (unsigned long long)e->interior,
+               (unsigned long long)e->boundary, e->mean_escape, e->seconds, e->samples / e->seconds);
+        int last = AREA_BUCKETS - 1;
+        while (last > 0 && e->escape_area[last] == 0.0) last--;
+        for (int k = 0; k <= last; k++) printf("%s%.6e", k ? "," : "", e->escape_area[k]);
+        printf("]}\n");
+        return;
+    }
+    printf("%s: area %.8f", method, e->area);
+    if (e->std_error > 0.0) printf(" +- %.2e (1 sigma)", e->std_error);
+    printf(", %s [%.8f, %.8f]\n", e->std_error > 0.0 ? "95% CI" : "boundary bracket", e->low, e->high);
+    printf("  %llu points, %llu interior", (unsigned long long)e->samples, (unsigned long long)e->interior);
+    if (e->boundary) printf(", %llu boundary pixels", (unsigned long long)e->boundary);
+    printf(", undecided at max_iter: %.2e\n", e->undecided_area);
+    printf("  %.3f seconds, %.1f Msamples/s (%.2f billion/minute)\n", e->seconds,
+           e->samples / e->seconds / 1e6, e->samples / e->seconds * 60.0 / 1e9);
+    printf("  escape time: mean %.2f iterations among escaping points\n", e->mean_escape);
+    printf("  %-16s %14s %8s\n", "iterations", "area", "share");
+    for (int k = 0; k < AREA_BUCKETS; k++) {
+        if (e->escape_area[k] == 0.0) continue;
+        char range[32];
+        snprintf(range, sizeof(range), "%u-%u", 1u << k, (2u << k) - 1);
+        printf("  %-16s %14.8f %7.3f%%\n", range, e->escape_area[k], 100.0 * e->escape_area[k] / total);
+    }
+}
+
+int main(int argc, char **argv) {
+    AreaParams params = { 10000, 128, 100000000, 0.1, 1 };
+    int resolution = 2000, json = 0;
+    const char *method = "both";
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--method") == 0 && i + 1 < argc) {
+            method = argv[++i];
+        } else if (strcmp(argv[i], "--iter") == 0 && i + 1 < argc) {
+            params.max_iter = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--samples") == 0 && i + 1 < argc) {
+            params.samples = (uint64_t)strtod(argv[++i], NULL);   // accepts 1e9
+        } else if (strcmp(argv[i], "--strata") == 0 && i + 1 < argc) {
+            params.strata = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--pilot") == 0 && i + 1 < argc) {
+            params.pilot = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            params.seed = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--resolution") == 0 && i + 1 < argc) {
+            resolution = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--json") == 0) {
+            json = 1;
+        } else {
+            fprintf(stderr, "Usage: %s [--method mc|pixels|both] [--iter N] [--samples N] [--strata ROWS]\n"
+                            "       [--pilot SHARE] [--seed N] [--resolution PIXELS_PER_UNIT] [--json]\n", argv[0]);
+            return 1;
+        }
+    }
+    int mc = strcmp(method, "mc") == 0 || strcmp(method, "both") == 0;
+    int pixels = strcmp(method, "pixels") == 0 || strcmp(method, "both") == 0;
+    if ((!mc && !pixels) || params.max_iter <= 0 || params.strata <= 0 || params.samples == 0
+        || params.pilot <= 0.0 || params.pilot > 1.0 || resolution <= 0) {
+        fprintf(stderr, "Invalid method, iteration limit, sample count, strata, pilot share or resolution\n");
+        return 1;
+    }
+    if (!json)
+        printf("Mandelbrot area, max_iter %d, %d threads (reference value about 1.50659)\n",
+               params.max_iter, omp_get_max_threads());
+
+    AreaEstimate e;
+    if (mc) {
+        if (!estimate_area_monte_carlo(&params, &e)) {
+            fprintf(stderr, "Monte Carlo estimate failed\n");
+            return 1;
+        }
+        print_estimate("monte_carlo", &e, json);
+    }
+    if (pixels) {
+        if (!estimate_area_pixels(resolution, params.max_iter, &e)) {
+            fprintf(stderr, "Pixel count failed\n");
+            return 1;
+        }
+        print_estimate("pixels", &e, json);
+    }
+    return 0;
+}
@@ -0,0 +1,77 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "animation.h"
+#include "palette.h"
+#include "image_io.h"
+
+// Zoom animation driver. Status goes to stderr so stdout can carry raw frames:
+//   ./bin/anim keys.txt 1280 720 --raw | ffmpeg -f rawvideo -pix_fmt rgb24 -s 1280x720 -r 30 -i - zoom.mp4
+int main(int argc, char **argv) {
+    if (argc < 4) {
+        fprintf(stderr, "Usage: %s KEYFILE WIDTH HEIGHT [--out PREFIX | --raw | --shm NAME] [--expmap] [--palette NAME]\n"
+                        "       [--format png|qoi|ppm|pam|bmp|tga|jpg] [--level 0-9] [--encoders N]\n"
+                        "Keyframe lines: frame center_x center_y scale max_iter\n", argv[0]);
+        return 1;
+    }
+
+    AnimOptions opt;
+    memset(&opt, 0, sizeof(opt));
+    opt.width = atoi(argv[2]);
+    opt.height = atoi(argv[3]);
+    opt.palette = PALETTE_DEFAULT;
+    opt.format = IMAGE_PNG;
+    opt.level = -1;
+    opt.prefix = "image/frame";
+    int expmap = 0;
+
+    for (int i = 4; i < argc; i++) {
+        if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+            opt.prefix = argv[++i];
+        } else if (strcmp(argv[i], "--raw") == 0) {
+            opt.prefix = NULL;
+        } else if (strcmp(argv[i], "--shm") == 0 && i + 1 < argc) {
+            opt.shm_name = argv[++i];
+        } else if (strcmp(argv[i], "--expmap") == 0) {
+            expmap = 1;
+        } else if (strcmp(argv[i], "--palette") == 0 && i + 1 < argc && palette_from_name(argv[i + 1]) >= 0) {
+            opt.palette = palette_from_name(argv[++i]);
+        } else if (strcmp(argv[i], "--format") == 0 && i + 1 < argc && image_format_from_name(argv[i + 1]) >= 0) {
+            opt.format = image_format_from_name(argv[++i]);
+        } else if (strcmp(argv[i], "--level") == 0 && i + 1 < argc) {
+            opt.level = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--encoders") == 0 && i + 1 < argc) {
+            opt.encoders = atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "Unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (opt.width <= 0 || opt.height <= 0) {
+        fprintf(stderr, "Invalid frame size\n");
+        return 1;
+    }
+
+    AnimKey *keys;
+    int count;
+    if (!anim_load_keys(argv[1], &keys, &count)) {
+        fprintf(stderr, "Cannot read keyframes from %s\n", argv[1]);
+        return 1;
+    }
+
+    AnimStats stats = { 0 };
+    fprintf(stderr, "Rendering frames %d-%d at %dx%d%s...\n", keys[0].frame,
+            keys[count - 1].frame, opt.width, opt.height, expmap ? " (exponential map)" : "");
+    int ok = expmap ? render_animation_expmap(keys, count, &opt, &stats)
+                    : render_animation(keys, count, &opt, &stats);
+    free(keys);
+    if (!ok) {
+        fprintf(stderr, "Animation failed after %d frames\n", stats.frames);
+        return 1;
+    }
+    if (expmap) fprintf(stderr, "Strip and center render: %.3f seconds\n", stats.prepare_time);
+    fprintf(stderr, "%d frames in %.3f seconds (%.2f fps), render stage %.3f seconds (%.2f fps)\n",
+            stats.frames, stats.total_time, stats.frames / stats.total_time,
+            stats.render_time, stats.frames / stats.render_time);
+    return 0;
+}
@@ -0,0 +1,450 @@
+#include <omp.h>
+#include <pthread.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "animation.h"
+#include "palette.h"
+#include "image_io.h"
+#include "shm_ring.h"
+
+#define EXPMAP_BAND 16  // strip rows per parallel work item
+
+enum { SLOT_FREE = 0, SLOT_RENDERING, SLOT_READY, SLOT_COLORING };
+
+typedef struct {
+    void *pixels;      // iteration counts, or final RGB when rgb is set
+    int rgb;
+    FractalView view;
+    int frame;
+    int state;
+} AnimSlot;
+
+// Fills slot->pixels for one frame on the calling (render) thread
+typedef int (*AnimFrameFn)(void *ctx, int frame, AnimSlot *slot);
+
+typedef struct {
+    const AnimOptions *opt;
+    AnimSlot *slots;
+    int nslots;
+    ShmRing *ring;   // set when frames are published to shared memory
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    int next_write;  // raw output: next frame allowed onto stdout
+    int done;        // producer finished queueing frames
+    int failed;
+} AnimPipe;
+
+int anim_load_keys(const char *path, AnimKey **keys, int *count) {
+    FILE *f = fopen(path, "r");
+    if (!f) return 0;
+    int cap = 16, n = 0, ok = 1;
+    AnimKey *k = malloc(cap * sizeof(AnimKey));
+    char line[512];
+    while (ok && k && fgets(line, sizeof(line), f)) {
+        char *hash = strchr(line, '#');
+        if (hash) *hash = '\0';
+        AnimKey key;
+        int fields = sscanf(line, "%d %lf %lf %lf %d", &key.frame, &key.center_x,
+                            &key.center_y, &key.scale, &key.max_iter);
+        if (fields <= 0) continue;  // blank or comment
+        ok = fields == 5 && key.scale > 0 && key.max_iter > 0 && key.frame >= 0
+             && (n == 0 || key.frame > k[n - 1].frame);
+        if (ok && n == cap) {
+            AnimKey *grown = realloc(k, (size_t)cap * 2 * sizeof(AnimKey));
+            if (!grown) ok = 0;
+            else { k = grown; cap *= 2; }
+        }
+        if (ok) k[n++] = key;
+    }
+    fclose(f);
+    if (!k || !ok || n == 0) {
+        free(k);
+        return 0;
+    }
+    *keys = k;
+    *count = n;
+    return 1;
+}
+
+void anim_view_at(const AnimKey *keys, int count, int frame, FractalView *view) {
+    int i = 0;
+    while (i < count - 2 && frame >= keys[i + 1].frame) i++;
+    const AnimKey *a = &keys[i], *b = &keys[count > 1 ? i + 1 : i];
+
+    double t = b->frame > a->frame ? (double)(frame - a->frame) / (b->frame - a->frame) : 0.0;
+    if (t < 0.0) t = 0.0;
+    if (t > 1.0) t = 1.0;
+    double scale = a->scale * pow(b->scale / a->scale, t);
+    double u = a->scale != b->scale ? (a->scale - scale) / (a->scale - b->scale) : t;
+
+    memset(view, 0, sizeof(*view));
+    view->center_x = a->center_x + u * (b->center_x - a->center_x);
+    view->center_y = a->center_y + u * (b->center_y - a->center_y);
+    view->scale = scale;
+    view->max_iter = (int)lround(a->max_iter + t * (b->max_iter - a->max_iter));
+}
+
+static void pipe_fail(AnimPipe *pipe) {
+    pthread_mutex_lock(&pipe->lock);
+    pipe->failed = 1;
+    pthread_cond_broadcast(&pipe->changed);
+    pthread_mutex_unlock(&pipe->lock);
+}
+
+static void release_slot(AnimPipe *pipe, AnimSlot *slot) {
+    pthread_mutex_lock(&pipe->lock);
+    slot->state = SLOT_FREE;
+    pthread_cond_broadcast(&pipe->changed);
+    pthread_mutex_unlock(&pipe->lock);
+}
+
+// Ordered sinks (stdout, shm ring) take frames strictly in sequence
+static int wait_turn(AnimPipe *pipe, int frame) {
+    pthread_mutex_lock(&pipe->lock);
+    while (pipe->next_write != frame && !pipe->failed)
+        pthread_cond_wait(&pipe->changed, &pipe->lock);
+    int ok = !pipe->failed;
+    pthread_mutex_unlock(&pipe->lock);
+    return ok;
+}
+
+static void next_turn(AnimPipe *pipe) {
+    pthread_mutex_lock(&pipe->lock);
+    pipe->next_write++;
+    pthread_cond_broadcast(&pipe->changed);
+    pthread_mutex_unlock(&pipe->lock);
+}
+
+static void *encoder_main(void *arg) {
+    AnimPipe *pipe = arg;
+    const AnimOptions *opt = pipe->opt;
+    size_t count = (size_t)opt->width * opt->height;
+    unsigned char *rgb = malloc(count * 3);
+    uint32_t *lut = NULL;
+    int lut_iter = -1;
+    int palette = palette_resolve(opt->palette, 0);
+    char path[1024];
+
+    // The render stage owns the cores; colorize here runs single-threaded
+    omp_set_num_threads(1);
+
+    for (;;) {
+        pthread_mutex_lock(&pipe->lock);
+        AnimSlot *slot = NULL;
+        while (!pipe->failed) {
+            for (int i = 0; i < pipe->nslots; i++)
+                if (pipe->slots[i].state == SLOT_READY && (!slot || pipe->slots[i].frame < slot->frame))
+                    slot = &pipe->slots[i];
+            if (slot || pipe->done) break;
+            pthread_cond_wait(&pipe->changed, &pipe->lock);
+        }
+        if (!slot || pipe->failed) {
+            pthread_mutex_unlock(&pipe->lock);
+            break;
+        }
+        slot->state = SLOT_COLORING;
+        pthread_mutex_unlock(&pipe->lock);
+
+        int frame = slot->frame, ok = 1;
+        const unsigned char *out = slot->pixels;
+        if (!slot->rgb) {
+            if (slot->view.max_iter != lut_iter) {
+                free(lut);
+                lut = palette_lut_build(palette, slot->view.max_iter);
+                lut_iter = lut ? slot->view.max_iter : -1;
+                ok = lut != NULL;
+            }
+            if (ok && !pipe->ring) {
+                ok = rgb != NULL;
+                if (ok) colorize(rgb, slot->pixels, count, lut);
+                out = rgb;
+                // Counts are consumed; hand the buffer back to the renderer before encoding
+                release_slot(pipe, slot);
+                slot = NULL;
+            }
+        }
+
+        if (ok && pipe->ring) {
+            // Colorized straight into the shared slot, no intermediate frame
+            if (!wait_turn(pipe, frame)) break;
+            unsigned char *dst = shm_ring_acquire(pipe->ring);
+            if (slot->rgb) memcpy(dst, out, count * 3);
+            else colorize(dst, slot->pixels, count, lut);
+            shm_ring_publish(pipe->ring, frame, &slot->view);
+            next_turn(pipe);
+        } else if (ok && opt->prefix) {
+            snprintf(path, sizeof(path), "%s_%05d.%s", opt->prefix, frame, image_format_ext(opt->format));
+            ok = save_image(path, out, opt->width, opt->height, opt->format, opt->level);
+        } else if (ok) {
+            if (!wait_turn(pipe, frame)) break;
+            ok = fwrite(out, 1, count * 3, stdout) == count * 3;
+            next_turn(pipe);
+        }
+
+        if (slot) release_slot(pipe, slot);
+        if (!ok) pipe_fail(pipe);
+    }
+
+    free(lut);
+    free(rgb);
+    return NULL;
+}
+
+// Frames first..last: fill() runs on this thread, encoders color and write
+static int run_pipeline(int first, int last, const AnimOptions *opt, AnimStats *stats,
+                        AnimFrameFn fill, void *ctx)
+{
+    int encoders = opt->encoders > 0 ? opt->encoders : ANIM_ENCODERS;
+    size_t pixels = (size_t)opt->width * opt->height;
+
+    AnimPipe pipe;
+    memset(&pipe, 0, sizeof(pipe));
+    pipe.opt = opt;
+    pipe.nslots = encoders + 2;  // one rendering, one queued, one per encoder
+    pipe.next_write = first;
+    pipe.slots = calloc((size_t)pipe.nslots, sizeof(AnimSlot));
+    pthread_t *threads = calloc((size_t)encoders, sizeof(pthread_t));
+    int ok = pipe.slots && threads;
+    for (int i = 0; ok && i < pipe.nslots; i++)
+        ok = (pipe.slots[i].pixels = malloc(pixels * sizeof(uint32_t))) != NULL;
+    if (!ok) {
+        for (int i = 0; pipe.slots && i < pipe.nslots; i++) free(pipe.slots[i].pixels);
+        free(pipe.slots);
+        free(threads);
+        return 0;
+    }
+    if (opt->shm_name) {
+        pipe.ring = shm_ring_create(opt->shm_name, opt->width, opt->height, SHM_RING_SLOTS);
+        if (!pipe.ring) ok = 0;
+    }
+    if (!ok) {
+        for (int i = 0; i < pipe.nslots; i++) free(pipe.slots[i].pixels);
+        free(pipe.slots);
+        free(threads);
+        return 0;
+    }
+    pthread_mutex_init(&pipe.lock, NULL);
+    pthread_cond_init(&pipe.changed, NULL);
+    if (!opt->prefix && !pipe.ring) setvbuf(stdout, NULL, _IOFBF, 1 << 20);
+
+    int started = 0;
+    for (; started < encoders; started++)
+        if (pthread_create(&threads[started], NULL, encoder_main, &pipe) != 0) break;
+    if (started == 0) pipe.failed = 1;
+
+    double start = omp_get_wtime(), render_time = 0.0;
+    int frames = 0;
+    for (int f = first; f <= last; f++) {
+        pthread_mutex_lock(&pipe.lock);
+        AnimSlot *slot = NULL;
+        while (!pipe.failed) {
+            for (int i = 0; i < pipe.nslots && !slot; i++)
+                if (pipe.slots[i].state == SLOT_FREE) slot = &pipe.slots[i];
+            if (slot) break;
+            pthread_cond_wait(&pipe.changed, &pipe.lock);
+        }
+        if (pipe.failed) {
+            pthread_mutex_unlock(&pipe.lock);
+            break;
+        }
+        slot->state = SLOT_RENDERING;
+        pthread_mutex_unlock(&pipe.lock);
+
+        slot->frame = f;
+        double t0 = omp_get_wtime();
+        if (!fill(ctx, f, slot)) {
+            pipe_fail(&pipe);
+            break;
+        }
+        render_time += omp_get_wtime() - t0;
+
+        pthread_mutex_lock(&pipe.lock);
+        slot->state = SLOT_READY;
+        pthread_cond_broadcast(&pipe.changed);
+        pthread_mutex_unlock(&pipe.lock);
+        frames++;
+    }
+
+    pthread_mutex_lock(&pipe.lock);
+    pipe.done = 1;
+    pthread_cond_broadcast(&pipe.changed);
+    pthread_mutex_unlock(&pipe.lock);
+    for (int i = 0; i < started; i++) pthread_join(threads[i], NULL);
+    if (!opt->prefix && !pipe.ring && fflush(stdout) != 0) pipe.failed = 1;
+    shm_ring_close(pipe.ring);  // the ring stays in /dev/shm for late readers
+
+    if (stats) {
+        stats->frames = frames;
+        stats->render_time = render_time;
+        stats->total_time = omp_get_wtime() - start;
+    }
+    ok = !pipe.failed && frames == last - first + 1;
+
+    pthread_cond_destroy(&pipe.changed);
+    pthread_mutex_destroy(&pipe.lock);
+    for (int i = 0; i < pipe.nslots; i++) free(pipe.slots[i].pixels);
+    free(pipe.slots);
+    free(threads);
+    return ok;
+}
+
+typedef struct {
+    const AnimKey *keys;
+    int count;
+    const AnimOptions *opt;
+} IterFrames;
+
+static int fill_iter_frame(void *ctx, int frame, AnimSlot *slot) {
+    IterFrames *it = ctx;
+    anim_view_at(it->keys, it->count, frame, &slot->view);
+    slot->view.palette = it->opt->palette;
+    slot->rgb = 0;
+    generate_iter_parallel(slot->pixels, it->opt->width, it->opt->height, &slot->view);
+    return 1;
+}
+
+int render_animation(const AnimKey *keys, int count, const AnimOptions *opt, AnimStats *stats) {
+    if (count <= 0) return 0;
+    IterFrames it = { keys, count, opt };
+    if (stats) stats->prepare_time = 0.0;
+    return run_pipeline(keys[0].frame, keys[count - 1].frame, opt, stats, fill_iter_frame, &it);
+}
+
+typedef struct {
+    const AnimKey *keys;
+    int count;
+    const AnimOptions *opt;
+    FractalView view;        // zoom center and the deepest max_iter
+    unsigned char *strip;    // RGB, strip_w angles x strip_h log radii
+    int strip_w, strip_h;
+    double log_r0, step;
+    unsigned char *inner;    // full render at inner_scale for radii below inner_r
+    double inner_scale, inner_r;
+} ExpMap;
+
+// Bilinear RGB sample at (fx, fy); columns wrap when wrap is set, otherwise clamp
+static inline void sample_rgb(const unsigned char *img, int w, int h, double fx, double fy,
+                              int wrap, unsigned char *out) {
+    if (fx < 0.0 && !wrap) fx = 0.0;
+    if (fy < 0.0) fy = 0.0;
+    if (fy > h - 1) fy = h - 1;
+    if (fx > w - 1 && !wrap) fx = w - 1;
+    int x0 = (int)fx, y0 = (int)fy;
+    double ax = fx - x0, ay = fy - y0;
+    int x1 = x0 + 1, y1 = y0 + 1 < h ? y0 + 1 : y0;
+    if (wrap) {
+        x0 %= w;
+        x1 %= w;
+    } else if (x1 >= w) {
+        x1 = x0;
+    }
+    const unsigned char *p00 = img + ((size_t)y0 * w + x0) * 3, *p01 = img + ((size_t)y0 * w + x1) * 3;
+    const unsigned char *p10 = img + ((size_t)y1 * w + x0) * 3, *p11 = img + ((size_t)y1 * w + x1) * 3;
+    for (int c = 0; c < 3; c++) {
+        double top = p00[c] + ax * (p01[c] - p00[c]);
+        double bottom = p10[c] + ax * (p11[c] - p10[c]);
+        out[c] = (unsigned char)(top + ay * (bottom - top) + 0.5);
+    }
+}
+
+// Frame pixels map to the same offsets render_tile uses, then to polar
+// coordinates in the strip; the disc inside inner_r comes from the inner render
+static int fill_expmap_frame(void *ctx, int frame, AnimSlot *slot) {
+    ExpMap *em = ctx;
+    int width = em->opt->width, height = em->opt->height;
+    double aspect = (double)width / height;
+    FractalView view;
+    anim_view_at(em->keys, em->count, frame, &view);
+    double scale = view.scale;
+    unsigned char *rgb = slot->pixels;
+    slot->rgb = 1;
+    slot->view = em->view;
+
+    #pragma omp parallel for schedule(static)
+    for (int y = 0; y < height; y++) {
+        double dy = ((double)y / height - 0.5) * (scale / aspect);
+        unsigned char *row = rgb + (size_t)y * width * 3;
+        for (int x = 0; x < width; x++) {
+            double dx = ((double)x / width - 0.5) * scale;
+            double r = sqrt(dx * dx + dy * dy);
+            if (r < em->inner_r) {
+                sample_rgb(em->inner, width, height, (dx / em->inner_scale + 0.5) * width,
+                           (dy * aspect / em->inner_scale + 0.5) * height, 0, row + (size_t)x * 3);
+            } else {
+                double theta = atan2(dy, dx);
+                if (theta < 0.0) theta += 2.0 * M_PI;
+                sample_rgb(em->strip, em->strip_w, em->strip_h, theta / em->step,
+                           (log(r) - em->log_r0) / em->step, 1, row + (size_t)x * 3);
+            }
+        }
+    }
+    return 1;
+}
+
+int render_animation_expmap(const AnimKey *keys, int count, const AnimOptions *opt, AnimStats *stats) {
+    if (count <= 0) return 0;
+    int width = opt->width, height = opt->height;
+    ExpMap em;
+    memset(&em, 0, sizeof(em));
+    em.keys = keys;
+    em.count = count;
+    em.opt = opt;
+    em.view.center_x = keys[count - 1].center_x;
+    em.view.center_y = keys[count - 1].center_y;
+    em.view.palette = opt->palette;
+    double min_scale = keys[0].scale, max_scale = keys[0].scale;
+    for (int i = 0; i < count; i++) {
+        if (keys[i].max_iter > em.view.max_iter) em.view.max_iter = keys[i].max_iter;
+        if (keys[i].scale < min_scale) min_scale = keys[i].scale;
+        if (keys[i].scale > max_scale) max_scale = keys[i].scale;
+    }
+
+    // One strip sample per frame pixel at the frame corners, the strip's
+    // coarsest point; radii run from the inner disc of the deepest frame
+    // to the corners of the widest one
+    double half_diag = 0.5 * sqrt((double)width * width + (double)height * height);
+    em.strip_w = (int)ceil(2.0 * M_PI * half_diag);
+    em.step = 2.0 * M_PI / em.strip_w;
+    em.inner_scale = min_scale;
+    em.inner_r = min_scale / width * 0.5 * (width < height ? width : height);
+    em.log_r0 = log(em.inner_r) - em.step;
+    double log_r1 = log(max_scale / width * half_diag) + em.step;
+    em.strip_h = (int)ceil((log_r1 - em.log_r0) / em.step) + 1;
+
+    double start = omp_get_wtime();
+    em.strip = malloc((size_t)em.strip_w * em.strip_h * 3);
+    em.inner = malloc((size_t)width * height * 3);
+    if (!em.strip || !em.inner) {
+        free(em.strip);
+        free(em.inner);
+        return 0;
+    }
+
+    size_t stride = (size_t)em.strip_w * 3;
+    int bands = (em.strip_h + EXPMAP_BAND - 1) / EXPMAP_BAND;
+    #pragma omp parallel for schedule(dynamic)
+    for (int b = 0; b < bands; b++) {
+        int y0 = b * EXPMAP_BAND;
+        int rows = em.strip_h - y0 < EXPMAP_BAND ? em.strip_h - y0 : EXPMAP_BAND;
+        render_expmap_tile(em.strip + (size_t)y0 * stride, stride, em.strip_w, em.log_r0,
+                           &em.view, 0, y0, em.strip_w, rows);
+    }
+
+    FractalView inner = em.view;
+    inner.scale = min_scale;
+    #pragma omp parallel for schedule(dynamic)
+    for (int y = 0; y < height; y++)
+        render_tile(em.inner + (size_t)y * width * 3, (size_t)width * 3, width, height, &inner, 0, y, width, 1);
+    double prepare = omp_get_wtime() - start;
+
+    int ok = run_pipeline(keys[0].frame, keys[count - 1].frame, opt, stats, fill_expmap_frame, &em);
+    if (stats) {
+        stats->prepare_time = prepare;
+        stats->total_time += prepare;
+    }
+    free(em.strip);
+    free(em.inner);
+    return ok;
+}
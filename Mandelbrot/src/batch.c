@@ -0,0 +1,410 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <omp.h>
+#include "fractal.h"
+#include "palette.h"
+#include "png_stream.h"
+#include "image_io.h"
+#include "julia_sweep.h"
+#include "buddhabrot.h"
+#include "miim.h"
+#include "metrics.h"
+#include "trace.h"
+
+// Non-interactive renderer. One job is a set of key=value fields, given as
+// --key value flags or as lines of a job file:
+//   type=julia c=-0.8,0.156 width=1920 height=1080 iter=500 palette=fire output=image/j.png
+// Jobs run back to back in one process, so the OpenMP pool, the palette
+// tables and the frame buffer stay warm. Each finished job prints one JSON
+// line on stdout; progress and errors go to stderr. A job with sweep= renders
+// an atlas of Julia thumbnails, one per c on a grid, plus a CSV index.
+// type=buddhabrot accumulates orbit densities instead; with progress=S the
+// output is rewritten every S seconds as the estimate sharpens.
+
+enum { ENGINE_PARALLEL = 0, ENGINE_SERIAL, ENGINE_STREAM, ENGINE_MIIM };
+
+static const char *engine_names[] = { "parallel", "serial", "stream", "miim" };
+
+typedef struct {
+    FractalView view;
+    int width, height;
+    int auto_iter;
+    int engine, equalize, level;
+    int sweep;                   // Julia atlas instead of a single frame
+    JuliaSweep grid;
+    int buddha;                  // orbit density instead of escape time
+    BuddhaParams orbits;         // size, window and max_iter are copied from the job
+    double progress;             // seconds between progressive saves, 0 = end only
+    char output[512];
+} BatchJob;
+
+static void job_defaults(BatchJob *job) {
+    memset(job, 0, sizeof(*job));
+    job->view = (FractalView){ 1000, -0.5, 0.0, 4.0, 0, -0.8, 0.156, PALETTE_DEFAULT };
+    job->width = 1920;
+    job->height = 1080;
+    job->level = -1;
+    job->grid = (JuliaSweep){ 64, 64, 32, -2.0, -1.5, 1.0, 1.5 };
+    job->orbits.min_iter = 20;
+    job->orbits.samples = 100000000;
+    job->orbits.seed = 1;
+}
+
+// Applies one field; returns 0 for an unknown key or a bad value
+static int job_set(BatchJob *job, const char *key, const char *value) {
+    if (strcmp(key, "type") == 0) {
+        if (strcmp(value, "mandelbrot") != 0 && strcmp(value, "julia") != 0 && strcmp(value, "buddhabrot") != 0)
+            return 0;
+        job->view.julia = strcmp(value, "julia") == 0;
+        job->buddha = strcmp(value, "buddhabrot") == 0;
+    } else if (strcmp(key, "width") == 0) {
+        job->width = atoi(value);
+    } else if (strcmp(key, "height") == 0) {
+        job->height = atoi(value);
+    } else if (strcmp(key, "center") == 0) {
+        return sscanf(value, "%lf,%lf", &job->view.center_x, &job->view.center_y) == 2;
+    } else if (strcmp(key, "c") == 0) {
+        return sscanf(value, "%lf,%lf", &job->view.c_real, &job->view.c_imag) == 2;
+    } else if (strcmp(key, "sweep") == 0) {
+        job->sweep = 1;
+        return sscanf(value, "%lf,%lf,%lf,%lf", &job->grid.re_min, &job->grid.im_min,
+                      &job->grid.re_max, &job->grid.im_max) == 4;
+    } else if (strcmp(key, "grid") == 0) {
+        return sscanf(value, "%d,%d", &job->grid.cols, &job->grid.rows) == 2;
+    } else if (strcmp(key, "thumb") == 0) {
+        job->grid.thumb = atoi(value);
+    } else if (strcmp(key, "scale") == 0) {
+        job->view.scale = atof(value);
+    } else if (strcmp(key, "iter") == 0) {
+        job->auto_iter = strcmp(value, "auto") == 0;
+        if (!job->auto_iter) job->view.max_iter = atoi(value);
+    } else if (strcmp(key, "palette") == 0) {
+        if (palette_from_name(value) < 0) return 0;
+        job->view.palette = palette_from_name(value);
+    } else if (strcmp(key, "equalize") == 0) {
+        job->equalize = atoi(value) != 0;
+    } else if (strcmp(key, "engine") == 0) {
+        for (int i = 0; i < (int)(sizeof(engine_names) / sizeof(engine_names[0])); i++) {
+            if (strcmp(value, engine_names[i]) != 0) continue;
+            job->engine = i;
+            return 1;
+        }
+        return 0;
+    } else if (strcmp(key, "level") == 0) {
+        job->level = atoi(value);
+    } else if (strcmp(key, "samples") == 0) {
+        double samples = strtod(value, NULL);   // accepts 1e9
+        if (samples < 1.0) return 0;
+        job->orbits.samples = (uint64_t)samples;
+    } else if (strcmp(key, "min_iter") == 0) {
+        job->orbits.min_iter = atoi(value);
+    } else if (strcmp(key, "anti") == 0) {
+        job->orbits.anti = atoi(value) != 0;
+    } else if (strcmp(key, "seed") == 0) {
+        job->orbits.seed = strtoull(value, NULL, 10);
+    } else if (strcmp(key, "progress") == 0) {
+        job->progress = atof(value);
+    } else if (strcmp(key, "output") == 0) {
+        snprintf(job->output, sizeof(job->output), "%s", value);
+    } else {
+        return 0;
+    }
+    return 1;
+}
+
+static int job_format(const BatchJob *job) {
+    const char *dot = strrchr(job->output, '.');
+    return dot ? image_format_from_name(dot + 1) : -1;
+}
+
+static int job_valid(const BatchJob *job, char *why, size_t size) {
+    int format = job_format(job);
+    if (job->width <= 0 || job->height <= 0) snprintf(why, size, "invalid size");
+    else if (!job->auto_iter && job->view.max_iter <= 0) snprintf(why, size, "invalid iter");
+    else if (!job->output[0]) snprintf(why, size, "missing output");
+    else if (format < 0) snprintf(why, size, "unknown output extension");
+    else if (job->engine == ENGINE_STREAM && format != IMAGE_PNG) snprintf(why, size, "stream engine writes PNG only");
+    else if (job->sweep && (job->grid.cols <= 0 || job->grid.rows <= 0 || job->grid.thumb <= 0))
+        snprintf(why, size, "invalid sweep grid");
+    else if (job->engine == ENGINE_MIIM && (!job->view.julia || job->sweep || job->buddha || job->equalize))
+        snprintf(why, size, "miim renders single Julia sets without equalize");
+    else if (job->sweep && job->auto_iter) snprintf(why, size, "sweeps need a fixed iter");
+    else if (job->sweep && (job->engine != ENGINE_PARALLEL || job->equalize))
+        snprintf(why, size, "sweeps use the parallel engine without equalize");
+    else if (job->buddha && job->sweep) snprintf(why, size, "sweeps render Julia sets only");
+    else if (job->buddha && job->auto_iter) snprintf(why, size, "buddhabrot needs a fixed iter");
+    else if (job->buddha && (job->engine != ENGINE_PARALLEL || job->equalize))
+        snprintf(why, size, "buddhabrot uses the parallel engine without equalize");
+    else if (job->buddha && job->orbits.min_iter >= job->view.max_iter)
+        snprintf(why, size, "min_iter must be below iter");
+    else return 1;
+    return 0;
+}
+
+// Reads jobs from a file ("-" for stdin), one per line, starting from the defaults
+static int load_jobs(const char *path, const BatchJob *defaults, BatchJob **jobs, int *count, int *cap) {
+    FILE *f = strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+    if (!f) return 0;
+    char line[2048];
+    int line_no = 0, ok = 1;
+    while (ok && fgets(line, sizeof(line), f)) {
+        line_no++;
+        char *hash = strchr(line, '#');
+        if (hash) *hash = '\0';
+        BatchJob job = *defaults;
+        int fields = 0;
+        for (char *tok = strtok(line, " \t\r\n"); tok; tok = strtok(NULL, " \t\r\n")) {
+            char *eq = strchr(tok, '=');
+            if (eq) *eq = '\0';
+            if (!eq || !job_set(&job, tok, eq + 1)) {
+                fprintf(stderr, "%s:%d: bad field '%s'\n", path, line_no, tok);
+                ok = 0;
+                break;
+            }
+            fields++;
+        }
+        if (!ok || fields == 0) continue;
+        if (*count == *cap) {
+            *cap = *cap ? *cap * 2 : 64;
+            BatchJob *grown = realloc(*jobs, (size_t)*cap * sizeof(BatchJob));
+            if (!grown) {
+                ok = 0;
+                break;
+            }
+            *jobs = grown;
+        }
+        (*jobs)[(*count)++] = job;
+    }
+    if (f != stdin) fclose(f);
+    return ok;
+}
+
+static void print_json_string(const char *s) {
+    putchar('"');
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\') putchar('\\');
+        if ((unsigned char)*s >= 0x20) putchar(*s);
+    }
+    putchar('"');
+}
+
+// Atlas of Julia thumbnails plus <output>.csv (extension replaced) indexing them
+static int run_sweep(BatchJob *job, unsigned char *atlas, double *render_time, double *save_time) {
+    JuliaSweep *g = &job->grid;
+    size_t count = (size_t)g->cols * g->rows;
+    float *interior = malloc(count * sizeof(float));
+    if (!interior) return 0;
+    double start = omp_get_wtime();
+    generate_julia_sweep(atlas, g, &job->view, interior);
+    *render_time = omp_get_wtime() - start;
+
+    char index[sizeof(job->output) + 8];
+    snprintf(index, sizeof(index), "%.*s.csv", (int)(strrchr(job->output, '.') - job->output), job->output);
+    start = omp_get_wtime();
+    int ok = save_image(job->output, atlas, job->width, job->height, job_format(job), job->level)
+             && save_julia_sweep_index(index, g, interior);
+    *save_time = omp_get_wtime() - start;
+    free(interior);
+    return ok;
+}
+
+typedef struct {
+    const BatchJob *job;
+    unsigned char *rgb;
+    int saved;
+} BuddhaOutput;
+
+// Progressive save: tone-map the density so far and overwrite the output
+static int save_buddha_progress(const uint64_t *density, const BuddhaStats *stats, void *user) {
+    BuddhaOutput *out = user;
+    const BatchJob *job = out->job;
+    buddha_colorize(out->rgb, density, (size_t)job->width * job->height, job->view.palette);
+    out->saved = save_image(job->output, out->rgb, job->width, job->height, job_format(job), job->level);
+    fprintf(stderr, "%s: %llu/%llu samples, %.1fs\n", job->output, (unsigned long long)stats->samples,
+            (unsigned long long)job->orbits.samples, stats->total_time);
+    return out->saved;
+}
+
+// Orbit density; the last progress call writes the final image
+static int run_buddhabrot(BatchJob *job, unsigned char *rgb, double *render_time, double *save_time) {
+    BuddhaParams *p = &job->orbits;
+    p->width = job->width;
+    p->height = job->height;
+    p->center_x = job->view.center_x;
+    p->center_y = job->view.center_y;
+    p->scale = job->view.scale;
+    p->max_iter = job->view.max_iter;
+    uint64_t *density = malloc((size_t)job->width * job->height * sizeof(uint64_t));
+    if (!density) return 0;
+
+    BuddhaOutput out = { job, rgb, 0 };
+    BuddhaStats stats;
+    double start = omp_get_wtime();
+    int ok = render_buddhabrot(density, p, job->progress, save_buddha_progress, &out, &stats) && out.saved;
+    *render_time = omp_get_wtime() - start;
+    *save_time = 0.0;   // included in render_time, saves interleave with rounds
+    free(density);
+    if (ok)
+        fprintf(stderr, "%s: %llu orbits traced, %.1f%% of c sampled, %s\n", job->output,
+                (unsigned long long)stats.orbits, stats.active_fraction * 100.0,
+                stats.atomics ? "atomic counters" : "per-thread histograms");
+    return ok;
+}
+
+// Renders one job into the shared buffer (grown on demand) and saves it
+static int run_job(BatchJob *job, unsigned char **buffer, size_t *buffer_size,
+                   double *render_time, double *save_time) {
+    FractalView *v = &job->view;
+    if (job->sweep) {
+        v->julia = 1;
+        job->width = job->grid.cols * job->grid.thumb;
+        job->height = job->grid.rows * job->grid.thumb;
+    }
+    size_t bytes = (size_t)job->width * job->height * 3;
+    int format = job_format(job);
+    *render_time = *save_time = 0.0;
+
+    if (job->auto_iter)
+        v->max_iter = auto_max_iter(job->width, job->height, v->center_x, v->center_y, v->scale,
+                                    v->julia, v->c_real, v->c_imag, AUTO_ITER_FIXED, NULL);
+
+    double start = omp_get_wtime();
+    if (job->engine == ENGINE_STREAM) {
+        // Render and deflate band by band; the frame never exists in RAM
+        int ok = generate_png_streamed(job->output, job->width, job->height, v, job->level);
+        *render_time = omp_get_wtime() - start;
+        return ok;
+    }
+
+    if (bytes > *buffer_size) {
+        unsigned char *grown = realloc(*buffer, bytes);
+        if (!grown) return 0;
+        *buffer = grown;
+        *buffer_size = bytes;
+    }
+    if (job->sweep) return run_sweep(job, *buffer, render_time, save_time);
+    if (job->buddha) return run_buddhabrot(job, *buffer, render_time, save_time);
+
+    int ok = 1;
+    if (job->engine == ENGINE_SERIAL) {
+        if (v->julia)
+            generate_julia_serial(*buffer, job->width, job->height, v->max_iter,
+                                  v->center_x, v->center_y, v->scale, v->c_real, v->c_imag);
+        else
+            generate_serial(*buffer, job->width, job->height, v->max_iter, v->center_x, v->center_y, v->scale);
+    } else if (job->engine == ENGINE_MIIM) {
+        MiimStats stats;
+        ok = generate_julia_miim(*buffer, job->width, job->height, v, &stats);
+        if (ok)
+            fprintf(stderr, "%s: %llu boundary pixels from %llu preimages, depth %d\n", job->output,
+                    (unsigned long long)stats.pixels, (unsigned long long)stats.points, stats.depth);
+    } else if (job->equalize) {
+        ok = generate_palette_parallel(*buffer, job->width, job->height, v, 1);
+    } else {
+        generate_output_parallel(*buffer, job->width, job->height, v, OUTPUT_RGB);
+    }
+    *render_time = omp_get_wtime() - start;
+    if (!ok) return 0;
+
+    start = omp_get_wtime();
+    ok = save_image(job->output, *buffer, job->width, job->height, format, job->level);
+    *save_time = omp_get_wtime() - start;
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    BatchJob defaults, *jobs = NULL;
+    int count = 0, cap = 0, from_file = 0, keep_going = 0;
+    const char *metrics_path = NULL, *trace_path = NULL;
+    job_defaults(&defaults);
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc) {
+            if (!load_jobs(argv[++i], &defaults, &jobs, &count, &cap)) {
+                fprintf(stderr, "Cannot read jobs from %s\n", argv[i]);
+                return 1;
+            }
+            from_file = 1;
+        } else if (strcmp(argv[i], "--keep-going") == 0) {
+            keep_going = 1;
+        } else if (strcmp(argv[i], "--metrics") == 0 && i + 1 < argc) {
+            metrics_path = argv[++i];
+        } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            trace_path = argv[++i];
+        } else if (strncmp(argv[i], "--", 2) == 0 && i + 1 < argc && job_set(&defaults, argv[i] + 2, argv[i + 1])) {
+            i++;
+        } else {
+            fprintf(stderr, "Usage: %s [--type mandelbrot|julia|buddhabrot] [--width N] [--height N] [--center X,Y] [--scale S]\n"
+                            "       [--c RE,IM] [--iter N|auto] [--palette NAME] [--equalize 0|1] [--level 0-9]\n"
+                            "       [--engine parallel|serial|stream|miim] [--output FILE.ext] [--jobs FILE|-] [--keep-going]\n"
+                            "       [--metrics FILE.prom] [--trace FILE.json]\n"
+                            "       [--sweep RE0,IM0,RE1,IM1 [--grid COLS,ROWS] [--thumb N]]\n"
+                            "       [--samples N] [--min_iter N] [--anti 0|1] [--seed N] [--progress S]   (buddhabrot)\n"
+                            "Flags before --jobs are defaults for every job line; without --jobs they describe one render.\n",
+                    argv[0]);
+            return 1;
+        }
+    }
+    if (!from_file) {
+        jobs = malloc(sizeof(BatchJob));
+        if (!jobs) return 1;
+        jobs[count++] = defaults;
+    }
+    if (trace_path && !trace_start(TRACE_DEFAULT_EVENTS)) {
+        fprintf(stderr, "Cannot allocate the trace buffer\n");
+        free(jobs);
+        return 1;
+    }
+
+    // Start the thread pool once; every job after this reuses it
+    double start = omp_get_wtime();
+    #pragma omp parallel
+    {
+    }
+
+    unsigned char *buffer = NULL;
+    size_t buffer_size = 0;
+    int failed = 0, done = 0;
+    double pixels = 0.0;
+    for (int i = 0; i < count && (keep_going || !failed); i++) {
+        BatchJob *job = &jobs[i];
+        char why[64] = "";
+        double render_time = 0.0, save_time = 0.0;
+        int ok = job_valid(job, why, sizeof(why));
+        if (ok) {
+            uint64_t span = trace_begin();
+            ok = run_job(job, &buffer, &buffer_size, &render_time, &save_time);
+            trace_end("job", span, 0, 0, job->width, job->height);
+            if (!ok) snprintf(why, sizeof(why), "render or save failed");
+        }
+        if (ok) {
+            metrics_observe(METRIC_FRAME_SECONDS, render_time);
+            done++;
+            pixels += (double)job->width * job->height;
+        } else {
+            failed++;
+            fprintf(stderr, "Job %d (%s): %s\n", i + 1, job->output, why);
+        }
+        printf("{\"job\":%d,\"output\":", i + 1);
+        print_json_string(job->output);
+        printf(",\"type\":\"%s\",\"engine\":\"%s\",\"width\":%d,\"height\":%d,\"max_iter\":%d,"
+               "\"render_s\":%.6f,\"save_s\":%.6f,\"ok\":%s}\n",
+               job->buddha ? "buddhabrot" : job->view.julia ? "julia" : "mandelbrot", engine_names[job->engine], job->width, job->height,
+               job->view.max_iter, render_time, save_time, ok ? "true" : "false");
+        fflush(stdout);
+        // Rewritten after every job so a scraper follows long batches
+        if (metrics_path && !metrics_write(metrics_path))
+            fprintf(stderr, "Cannot write metrics to %s\n", metrics_path);
+    }
+    double total = omp_get_wtime() - start;
+    printf("{\"summary\":true,\"jobs\":%d,\"ok\":%d,\"failed\":%d,\"total_s\":%.6f,\"jobs_per_s\":%.3f,\"mpixels_per_s\":%.3f}\n",
+           count, done, failed, total, done / total, pixels / total / 1e6);
+
+    if (trace_path && !trace_write(trace_path))
+        fprintf(stderr, "Cannot write trace to %s\n", trace_path);
+
+    free(buffer);
+    free(jobs);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,353 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <omp.h>
+#include "fractal.h"
+#include "palette.h"
+#include "miim.h"
+#include "metrics.h"
+
+// Performance suite: every engine over fixed viewports, resolutions and
+// iteration limits, with warmup runs and repetitions. Prints one JSON
+// document with per-case medians and spread on stdout; with --baseline it
+// compares against an earlier run and flags regressions on stderr.
+#define BENCH_MAX_LIST 16
+#define BENCH_MAX_CASES 4096
+
+enum { ENGINE_SERIAL = 0, ENGINE_PARALLEL, ENGINE_TILED, ENGINE_COLORIZE, ENGINE_EQUALIZE, ENGINE_MIIM, ENGINE_COUNT };
+
+static const char *engine_names[ENGINE_COUNT] = { "serial", "parallel", "tiled", "colorize", "equalize", "miim" };
+
+typedef struct {
+    const char *name;
+    FractalView view;          // max_iter comes from the iteration list
+} BenchView;
+
+static const BenchView bench_views[] = {
+    { "full",       { 0, -0.5,    0.0,    4.0,  0, 0.0,  0.0,  PALETTE_DEFAULT } },  // whole set, mostly fast escapes
+    { "seahorse",   { 0, -0.7436, 0.1318, 0.01, 0, 0.0,  0.0,  PALETTE_DEFAULT } },  // boundary detail, mixed escape times
+    { "interior",   { 0, -0.2,    0.0,    0.2,  0, 0.0,  0.0,  PALETTE_DEFAULT } },  // inside the cardioid: every pixel runs to max_iter
+    { "julia_dust", { 0, 0.0,     0.0,    3.0,  1, 0.28, 0.01, PALETTE_DEFAULT } },  // c just outside the set: Fatou dust
+};
+#define VIEW_COUNT ((int)(sizeof(bench_views) / sizeof(bench_views[0])))
+
+typedef struct {
+    char engine[16], view[16];
+    int width, height, max_iter;
+    double median, mean, stddev, min, max;
+    double iterations;          // per frame, from the metrics counters (0 for miim)
+} BenchResult;
+
+static int run_engine(int engine, unsigned char *image, int width, int height, const FractalView *v) {
+    switch (engine) {
+    case ENGINE_SERIAL:
+        if (v->julia)
+            generate_julia_serial(image, width, height, v->max_iter, v->center_x, v->center_y, v->scale,
+                                  v->c_real, v->c_imag);
+        else
+            generate_serial(image, width, height, v->max_iter, v->center_x, v->center_y, v->scale);
+        return 1;
+    case ENGINE_PARALLEL:
+        if (v->julia)
+            generate_julia_parallel(image, width, height, v->max_iter, v->center_x, v->center_y, v->scale,
+                                    v->c_real, v->c_imag);
+        else
+            generate_parallel(image, width, height, v->max_iter, v->center_x, v->center_y, v->scale);
+        return 1;
+    case ENGINE_TILED:
+        generate_output_parallel(image, width, height, v, OUTPUT_RGB);
+        return 1;
+    case ENGINE_COLORIZE:
+        return generate_palette_parallel(image, width, height, v, 0);
+    case ENGINE_EQUALIZE:
+        return generate_palette_parallel(image, width, height, v, 1);
+    default: {
+        MiimStats stats;
+        return generate_julia_miim(image, width, height, v, &stats);
+    }
+    }
+}
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Comma-separated names into a bitmask over names[0..count)
+static int parse_names(const char *list, const char *const *names, int count, unsigned *mask) {
+    *mask = 0;
+    char buf[256];
+    snprintf(buf, sizeof(buf), "%s", list);
+    for (char *tok = strtok(buf, ","); tok; tok = strtok(NULL, ",")) {
+        int found = 0;
+        for (int i = 0; i < count; i++) {
+            if (strcmp(tok, names[i]) == 0) {
+                *mask |= 1u << i;
+                found = 1;
+            }
+        }
+        if (!found) return 0;
+    }
+    return *mask != 0;
+}
+
+// "640x360,1920x1080" or "256,1024": pairs when height is given
+static int parse_ints(const char *list, int *a, int *b, int max) {
+    int n = 0;
+    const char *p = list;
+    while (*p && n < max) {
+        char *end;
+        a[n] = (int)strtol(p, &end, 10);
+        if (end == p || a[n] <= 0) return 0;
+        if (b) {
+            if (*end != 'x') return 0;
+            p = end + 1;
+            b[n] = (int)strtol(p, &end, 10);
+            if (end == p || b[n] <= 0) return 0;
+        }
+        n++;
+        if (*end == ',') end++;
+        else if (*end) return 0;
+        p = end;
+    }
+    return *p ? 0 : n;
+}
+
+static void run_case(int engine, const BenchView *bv, int width, int height, int max_iter,
+                     int warmup, int reps, unsigned char *image, BenchResult *r) {
+    FractalView v = bv->view;
+    v.max_iter = max_iter;
+    double *times = malloc((size_t)reps * sizeof(double));
+    memset(r, 0, sizeof(*r));
+    snprintf(r->engine, sizeof(r->engine), "%s", engine_names[engine]);
+    snprintf(r->view, sizeof(r->view), "%s", bv->name);
+    r->width = width;
+    r->height = height;
+    r->max_iter = max_iter;
+    if (!times) return;
+
+    for (int i = 0; i < warmup; i++) run_engine(engine, image, width, height, &v);
+    for (int i = 0; i < reps; i++) {
+        uint64_t before = metrics_counter(METRIC_ITERATIONS);
+        double start = omp_get_wtime();
+        run_engine(engine, image, width, height, &v);
+        times[i] = omp_get_wtime() - start;
+        if (i == 0) r->iterations = (double)(metrics_counter(METRIC_ITERATIONS) - before);
+    }
+
+    double sum = 0.0;
+    for (int i = 0; i < reps; i++) sum += times[i];
+    r->mean = sum / reps;
+    double sq = 0.0;
+    for (int i = 0; i < reps; i++) sq += (times[i] - r->mean) * (times[i] - r->mean);
+    r->stddev = reps > 1 ? sqrt(sq / (reps - 1)) : 0.0;
+    qsort(times, (size_t)reps, sizeof(double), compare_double);
+    r->median = reps % 2 ? times[reps / 2] : 0.5 * (times[reps / 2 - 1] + times[reps / 2]);
+    r->min = times[0];
+    r->max = times[reps - 1];
+    free(times);
+}
+
+static void print_result(const BenchResult *r, int last) {
+    printf("{\"engine\":\"%s\",\"view\":\"%s\",\"width\":%d,\"height\":%d,\"max_iter\":%d,"
+           "\"median_s\":%.6f,\"mean_s\":%.6f,\"stddev_s\":%.6f,\"variance_s2\":%.3e,\"min_s\":%.6f,\"max_s\":%.6f,"
+           "\"mpixels_per_s\":%.3f,\"iterations\":%.0f}%s\n",
+           r->engine, r->view, r->width, r->height, r->max_iter, r->median, r->mean, r->stddev,
+           r->stddev * r->stddev, r->min, r->max, (double)r->width * r->height / r->median / 1e6,
+           r->iterations, last ? "" : ",");
+}
+
+// Just enough JSON for the files print_result writes: one result per line
+static int json_string(const char *line, const char *key, char *out, size_t size) {
+    char pattern[64];
+    snprintf(pattern, sizeof(pattern), "\"%s\":\"", key);
+    const char *p = strstr(line, pattern);
+    if (!p) return 0;
+    p += strlen(pattern);
+    size_t n = 0;
+    while (p[n] && p[n] != '"') n++;
+    if (n >= size) return 0;
+    memcpy(out, p, n);
+    out[n] = '\0';
+    return 1;
+}
+
+static int json_number(const char *line, const char *key, double *out) {
+    char pattern[64];
+    snprintf(pattern, sizeof(pattern), "\"%s\":", key);
+    const char *p = strstr(line, pattern);
+    if (!p) return 0;
+    char *end;
+    *out = strtod(p + strlen(pattern), &end);
+    return end != p + strlen(pattern);
+}
+
+static int load_baseline(const char *path, BenchResult **out, int *count, int *threads) {
+    FILE *f = fopen(path, "r");
+    if (!f) return 0;
+    BenchResult *results = NULL;
+    int n = 0, cap = 0;
+    char line[1024];
+    *threads = 0;
+    while (fgets(line, sizeof(line), f)) {
+        double t;
+        if (strstr(line, "\"bench\":") && json_number(line, "threads", &t)) *threads = (int)t;
+        BenchResult r;
+        memset(&r, 0, sizeof(r));
+        double w, h, it;
+        if (!json_string(line, "engine", r.engine, sizeof(r.engine)) || !json_string(line, "view", r.view, sizeof(r.view))
+            || !json_number(line, "width", &w) || !json_number(line, "height", &h)
+            || !json_number(line, "max_iter", &it) || !json_number(line, "median_s", &r.median))
+            continue;
+        json_number(line, "stddev_s", &r.stddev);
+        r.width = (int)w;
+        r.height = (int)h;
+        r.max_iter = (int)it;
+        if (n == cap) {
+            cap = cap ? cap * 2 : 64;
+            BenchResult *grown = realloc(results, (size_t)cap * sizeof(BenchResult));
+            if (!grown) {
+                free(results);
+                fclose(f);
+                return 0;
+            }
+            results = grown;
+        }
+        results[n++] = r;
+    }
+    fclose(f);
+    *out = results;
+    *count = n;
+    return 1;
+}
+
+// A case regresses when its median is slower by more than the threshold and
+// by more than three standard deviations of the noisier run, so jitter on
+// fast cases does not trip it
+static int compare_baseline(const BenchResult *results, int count, const BenchResult *base, int base_count,
+                            double threshold) {
+    int regressions = 0, improvements = 0, compared = 0;
+    for (int i = 0; i < count; i++) {
+        const BenchResult *r = &results[i];
+        const BenchResult *b = NULL;
+        for (int j = 0; j < base_count && !b; j++) {
+            if (strcmp(base[j].engine, r->engine) == 0 && strcmp(base[j].view, r->view) == 0
+                && base[j].width == r->width && base[j].height == r->height && base[j].max_iter == r->max_iter)
+                b = &base[j];
+        }
+        if (!b || b->median <= 0.0) continue;
+        compared++;
+        double change = r->median / b->median - 1.0;
+        double noise = 3.0 * fmax(r->stddev, b->stddev);
+        const char *verdict = NULL;
+        if (change > threshold && r->median - b->median > noise) {
+            verdict = "REGRESSION";
+            regressions++;
+        } else if (change < -threshold && b->median - r->median > noise) {
+            verdict = "improved";
+            improvements++;
+        }
+        if (verdict)
+            fprintf(stderr, "%-10s %-8s %-10s %5dx%-5d iter %-6d %.6f s -> %.6f s (%+.1f%%)\n", verdict,
+                    r->engine, r->view, r->width, r->height, r->max_iter, b->median, r->median, 100.0 * change);
+    }
+    fprintf(stderr, "Baseline: %d of %d cases compared, %d regressions, %d improvements (threshold %.0f%%)\n",
+            compared, count, regressions, improvements, 100.0 * threshold);
+    return regressions;
+}
+
+int main(int argc, char **argv) {
+    unsigned engines = (1u << ENGINE_COUNT) - 1, views = (1u << VIEW_COUNT) - 1;
+    int widths[BENCH_MAX_LIST] = { 640, 1280 }, heights[BENCH_MAX_LIST] = { 360, 720 }, sizes = 2;
+    int iters[BENCH_MAX_LIST] = { 200, 1000 }, iter_count = 2;
+    int warmup = 1, reps = 5;
+    double threshold = 0.10;
+    const char *baseline = NULL;
+    const char *view_names[VIEW_COUNT];
+    for (int i = 0; i < VIEW_COUNT; i++) view_names[i] = bench_views[i].name;
+
+    for (int i = 1; i < argc; i++) {
+        int ok = 1;
+        if (strcmp(argv[i], "--engines") == 0 && i + 1 < argc) {
+            ok = parse_names(argv[++i], engine_names, ENGINE_COUNT, &engines);
+        } else if (strcmp(argv[i], "--views") == 0 && i + 1 < argc) {
+            ok = parse_names(argv[++i], view_names, VIEW_COUNT, &views);
+        } else if (strcmp(argv[i], "--sizes") == 0 && i + 1 < argc) {
+            ok = (sizes = parse_ints(argv[++i], widths, heights, BENCH_MAX_LIST)) > 0;
+        } else if (strcmp(argv[i], "--iters") == 0 && i + 1 < argc) {
+            ok = (iter_count = parse_ints(argv[++i], iters, NULL, BENCH_MAX_LIST)) > 0;
+        } else if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc) {
+            warmup = atoi(argv[++i]);
+            ok = warmup >= 0;
+        } else if (strcmp(argv[i], "--reps") == 0 && i + 1 < argc) {
+            reps = atoi(argv[++i]);
+            ok = reps > 0;
+        } else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc) {
+            baseline = argv[++i];
+        } else if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc) {
+            threshold = atof(argv[++i]) / 100.0;
+            ok = threshold > 0.0;
+        } else {
+            ok = 0;
+        }
+        if (!ok) {
+            fprintf(stderr, "Usage: %s [--engines serial,parallel,tiled,colorize,equalize,miim]\n"
+                            "       [--views full,seahorse,interior,julia_dust] [--sizes 640x360,1280x720]\n"
+                            "       [--iters 200,1000] [--warmup N] [--reps N] [--baseline FILE.json] [--threshold PCT]\n"
+                            "Writes JSON results to stdout; exits with 2 if any case regressed against the baseline.\n",
+                    argv[0]);
+            return 1;
+        }
+    }
+
+    BenchResult *base = NULL;
+    int base_count = 0, base_threads = 0;
+    if (baseline && !load_baseline(baseline, &base, &base_count, &base_threads)) {
+        fprintf(stderr, "Cannot read baseline %s\n", baseline);
+        return 1;
+    }
+    if (base && base_threads && base_threads != omp_get_max_threads())
+        fprintf(stderr, "Warning: baseline ran on %d threads, this run on %d\n", base_threads, omp_get_max_threads());
+
+    size_t largest = 0;
+    for (int s = 0; s < sizes; s++)
+        if ((size_t)widths[s] * heights[s] > largest) largest = (size_t)widths[s] * heights[s];
+    unsigned char *image = malloc(largest * 3);
+    BenchResult *results = malloc(BENCH_MAX_CASES * sizeof(BenchResult));
+    if (!image || !results) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+    // Fault the frame in once, so the first case does not pay for it
+    memset(image, 0, largest * 3);
+
+    int count = 0;
+    for (int e = 0; e < ENGINE_COUNT; e++) {
+        if (!(engines & (1u << e))) continue;
+        for (int v = 0; v < VIEW_COUNT; v++) {
+            if (!(views & (1u << v))) continue;
+            if (e == ENGINE_MIIM && !bench_views[v].view.julia) continue;
+            for (int s = 0; s < sizes; s++) {
+                for (int it = 0; it < iter_count && count < BENCH_MAX_CASES; it++) {
+                    BenchResult *r = &results[count++];
+                    run_case(e, &bench_views[v], widths[s], heights[s], iters[it], warmup, reps, image, r);
+                    fprintf(stderr, "%-8s %-10s %5dx%-5d iter %-6d median %.6f s  stddev %.6f s\n", r->engine,
+                            r->view, r->width, r->height, r->max_iter, r->median, r->stddev);
+                }
+            }
+        }
+    }
+
+    printf("{\"bench\":\"mandelbrot\",\"version\":1,\"threads\":%d,\"warmup\":%d,\"repetitions\":%d,\"results\":[\n",
+           omp_get_max_threads(), warmup, reps);
+    for (int i = 0; i < count; i++) print_result(&results[i], i == count - 1);
+    printf("]}\n");
+    fflush(stdout);
+
+    int regressions = base ? compare_baseline(results, count, base, base_count, threshold) : 0;
+    free(base);
+    free(results);
+    free(image);
+    return regressions ? 2 : 0;
+}
@@ -0,0 +1,247 @@
+#include <omp.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "buddhabrot.h"
+#include "palette.h"
+
+#define BUDDHA_TONE_SAMPLES 65536
+#define BUDDHA_TONE_PERCENTILE 0.999
+
+// splitmix64: one stream per chunk, seeded from the chunk index
+static inline uint64_t next_random(uint64_t *state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+static inline double next_unit(uint64_t *state) {
+    return (double)(next_random(state) >> 11) * 0x1.0p-53;
+}
+
+// Iterates z -> z^2 + c from 0, storing every point. Returns the number of
+// points stored; *escaped tells whether the last one left |z| <= 2.
+static inline int trace_orbit(double cx, double cy, int max_iter, double *orbit, int *escaped) {
+    double zx = 0.0, zy = 0.0;
+    for (int n = 0; n < max_iter; n++) {
+        double x2 = zx * zx, y2 = zy * zy;
+        zy = 2.0 * zx * zy + cy;
+        zx = x2 - y2 + cx;
+        orbit[2 * n] = zx;
+        orbit[2 * n + 1] = zy;
+        if (zx * zx + zy * zy > 4.0) {
+            *escaped = 1;
+            return n + 1;
+        }
+    }
+    *escaped = 0;
+    return max_iter;
+}
+
+static int contributes(const BuddhaParams *p, int points, int escaped) {
+    return p->anti ? !escaped : escaped && points >= p->min_iter;
+}
+
+// Cells of the upper half of [-2, 2]^2 worth sampling: a probe point
+// contributes, or the cell straddles the boundary (escaping and interior
+// probes), where the long orbits live. Grown by one cell to catch thin
+// features the probes miss.
+static int *build_importance_map(const BuddhaParams *p, int *count) {
+    size_t cells = (size_t)BUDDHA_GRID_X * BUDDHA_GRID_Y;
+    unsigned char *hit = calloc(cells, 1);
+    int *active = malloc(cells * sizeof(int));
+    if (!hit || !active) {
+        free(hit);
+        free(active);
+        return NULL;
+    }
+    double cell_w = 4.0 / BUDDHA_GRID_X, cell_h = 2.0 / BUDDHA_GRID_Y;
+
+    #pragma omp parallel
+    {
+        double *orbit = malloc((size_t)p->max_iter * 2 * sizeof(double));
+        #pragma omp for schedule(dynamic, 16)
+        for (size_t cell = 0; cell < cells; cell++) {
+            if (!orbit) continue;
+            int gx = (int)(cell % BUDDHA_GRID_X), gy = (int)(cell / BUDDHA_GRID_X);
+            int inside = 0, outside = 0, useful = 0;
+            for (int k = 0; k < BUDDHA_PROBE * BUDDHA_PROBE && !useful; k++) {
+                double cx = -2.0 + (gx + (k % BUDDHA_PROBE + 0.5) / BUDDHA_PROBE) * cell_w;
+                double cy = (gy + (k / BUDDHA_PROBE + 0.5) / BUDDHA_PROBE) * cell_h;
+                int escaped = 0, points = mandelbrot_interior(cx, cy) ? p->max_iter
+                                        : trace_orbit(cx, cy, p->max_iter, orbit, &escaped);
+                if (escaped) outside = 1;
+                else inside = 1;
+                useful = contributes(p, points, escaped) || (inside && outside);
+            }
+            hit[cell] = (unsigned char)useful;
+        }
+        free(orbit);
+    }
+
+    int n = 0;
+    for (int gy = 0; gy < BUDDHA_GRID_Y; gy++) {
+        for (int gx = 0; gx < BUDDHA_GRID_X; gx++) {
+            int any = 0;
+            for (int dy = -1; dy <= 1 && !any; dy++)
+                for (int dx = -1; dx <= 1 && !any; dx++) {
+                    int x = gx + dx, y = gy + dy;
+                    any = x >= 0 && y >= 0 && x < BUDDHA_GRID_X && y < BUDDHA_GRID_Y
+                          && hit[(size_t)y * BUDDHA_GRID_X + x];
+                }
+            if (any) active[n++] = gy * BUDDHA_GRID_X + gx;
+        }
+    }
+    free(hit);
+    *count = n;
+    return active;
+}
+
+int render_buddhabrot(uint64_t *density, const BuddhaParams *p, double progress_interval,
+                      BuddhaProgressFn progress, void *user, BuddhaStats *stats) {
+    double start = omp_get_wtime();
+    memset(stats, 0, sizeof(*stats));
+    if (p->width <= 0 || p->height <= 0 || p->max_iter <= 0) return 0;
+    size_t pixels = (size_t)p->width * p->height;
+    memset(density, 0, pixels * sizeof(uint64_t));
+
+    int active_count;
+    int *active = build_importance_map(p, &active_count);
+    if (!active) return 0;
+    stats->active_fraction = (double)active_count / (BUDDHA_GRID_X * BUDDHA_GRID_Y);
+    stats->map_time = omp_get_wtime() - start;
+    if (active_count == 0) {
+        // Nothing contributes: the image stays black
+        free(active);
+        stats->total_time = omp_get_wtime() - start;
+        if (progress) progress(density, stats, user);
+        return 1;
+    }
+
+    int threads = omp_get_max_threads();
+    int atomics = (double)threads * pixels * sizeof(uint32_t) > BUDDHA_HIST_BUDGET;
+    uint32_t **hist = atomics ? NULL : calloc((size_t)threads, sizeof(uint32_t *));
+    int ok = atomics || hist;
+    for (int t = 0; ok && !atomics && t < threads; t++) {
+        hist[t] = calloc(pixels, sizeof(uint32_t));
+        ok = hist[t] != NULL;
+    }
+    stats->atomics = atomics;
+
+    double aspect = (double)p->width / p->height;
+    double x_min = p->center_x - p->scale / 2.0;
+    double y_min = p->center_y - (p->scale / aspect) / 2.0;
+    double x_unit = p->width / p->scale, y_unit = p->height / (p->scale / aspect);
+    double cell_w = 4.0 / BUDDHA_GRID_X, cell_h = 2.0 / BUDDHA_GRID_Y;
+    uint64_t chunks = (p->samples + BUDDHA_CHUNK - 1) / BUDDHA_CHUNK;
+    uint64_t round_chunks = (uint64_t)threads * 8;
+    double last_report = omp_get_wtime();
+
+    for (uint64_t first = 0; ok && first < chunks; first += round_chunks) {
+        uint64_t last = first + round_chunks < chunks ? first + round_chunks : chunks;
+        uint64_t orbits = 0, hits = 0;
+
+        #pragma omp parallel reduction(+:orbits, hits)
+        {
+            uint32_t *h = atomics ? NULL : hist[omp_get_thread_num()];
+            double *orbit = malloc((size_t)p->max_iter * 2 * sizeof(double));
+            #pragma omp for schedule(dynamic)
+            for (uint64_t chunk = first; chunk < last; chunk++) {
+                if (!orbit) continue;
+                uint64_t rng = p->seed ^ (chunk * 0xD1B54A32D192ED03ull);
+                uint64_t begin = chunk * BUDDHA_CHUNK;
+                uint64_t end = begin + BUDDHA_CHUNK < p->samples ? begin + BUDDHA_CHUNK : p->samples;
+                for (uint64_t s = begin; s < end; s++) {
+                    int cell = active[(uint64_t)(((unsigned __int128)next_random(&rng) * active_count) >> 64)];
+                    double cx = -2.0 + (cell % BUDDHA_GRID_X + next_unit(&rng)) * cell_w;
+                    double cy = (cell / BUDDHA_GRID_X + next_unit(&rng)) * cell_h;
+                    if (!p->anti && mandelbrot_interior(cx, cy)) continue;
+                    int escaped, points = trace_orbit(cx, cy, p->max_iter, orbit, &escaped);
+                    if (!contributes(p, points, escaped)) continue;
+                    orbits++;
+                    for (int i = 0; i < points; i++) {
+                        int px = (int)floor((orbit[2 * i] - x_min) * x_unit);
+                        if (px < 0 || px >= p->width) continue;
+                        // The orbit of conj(c) is the mirror image: plot both
+                        for (int mirror = 0; mirror < 2; mirror++) {
+                            double zy = mirror ? -orbit[2 * i + 1] : orbit[2 * i + 1];
+                            int py = (int)floor((zy - y_min) * y_unit);
+                            if (py < 0 || py >= p->height) continue;
+                            size_t idx = (size_t)py * p->width + px;
+                            hits++;
+                            if (atomics) __atomic_fetch_add(&density[idx], 1, __ATOMIC_RELAXED);
+                            else if (++h[idx] == 0)  // wrapped: carry into the shared count
+                                __atomic_fetch_add(&density[idx], (uint64_t)1 << 32, __ATOMIC_RELAXED);
+                        }
+                    }
+                }
+            }
+            free(orbit);
+        }
+        stats->samples = last * BUDDHA_CHUNK < p->samples ? last * BUDDHA_CHUNK : p->samples;
+        stats->orbits += orbits;
+        stats->hits += hits;
+
+        double now = omp_get_wtime();
+        int final = last == chunks;
+        if (!final && (!progress || progress_interval <= 0 || now - last_report < progress_interval)) continue;
+        last_report = now;
+        if (!atomics) {
+            // Merge by pixel range so every thread streams through its own slice
+            #pragma omp parallel for schedule(static)
+            for (size_t i = 0; i < pixels; i++) {
+                uint64_t sum = 0;
+                for (int t = 0; t < threads; t++) {
+                    sum += hist[t][i];
+                    hist[t][i] = 0;
+                }
+                density[i] += sum;
+            }
+        }
+        stats->total_time = omp_get_wtime() - start;
+        if (progress && !progress(density, stats, user)) break;
+    }
+
+    for (int t = 0; hist && t < threads; t++) free(hist[t]);
+    free(hist);
+    free(active);
+    stats->total_time = omp_get_wtime() - start;
+    return ok;
+}
+
+static int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+void buddha_colorize(unsigned char *rgb, const uint64_t *density, size_t count, int palette) {
+    // Percentile of a strided sample of the lit pixels, so a few hot spots
+    // do not wash out the rest
+    size_t n = count < BUDDHA_TONE_SAMPLES ? count : BUDDHA_TONE_SAMPLES;
+    uint64_t *sample = n ? malloc(n * sizeof(uint64_t)) : NULL;
+    double peak = 1.0;
+    if (sample) {
+        size_t lit = 0, step = count / n;
+        for (size_t i = 0; i < n; i++)
+            if (density[i * step]) sample[lit++] = density[i * step];
+        if (lit > 0) {
+            qsort(sample, lit, sizeof(uint64_t), compare_u64);
+            peak = (double)sample[(size_t)((lit - 1) * BUDDHA_TONE_PERCENTILE)];
+        }
+        free(sample);
+    }
+
+    const uint32_t *lut = palette_lut(palette_resolve(palette, 1), 256);
+    if (!lut) return;
+    double inv_peak = 1.0 / peak;
+    #pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < count; i++) {
+        double t = sqrt(density[i] * inv_peak);
+        uint32_t c = lut[t >= 1.0 ? 255 : (int)(t * 256.0)];
+        rgb[i * 3] = c & 0xFF;
+        rgb[i * 3 + 1] = (c >> 8) & 0xFF;
+        rgb[i * 3 + 2] = (c >> 16) & 0xFF;
+    }
+    palette_lut_release(lut);
+}
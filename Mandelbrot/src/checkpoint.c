@@ -0,0 +1,224 @@
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "checkpoint.h"
+#include "metrics.h"
+
+#define CHECKPOINT_MAGIC "MBCKPT2"
+#define CHECKPOINT_ALIGN 4096
+
+enum { TILE_PENDING = 0, TILE_DONE = 1, TILE_SAVED = 2 };
+
+typedef struct {
+    char magic[8];
+    int32_t width, height, tile;
+    int32_t tiles_x, tiles_y;
+    FractalView view;
+    uint64_t data_offset;
+} CheckpointHeader;
+
+typedef struct {
+    int fd;
+    unsigned char *image;
+    int width, height, tile, tiles_x, tiles_y;
+    uint64_t data_offset;
+    unsigned char *state;  // per-tile TILE_* shared with the render threads
+    unsigned char *saved;  // on-disk bitmap, owned by the flushing thread
+} Checkpoint;
+
+static int write_full(int fd, const void *buf, size_t len, off_t off) {
+    const unsigned char *p = buf;
+    while (len > 0) {
+        ssize_t n = pwrite(fd, p, len, off);
+        if (n <= 0) return 0;
+        p += n; len -= (size_t)n; off += n;
+    }
+    return 1;
+}
+
+static int read_full(int fd, void *buf, size_t len, off_t off) {
+    unsigned char *p = buf;
+    while (len > 0) {
+        ssize_t n = pread(fd, p, len, off);
+        if (n <= 0) return 0;
+        p += n; len -= (size_t)n; off += n;
+    }
+    return 1;
+}
+
+static void tile_rect(const Checkpoint *ck, int t, int *x0, int *y0, int *tw, int *th) {
+    *x0 = (t % ck->tiles_x) * ck->tile;
+    *y0 = (t / ck->tiles_x) * ck->tile;
+    *tw = ck->width - *x0 < ck->tile ? ck->width - *x0 : ck->tile;
+    *th = ck->height - *y0 < ck->tile ? ck->height - *y0 : ck->tile;
+}
+
+// Tile rows are stored at their place in a full-frame RGB layout after the header
+static int tile_io(const Checkpoint *ck, int t, int writing) {
+    int x0, y0, tw, th;
+    tile_rect(ck, t, &x0, &y0, &tw, &th);
+    for (int y = y0; y < y0 + th; y++) {
+        size_t pos = ((size_t)y * ck->width + x0) * 3;
+        off_t off = (off_t)(ck->data_offset + pos);
+        int ok = writing ? write_full(ck->fd, ck->image + pos, (size_t)tw * 3, off)
+                         : read_full(ck->fd, ck->image + pos, (size_t)tw * 3, off);
+        if (!ok) return 0;
+    }
+    return 1;
+}
+
+// Persists every finished tile: data first, then the bitmap, so a crash
+// in between never marks a tile saved before its pixels are on disk.
+static int checkpoint_flush(Checkpoint *ck) {
+    int tiles = ck->tiles_x * ck->tiles_y;
+    int flushed = 0;
+    for (int t = 0; t < tiles; t++) {
+        // Acquire pairs with the render thread's release store, so the
+        // tile's pixels are visible before they are written out
+        if (__atomic_load_n(&ck->state[t], __ATOMIC_ACQUIRE) != TILE_DONE) continue;
+        if (!tile_io(ck, t, 1)) return 0;
+        ck->saved[t] = 1;
+        flushed++;
+    }
+    if (flushed == 0) return 1;
+    if (fdatasync(ck->fd) != 0) return 0;
+    if (!write_full(ck->fd, ck->saved, (size_t)tiles, sizeof(CheckpointHeader))) return 0;
+    if (fdatasync(ck->fd) != 0) return 0;
+    for (int t = 0; t < tiles; t++) {
+        if (ck->saved[t] && __atomic_load_n(&ck->state[t], __ATOMIC_RELAXED) == TILE_DONE)
+            __atomic_store_n(&ck->state[t], TILE_SAVED, __ATOMIC_RELAXED);
+    }
+    return 1;
+}
+
+static int same_view(const FractalView *a, const FractalView *b) {
+    return a->max_iter == b->max_iter && a->center_x == b->center_x
+        && a->center_y == b->center_y && a->scale == b->scale && a->julia == b->julia
+        && a->c_real == b->c_real && a->c_imag == b->c_imag && a->palette == b->palette;
+}
+
+// The header drives allocation and rendering on --resume, so a damaged or
+// crafted file must not get past here with sizes that overflow
+static int header_valid(const CheckpointHeader *hdr) {
+    if (memcmp(hdr->magic, CHECKPOINT_MAGIC, sizeof(hdr->magic)) != 0) return 0;
+    if (hdr->width <= 0 || hdr->height <= 0 || hdr->tile != CHECKPOINT_TILE) return 0;
+    if (hdr->width > INT_MAX - CHECKPOINT_TILE || hdr->height > INT_MAX - CHECKPOINT_TILE) return 0;
+    if ((uint64_t)hdr->width * (uint64_t)hdr->height > SIZE_MAX / 3) return 0;
+    if (hdr->tiles_x != (hdr->width + CHECKPOINT_TILE - 1) / CHECKPOINT_TILE
+        || hdr->tiles_y != (hdr->height + CHECKPOINT_TILE - 1) / CHECKPOINT_TILE
+        || (int64_t)hdr->tiles_x * hdr->tiles_y > INT_MAX) return 0;
+    const FractalView *v = &hdr->view;
+    return v->max_iter > 0 && v->max_iter < INT_MAX && isfinite(v->center_x) && isfinite(v->center_y)
+        && isfinite(v->scale) && v->scale > 0.0 && isfinite(v->c_real) && isfinite(v->c_imag);
+}
+
+static int read_header(int fd, CheckpointHeader *hdr) {
+    return read_full(fd, hdr, sizeof(*hdr), 0) && header_valid(hdr);
+}
+
+int checkpoint_read_params(const char *path, int *width, int *height, FractalView *view) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return 0;
+    CheckpointHeader hdr;
+    int ok = read_header(fd, &hdr);
+    close(fd);
+    if (!ok) return 0;
+    *width = hdr.width;
+    *height = hdr.height;
+    *view = hdr.view;
+    return 1;
+}
+
+int generate_parallel_checkpointed(unsigned char *image, int width, int height,
+                                   const FractalView *view, const char *path,
+                                   double interval, int resume)
+{
+    Checkpoint ck;
+    ck.image = image;
+    ck.width = width;
+    ck.height = height;
+    ck.tile = CHECKPOINT_TILE;
+    ck.tiles_x = (width + ck.tile - 1) / ck.tile;
+    ck.tiles_y = (height + ck.tile - 1) / ck.tile;
+    int tiles = ck.tiles_x * ck.tiles_y;
+    ck.data_offset = (sizeof(CheckpointHeader) + (uint64_t)tiles + CHECKPOINT_ALIGN - 1)
+                     / CHECKPOINT_ALIGN * CHECKPOINT_ALIGN;
+    size_t image_size = (size_t)width * height * 3;
+
+    ck.fd = open(path, resume ? O_RDWR : O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (ck.fd < 0) return 0;
+    ck.state = calloc((size_t)tiles, 1);
+    ck.saved = calloc((size_t)tiles, 1);
+    int ok = ck.state && ck.saved;
+
+    if (ok && resume) {
+        CheckpointHeader hdr;
+        ok = read_header(ck.fd, &hdr) && hdr.width == width && hdr.height == height
+             && hdr.tile == ck.tile && same_view(&hdr.view, view)
+             && read_full(ck.fd, ck.saved, (size_t)tiles, sizeof(hdr));
+        for (int t = 0; ok && t < tiles; t++) {
+            if (!ck.saved[t]) continue;
+            ok = tile_io(&ck, t, 0);
+            ck.state[t] = TILE_SAVED;
+        }
+    } else if (ok) {
+        CheckpointHeader hdr;
+        memset(&hdr, 0, sizeof(hdr));
+        memcpy(hdr.magic, CHECKPOINT_MAGIC, sizeof(hdr.magic));
+        hdr.width = width;
+        hdr.height = height;
+        hdr.tile = ck.tile;
+        hdr.tiles_x = ck.tiles_x;
+        hdr.tiles_y = ck.tiles_y;
+        hdr.view = *view;
+        hdr.data_offset = ck.data_offset;
+        // Sparse file: only flushed tiles ever occupy disk blocks
+        ok = ftruncate(ck.fd, (off_t)(ck.data_offset + image_size)) == 0
+             && write_full(ck.fd, &hdr, sizeof(hdr), 0)
+             && write_full(ck.fd, ck.saved, (size_t)tiles, sizeof(hdr));
+    }
+
+    if (ok) {
+        double last_flush = omp_get_wtime();
+        int failed = 0;
+
+        #pragma omp parallel for schedule(dynamic)
+        for (int t = 0; t < tiles; t++) {
+            if (ck.state[t] == TILE_SAVED) continue;
+            int x0, y0, tw, th;
+            tile_rect(&ck, t, &x0, &y0, &tw, &th);
+            double start = omp_get_wtime();
+            render_tile(image + ((size_t)y0 * width + x0) * 3, (size_t)width * 3,
+                        width, height, view, x0, y0, tw, th);
+            metrics_tile(omp_get_wtime() - start);
+            // Release: the flusher that sees TILE_DONE also sees the pixels
+            __atomic_store_n(&ck.state[t], TILE_DONE, __ATOMIC_RELEASE);
+
+            double last;
+            #pragma omp atomic read
+            last = last_flush;
+            if (omp_get_wtime() - last >= interval) {
+                #pragma omp critical(checkpoint_flush)
+                {
+                    if (omp_get_wtime() - last_flush >= interval) {
+                        if (!checkpoint_flush(&ck)) failed = 1;
+                        #pragma omp atomic write
+                        last_flush = omp_get_wtime();
+                    }
+                }
+            }
+        }
+        ok = !failed && checkpoint_flush(&ck);
+    }
+
+    free(ck.state);
+    free(ck.saved);
+    close(ck.fd);
+    return ok;
+}
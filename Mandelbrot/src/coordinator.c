@@ -0,0 +1,74 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "distributed.h"
+#include "palette.h"
+#include "image_io.h"
+
+// Distributed render driver: tiles of one frame are rendered by worker
+// processes on this or other machines (`worker HOST PORT`) and assembled here
+int main(int argc, char **argv) {
+    if (argc < 4) {
+        fprintf(stderr, "Usage: %s WIDTH HEIGHT OUTPUT [--center X Y] [--scale S] [--iter N] [--palette NAME]\n"
+                        "       [--format png|qoi|ppm|pam|bmp|tga|jpg] [--level 0-9] [--bind ADDR] [--port N]\n"
+                        "       [--spawn N] [--worker-threads N] [--timeout SECONDS]\n", argv[0]);
+        return 1;
+    }
+    int width = atoi(argv[1]), height = atoi(argv[2]);
+    const char *path = argv[3];
+    FractalView view = { 1000, -0.5, 0.0, 4.0, 0, 0.0, 0.0, PALETTE_DEFAULT };
+    DistOptions opt;
+    memset(&opt, 0, sizeof(opt));
+    opt.format = IMAGE_PNG;
+    opt.level = -1;
+
+    for (int i = 4; i < argc; i++) {
+        if (strcmp(argv[i], "--center") == 0 && i + 2 < argc) {
+            view.center_x = atof(argv[++i]);
+            view.center_y = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--scale") == 0 && i + 1 < argc) {
+            view.scale = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--iter") == 0 && i + 1 < argc) {
+            view.max_iter = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--palette") == 0 && i + 1 < argc && palette_from_name(argv[i + 1]) >= 0) {
+            view.palette = palette_from_name(argv[++i]);
+        } else if (strcmp(argv[i], "--format") == 0 && i + 1 < argc && image_format_from_name(argv[i + 1]) >= 0) {
+            opt.format = image_format_from_name(argv[++i]);
+        } else if (strcmp(argv[i], "--level") == 0 && i + 1 < argc) {
+            opt.level = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--bind") == 0 && i + 1 < argc) {
+            opt.bind = argv[++i];
+        } else if (strcmp(argv[i], "--port") == 0 && i + 1 < argc) {
+            opt.port = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--spawn") == 0 && i + 1 < argc) {
+            opt.spawn = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--worker-threads") == 0 && i + 1 < argc) {
+            opt.worker_threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--timeout") == 0 && i + 1 < argc) {
+            opt.timeout = atof(argv[++i]);
+        } else {
+            fprintf(stderr, "Unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (width <= 0 || height <= 0 || view.max_iter <= 0) {
+        fprintf(stderr, "Invalid frame size or iteration limit\n");
+        return 1;
+    }
+
+    DistStats stats;
+    int ok = render_distributed(path, width, height, &view, &opt, &stats);
+    printf("%s %dx%d: %ld tiles, %ld reassigned, %.3f seconds (%.1f Mpixel/s)\n",
+           ok ? "Rendered" : "Failed", width, height, stats.tiles, stats.reassigned,
+           stats.total_time, (double)width * height / stats.total_time / 1e6);
+    printf("%-24s %7s %7s %10s %12s %12s\n", "worker", "threads", "tiles", "busy (s)", "Mpixel/s", "busy Mpx/s");
+    for (int i = 0; i < stats.worker_count; i++) {
+        const DistWorkerStats *w = &stats.workers[i];
+        printf("%-24s %7d %7ld %10.3f %12.2f %12.2f%s\n", w->name, w->threads, w->tiles, w->busy,
+               w->connected > 0 ? w->pixels / w->connected / 1e6 : 0.0,
+               w->busy > 0 ? w->pixels / w->busy / 1e6 : 0.0, w->lost ? "  (lost)" : "");
+    }
+    if (ok) printf("Saved to %s\n", path);
+    free(stats.workers);
+    return ok ? 0 : 1;
+}
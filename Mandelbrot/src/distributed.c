@@ -0,0 +1,461 @@
+#define _GNU_SOURCE
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include "distributed.h"
+#include "png_stream.h"
+#include "image_io.h"
+#include "metrics.h"
+
+#define DIST_CONNECT_TRIES 50   // 100 ms apart, the coordinator may still be starting
+
+static int send_all(int fd, const void *buf, size_t len, int more) {
+    const char *p = buf;
+    while (len > 0) {
+        ssize_t n = send(fd, p, len, MSG_NOSIGNAL | (more ? MSG_MORE : 0));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return 0;
+        p += n;
+        len -= (size_t)n;
+    }
+    return 1;
+}
+
+static int recv_all(int fd, void *buf, size_t len) {
+    char *p = buf;
+    while (len > 0) {
+        ssize_t n = recv(fd, p, len, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return 0;
+        p += n;
+        len -= (size_t)n;
+    }
+    return 1;
+}
+
+static int send_msg(int fd, uint32_t type, const void *msg, size_t len, const void *payload, size_t payload_len) {
+    DistHeader h = { type, (uint32_t)(len + payload_len) };
+    return send_all(fd, &h, sizeof(h), len + payload_len > 0)
+        && (len == 0 || send_all(fd, msg, len, payload_len > 0))
+        && (payload_len == 0 || send_all(fd, payload, payload_len, 0));
+}
+
+static void set_socket_options(int fd, double timeout) {
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (timeout > 0) {
+        struct timeval tv = { (time_t)timeout, (suseconds_t)((timeout - (time_t)timeout) * 1e6) };
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    }
+}
+
+// Worker
+
+static int connect_to(const char *host, int port) {
+    char service[16];
+    snprintf(service, sizeof(service), "%d", port);
+    struct addrinfo hints = { .ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM }, *res;
+    if (getaddrinfo(host, service, &hints, &res) != 0) return -1;
+    int fd = -1;
+    for (int attempt = 0; fd < 0 && attempt < DIST_CONNECT_TRIES; attempt++) {
+        for (struct addrinfo *a = res; a && fd < 0; a = a->ai_next) {
+            fd = socket(a->ai_family, a->ai_socktype | SOCK_CLOEXEC, a->ai_protocol);
+            if (fd >= 0 && connect(fd, a->ai_addr, a->ai_addrlen) != 0) {
+                close(fd);
+                fd = -1;
+            }
+        }
+        if (fd < 0) usleep(100000);
+    }
+    freeaddrinfo(res);
+    return fd;
+}
+
+int dist_worker_run(const char *host, int port, int threads, long fail_after) {
+    if (threads > 0) omp_set_num_threads(threads);
+    int fd = connect_to(host, port);
+    if (fd < 0) return 0;
+    set_socket_options(fd, 0);
+
+    DistHello hello;
+    memset(&hello, 0, sizeof(hello));
+    char host_name[32] = "localhost";
+    gethostname(host_name, sizeof(host_name) - 1);
+    hello.threads = threads > 0 ? threads : omp_get_max_threads();
+    snprintf(hello.name, sizeof(hello.name), "%s:%d", host_name, (int)getpid());
+
+    unsigned char *pixels = NULL;
+    size_t capacity = 0;
+    long done = 0;
+    int ok = 0;
+    if (!send_msg(fd, DIST_HELLO, &hello, sizeof(hello), NULL, 0)) {
+        close(fd);
+        return 0;
+    }
+
+    for (;;) {
+        DistHeader h;
+        DistTileRequest req;
+        if (!recv_all(fd, &h, sizeof(h))) break;
+        if (h.type == DIST_BYE) {
+            ok = 1;
+            break;
+        }
+        if (h.type != DIST_RENDER || h.length != sizeof(req) || !recv_all(fd, &req, sizeof(req))) break;
+        if (fail_after >= 0 && done >= fail_after) break;
+        if (req.tile_w <= 0 || req.tile_h <= 0 || req.tile_w > DIST_TILE || req.tile_h > DIST_TILE) break;
+
+        size_t stride = (size_t)req.tile_w * 3, bytes = stride * req.tile_h;
+        if (bytes > capacity) {
+            unsigned char *grown = realloc(pixels, bytes);
+            if (!grown) break;
+            pixels = grown;
+            capacity = bytes;
+        }
+        // One row per task: escape times vary too much across a tile for static bands
+        double start = omp_get_wtime();
+        #pragma omp parallel for schedule(dynamic, 1)
+        for (int y = 0; y < req.tile_h; y++)
+            render_tile(pixels + (size_t)y * stride, stride, req.width, req.height, &req.view,
+                        req.x0, req.y0 + y, req.tile_w, 1);
+        DistTileResult res = { req.id, req.tile_w, req.tile_h, omp_get_wtime() - start };
+        metrics_tile(res.seconds);
+        if (!send_msg(fd, DIST_RESULT, &res, sizeof(res), pixels, bytes)) break;
+        done++;
+    }
+    free(pixels);
+    close(fd);
+    return ok;
+}
+
+// Coordinator
+
+typedef struct {
+    int fd;                      // -1 once dropped
+    int ready;                   // hello received
+    int inflight[DIST_PIPELINE];
+    int inflight_count;
+    double deadline;             // drop if the oldest tile is not back by then
+    double joined;
+    DistWorkerStats stats;
+} Worker;
+
+typedef struct {
+    int width, height, tiles_x, tiles_y;
+    const FractalView *view;
+    double timeout;
+    Worker *workers;
+    int worker_count, worker_cap;
+    int *retry;                  // tiles taken back from lost workers, served first
+    int retry_count;             // capacity is DIST_PIPELINE per worker slot
+    int next_tile;               // next never-dispatched tile, row-major
+    unsigned char **bands;       // one tile row of pixels per tile row, allocated on demand
+    int *remaining;              // tiles still missing per tile row
+    int flushed;                 // tile rows written so far
+    unsigned char *image;        // whole frame for non-PNG formats
+    PngStream *png;
+    unsigned char *scratch;      // one received tile
+    long reassigned;
+} Coordinator;
+
+static int tile_rows(const Coordinator *co, int ty) {
+    int rows = co->height - ty * DIST_TILE;
+    return rows < DIST_TILE ? rows : DIST_TILE;
+}
+
+static int active_workers(const Coordinator *co) {
+    int n = 0;
+    for (int i = 0; i < co->worker_count; i++)
+        if (co->workers[i].fd >= 0 && co->workers[i].ready) n++;
+    return n;
+}
+
+static void drop_worker(Coordinator *co, Worker *w, double now) {
+    close(w->fd);
+    w->fd = -1;
+    w->stats.connected = now - w->joined;
+    if (w->inflight_count > 0) {
+        w->stats.lost = 1;
+        for (int i = 0; i < w->inflight_count; i++) co->retry[co->retry_count++] = w->inflight[i];
+        co->reassigned += w->inflight_count;
+        fprintf(stderr, "Worker %s lost, reassigning %d tiles\n", w->stats.name, w->inflight_count);
+    }
+    w->inflight_count = 0;
+}
+
+// Next tile to hand out, or -1. Fresh tiles are held back once they are too
+// far ahead of the writer, which bounds the buffered rows.
+static int take_tile(Coordinator *co) {
+    if (co->retry_count > 0) return co->retry[--co->retry_count];
+    if (co->next_tile >= co->tiles_x * co->tiles_y) return -1;
+    int window = co->image ? co->tiles_y
+               : DIST_WINDOW_ROWS + active_workers(co) * DIST_PIPELINE / co->tiles_x;
+    if (co->next_tile / co->tiles_x >= co->flushed + window) return -1;
+    return co->next_tile++;
+}
+
+static void dispatch(Coordinator *co, double now) {
+    for (int i = 0; i < co->worker_count; i++) {
+        Worker *w = &co->workers[i];
+        while (w->fd >= 0 && w->ready && w->inflight_count < DIST_PIPELINE) {
+            int id = take_tile(co);
+            if (id < 0) return;
+            int tx = id % co->tiles_x, ty = id / co->tiles_x;
+            DistTileRequest req = { id, co->width, co->height, tx * DIST_TILE, ty * DIST_TILE,
+                                    0, tile_rows(co, ty), *co->view };
+            req.tile_w = co->width - req.x0 < DIST_TILE ? co->width - req.x0 : DIST_TILE;
+            if (w->inflight_count == 0) w->deadline = now + co->timeout;
+            w->inflight[w->inflight_count++] = id;
+            if (!send_msg(w->fd, DIST_RENDER, &req, sizeof(req), NULL, 0)) drop_worker(co, w, now);
+        }
+    }
+}
+
+// Writes every completed tile row at the front of the window
+static int flush_rows(Coordinator *co) {
+    while (co->flushed < co->tiles_y && co->remaining[co->flushed] == 0) {
+        int ty = co->flushed;
+        if (co->png && !png_stream_write_rows(co->png, co->bands[ty], (uint32_t)tile_rows(co, ty))) return 0;
+        if (!co->image) free(co->bands[ty]);
+        co->bands[ty] = NULL;
+        co->flushed++;
+    }
+    return 1;
+}
+
+// Reads one message from a readable worker; 0 drops the worker, -1 is a fatal error
+static int receive(Coordinator *co, Worker *w, double now) {
+    DistHeader h;
+    if (!recv_all(w->fd, &h, sizeof(h))) return 0;
+
+    if (h.type == DIST_HELLO && !w->ready) {
+        DistHello hello;
+        if (h.length != sizeof(hello) || !recv_all(w->fd, &hello, sizeof(hello))) return 0;
+        hello.name[DIST_NAME - 1] = '\0';
+        memcpy(w->stats.name, hello.name, DIST_NAME);
+        w->stats.threads = hello.threads;
+        w->ready = 1;
+        w->joined = now;
+        fprintf(stderr, "Worker %s joined with %d threads\n", w->stats.name, w->stats.threads);
+        return 1;
+    }
+
+    DistTileResult res;
+    if (h.type != DIST_RESULT || h.length < sizeof(res) || !recv_all(w->fd, &res, sizeof(res))) return 0;
+    int slot = -1;
+    for (int i = 0; i < w->inflight_count; i++)
+        if (w->inflight[i] == res.id) slot = i;
+    if (slot < 0) return 0;
+    int tx = res.id % co->tiles_x, ty = res.id / co->tiles_x;
+    int x0 = tx * DIST_TILE, rows = tile_rows(co, ty);
+    int tile_w = co->width - x0 < DIST_TILE ? co->width - x0 : DIST_TILE;
+    size_t stride = (size_t)tile_w * 3;
+    if (res.tile_w != tile_w || res.tile_h != rows || h.length != sizeof(res) + stride * rows
+        || !recv_all(w->fd, co->scratch, stride * rows))
+        return 0;
+
+    if (!co->bands[ty]) {
+        co->bands[ty] = malloc((size_t)co->width * 3 * DIST_TILE);
+        if (!co->bands[ty]) return -1;
+    }
+    for (int y = 0; y < rows; y++)
+        memcpy(co->bands[ty] + ((size_t)y * co->width + x0) * 3, co->scratch + (size_t)y * stride, stride);
+    co->remaining[ty]--;
+
+    w->inflight[slot] = w->inflight[--w->inflight_count];
+    w->deadline = now + co->timeout;
+    w->stats.tiles++;
+    w->stats.pixels += (double)tile_w * rows;
+    w->stats.busy += res.seconds;
+    return flush_rows(co) ? 1 : -1;
+}
+
+static int open_listener(const DistOptions *opt, int *port) {
+    char service[16];
+    snprintf(service, sizeof(service), "%d", opt->port);
+    struct addrinfo hints = { .ai_flags = AI_PASSIVE, .ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM }, *res;
+    if (getaddrinfo(opt->bind ? opt->bind : "127.0.0.1", service, &hints, &res) != 0) return -1;
+    int fd = socket(res->ai_family, res->ai_socktype | SOCK_CLOEXEC, res->ai_protocol);
+    int one = 1;
+    if (fd >= 0) setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (fd >= 0 && (bind(fd, res->ai_addr, res->ai_addrlen) != 0 || listen(fd, 64) != 0)) {
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(res);
+    struct sockaddr_storage addr;
+    socklen_t len = sizeof(addr);
+    if (fd >= 0 && getsockname(fd, (struct sockaddr *)&addr, &len) == 0)
+        *port = ntohs(addr.ss_family == AF_INET6 ? ((struct sockaddr_in6 *)&addr)->sin6_port
+                                                 : ((struct sockaddr_in *)&addr)->sin_port);
+    return fd;
+}
+
+int render_distributed(const char *path, int width, int height, const FractalView *view,
+                       const DistOptions *opt, DistStats *stats) {
+    double start = omp_get_wtime();
+    memset(stats, 0, sizeof(*stats));
+    if (width <= 0 || height <= 0) return 0;
+
+    Coordinator co;
+    memset(&co, 0, sizeof(co));
+    co.width = width;
+    co.height = height;
+    co.view = view;
+    co.timeout = opt->timeout > 0 ? opt->timeout : DIST_TIMEOUT;
+    co.tiles_x = (width + DIST_TILE - 1) / DIST_TILE;
+    co.tiles_y = (height + DIST_TILE - 1) / DIST_TILE;
+    co.bands = calloc((size_t)co.tiles_y, sizeof(unsigned char *));
+    co.remaining = malloc((size_t)co.tiles_y * sizeof(int));
+    co.scratch = malloc((size_t)DIST_TILE * DIST_TILE * 3);
+    int ok = co.bands && co.remaining && co.scratch;
+    for (int ty = 0; ok && ty < co.tiles_y; ty++) co.remaining[ty] = co.tiles_x;
+
+    if (ok && opt->format == IMAGE_PNG) {
+        co.png = png_stream_open(path, (uint32_t)width, (uint32_t)height, PNG_RGB, 8, opt->level);
+        ok = co.png != NULL;
+    } else if (ok) {
+        co.image = malloc((size_t)width * height * 3);
+        ok = co.image != NULL;
+        for (int ty = 0; ok && ty < co.tiles_y; ty++) co.bands[ty] = co.image + (size_t)ty * DIST_TILE * width * 3;
+    }
+
+    int port = 0;
+    int listen_fd = ok ? open_listener(opt, &port) : -1;
+    if (ok && listen_fd < 0) {
+        fprintf(stderr, "Cannot listen on %s:%d\n", opt->bind ? opt->bind : "127.0.0.1", opt->port);
+        ok = 0;
+    }
+    if (ok) fprintf(stderr, "Coordinator listening on port %d, %d tiles\n", port, co.tiles_x * co.tiles_y);
+
+    // Local workers are forked before this process starts any threads
+    int spawn = ok && opt->spawn > 0 ? opt->spawn : 0;
+    pid_t *children = spawn ? calloc((size_t)spawn, sizeof(pid_t)) : NULL;
+    if (spawn) {
+        int threads = opt->worker_threads > 0 ? opt->worker_threads : omp_get_num_procs() / spawn;
+        const char *host = opt->bind && strcmp(opt->bind, "0.0.0.0") != 0 && strcmp(opt->bind, "::") != 0
+                         ? opt->bind : "127.0.0.1";
+        fflush(NULL);
+        for (int i = 0; children && i < spawn; i++) {
+            children[i] = fork();
+            if (children[i] == 0) {
+                close(listen_fd);
+                _exit(dist_worker_run(host, port, threads > 0 ? threads : 1, -1) ? 0 : 1);
+            }
+        }
+    }
+
+    double idle_since = omp_get_wtime();
+    struct pollfd *fds = NULL;
+    while (ok && co.flushed < co.tiles_y) {
+        double now = omp_get_wtime();
+        dispatch(&co, now);
+
+        int nfds = 1 + co.worker_count;
+        struct pollfd *grown = realloc(fds, (size_t)nfds * sizeof(struct pollfd));
+        if (!grown) {
+            ok = 0;
+            break;
+        }
+        fds = grown;
+        fds[0] = (struct pollfd){ .fd = listen_fd, .events = POLLIN };
+        for (int i = 0; i < co.worker_count; i++)
+            fds[1 + i] = (struct pollfd){ .fd = co.workers[i].fd, .events = POLLIN };
+        if (poll(fds, (nfds_t)nfds, 200) < 0 && errno != EINTR) {
+            ok = 0;
+            break;
+        }
+        now = omp_get_wtime();
+
+        for (int i = 0; ok && i < co.worker_count; i++) {
+            Worker *w = &co.workers[i];
+            if (w->fd < 0) continue;
+            if (fds[1 + i].revents & (POLLIN | POLLHUP | POLLERR)) {
+                int r = receive(&co, w, now);
+                if (r < 0) ok = 0;
+                else if (r == 0) drop_worker(&co, w, now);
+            } else if (w->inflight_count > 0 && now > w->deadline) {
+                fprintf(stderr, "Worker %s timed out\n", w->stats.name);
+                drop_worker(&co, w, now);
+            }
+        }
+
+        if (fds[0].revents & POLLIN) {
+            int fd = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC);
+            if (fd >= 0 && co.worker_count == co.worker_cap) {
+                int cap = co.worker_cap ? co.worker_cap * 2 : 16;
+                Worker *more = realloc(co.workers, (size_t)cap * sizeof(Worker));
+                if (more) co.workers = more;
+                int *retry = more ? realloc(co.retry, (size_t)cap * DIST_PIPELINE * sizeof(int)) : NULL;
+                if (retry) {
+                    co.retry = retry;
+                    co.worker_cap = cap;
+                }
+            }
+            if (fd >= 0 && co.worker_count < co.worker_cap) {
+                set_socket_options(fd, co.timeout);
+                Worker *w = &co.workers[co.worker_count++];
+                memset(w, 0, sizeof(*w));
+                w->fd = fd;
+                w->joined = now;
+            } else if (fd >= 0) {
+                close(fd);
+            }
+        }
+
+        if (active_workers(&co) > 0) {
+            idle_since = now;
+        } else if (now - idle_since > co.timeout) {
+            fprintf(stderr, "No workers for %.0f seconds, giving up\n", co.timeout);
+            ok = 0;
+        }
+    }
+    free(fds);
+
+    double end = omp_get_wtime();
+    for (int i = 0; i < co.worker_count; i++) {
+        Worker *w = &co.workers[i];
+        if (w->fd < 0) continue;
+        send_msg(w->fd, DIST_BYE, NULL, 0, NULL, 0);
+        close(w->fd);
+        w->stats.connected = end - w->joined;
+    }
+    if (listen_fd >= 0) close(listen_fd);
+    for (int i = 0; children && i < spawn; i++) {
+        if (children[i] <= 0) continue;
+        if (!ok) kill(children[i], SIGTERM);
+        waitpid(children[i], NULL, 0);
+    }
+    free(children);
+
+    if (co.png) ok = png_stream_close(co.png) && ok;
+    else if (ok) ok = save_image(path, co.image, width, height, opt->format, opt->level);
+    if (!co.image)
+        for (int ty = 0; co.bands && ty < co.tiles_y; ty++) free(co.bands[ty]);
+
+    stats->tiles = (long)co.tiles_x * co.tiles_y;
+    stats->reassigned = co.reassigned;
+    stats->total_time = omp_get_wtime() - start;
+    stats->workers = co.worker_count ? malloc((size_t)co.worker_count * sizeof(DistWorkerStats)) : NULL;
+    for (int i = 0; stats->workers && i < co.worker_count; i++)
+        if (co.workers[i].ready) stats->workers[stats->worker_count++] = co.workers[i].stats;
+
+    free(co.workers);
+    free(co.retry);
+    free(co.bands);
+    free(co.remaining);
+    free(co.image);
+    free(co.scratch);
+    return ok;
+}
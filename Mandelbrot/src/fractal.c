@@ -3,23 +3,67 @@
 #include <CL/cl.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <math.h>
 #include "fractal.h"
+#include "palette.h"
+#include "png_stream.h"
+#include "metrics.h"
+#include "trace.h"
 
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "stb_image_write.h"
 
-static inline void iter_to_rgb(int iter, int max_iter, unsigned char *r, unsigned char *g, unsigned char *b) {
-    if (iter >= max_iter) {
-        *r = *g = *b = 0;
-        return;
+// One metrics update per row or tile keeps the counters off the pixel loop
+static inline void count_pixels(uint64_t pixels, uint64_t iterations, uint64_t escaped) {
+    metrics_add(METRIC_PIXELS, pixels);
+    metrics_add(METRIC_ITERATIONS, iterations);
+    metrics_add(METRIC_ESCAPED, escaped);
+}
+
+static inline int mandelbrot_pixel(double cX, double cY, int max_iter) {
+    double zx = 0.0, zy = 0.0;
+    int iter;
+    for (iter = 0; iter < max_iter; iter++) {
+        double tmp = zx * zx - zy * zy + cX;
+        zy = 2.0 * zx * zy + cY;
+        zx = tmp;
+        if ((zx * zx + zy * zy) > 4.0) break;
     }
-    double t = (double)iter / (double)max_iter;
-    int ir = (int)(9*(1-t)*t*t*t*255);
-    int ig = (int)(15*(1-t)*(1-t)*t*t*255);
-    int ib = (int)(8.5*(1-t)*(1-t)*(1-t)*t*255);
-    *r = (unsigned char)(ir & 0xFF);
-    *g = (unsigned char)(ig & 0xFF);
-    *b = (unsigned char)(ib & 0xFF);
+    return iter;
+}
+
+int mandelbrot_interior(double cx, double cy) {
+    double y2 = cy * cy;
+    double q = (cx - 0.25) * (cx - 0.25) + y2;
+    if (q * (q + (cx - 0.25)) <= 0.25 * y2) return 1;
+    return (cx + 1.0) * (cx + 1.0) + y2 <= 0.0625;
+}
+
+int mandelbrot_escape(double cx, double cy, int max_iter, int *proven) {
+    *proven = 1;
+    if (mandelbrot_interior(cx, cy)) return max_iter;
+    double zx = 0.0, zy = 0.0, ref_x = 0.0, ref_y = 0.0;
+    int next_ref = 2;
+    for (int iter = 0; iter < max_iter; iter++) {
+        double tmp = zx * zx - zy * zy + cx;
+        zy = 2.0 * zx * zy + cy;
+        zx = tmp;
+        if ((zx * zx + zy * zy) > 4.0) {
+            *proven = 0;
+            return iter;
+        }
+        // Came back to the point saved at the last power of two: the orbit
+        // has settled on a cycle of length at most that power
+        double dx = zx - ref_x, dy = zy - ref_y;
+        if (dx * dx + dy * dy < 1e-26) return max_iter;
+        if (iter == next_ref) {
+            ref_x = zx;
+            ref_y = zy;
+            next_ref *= 2;
+        }
+    }
+    *proven = 0;
+    return max_iter;
 }
 
 void generate_serial(unsigned char *image, int width, int height,
@@ -29,27 +73,27 @@ void generate_serial(unsigned char *image, int width, int height,
     double x_max = center_x + scale / 2;
     double y_min = center_y - (scale / aspect_ratio) / 2;
     double y_max = center_y + (scale / aspect_ratio) / 2;
+    const uint32_t *lut = palette_lut(PALETTE_CLASSIC, max_iter);
+    if (!lut) return;
 
     for (int y = 0; y < height; y++) {
+        uint64_t span = trace_begin(), iterations = 0, escaped = 0;
         for (int x = 0; x < width; x++) {
-            double zx = 0.0, zy = 0.0;
             double cX = x_min + (x / (double)width) * (x_max - x_min);
             double cY = y_min + (y / (double)height) * (y_max - y_min);
-            int iter;
-            for (iter = 0; iter < max_iter; iter++) {
-                double tmp = zx * zx - zy * zy + cX;
-                zy = 2.0 * zx * zy + cY;
-                zx = tmp;
-                if ((zx * zx + zy * zy) > 4.0) break;
-            }
-            unsigned char r, g, b;
-            iter_to_rgb(iter, max_iter, &r, &g, &b);
-            int idx = (y * width + x) * 3;
-            image[idx] = r;
-            image[idx+1] = g;
-            image[idx+2] = b;
+            int iter = mandelbrot_pixel(cX, cY, max_iter);
+            iterations += iter;
+            escaped += iter < max_iter;
+            uint32_t c = lut[iter];
+            size_t idx = ((size_t)y * width + x) * 3;
+            image[idx] = c & 0xFF;
+            image[idx+1] = (c >> 8) & 0xFF;
+            image[idx+2] = (c >> 16) & 0xFF;
         }
+        count_pixels(width, iterations, escaped);
+        trace_end("row", span, 0, y, width, 1);
     }
+    palette_lut_release(lut);
 }
 
 void generate_parallel(unsigned char *image, int width, int height,
@@ -59,32 +103,37 @@ void generate_parallel(unsigned char *image, int width, int height,
     double x_max = center_x + scale / 2;
     double y_min = center_y - (scale / aspect_ratio) / 2;
     double y_max = center_y + (scale / aspect_ratio) / 2;
+    const uint32_t *lut = palette_lut(PALETTE_CLASSIC, max_iter);
+    if (!lut) return;
 
-    #pragma omp parallel for schedule(dynamic)
-    for (int y = 0; y < height; y++) {
-        for (int x = 0; x < width; x++) {
-            double zx = 0.0, zy = 0.0;
-            double cX = x_min + (x / (double)width) * (x_max - x_min);
-            double cY = y_min + (y / (double)height) * (y_max - y_min);
-            int iter;
-            for (iter = 0; iter < max_iter; iter++) {
-                double tmp = zx * zx - zy * zy + cX;
-                zy = 2.0 * zx * zy + cY;
-                zx = tmp;
-                if ((zx * zx + zy * zy) > 4.0) break;
+    #pragma omp parallel
+    {
+        uint64_t thread_span = trace_begin();
+        #pragma omp for schedule(dynamic) nowait
+        for (int y = 0; y < height; y++) {
+            uint64_t span = trace_begin(), iterations = 0, escaped = 0;
+            for (int x = 0; x < width; x++) {
+                double cX = x_min + (x / (double)width) * (x_max - x_min);
+                double cY = y_min + (y / (double)height) * (y_max - y_min);
+                int iter = mandelbrot_pixel(cX, cY, max_iter);
+                iterations += iter;
+                escaped += iter < max_iter;
+                uint32_t c = lut[iter];
+                size_t idx = ((size_t)y * width + x) * 3;
+                image[idx] = c & 0xFF;
+                image[idx+1] = (c >> 8) & 0xFF;
+                image[idx+2] = (c >> 16) & 0xFF;
             }
-            unsigned char r, g, b;
-            iter_to_rgb(iter, max_iter, &r, &g, &b);
-            int idx = (y * width + x) * 3;
-            image[idx] = r;
-            image[idx+1] = g;
-            image[idx+2] = b;
+            count_pixels(width, iterations, escaped);
+            trace_end("row", span, 0, y, width, 1);
         }
+        trace_end("thread", thread_span, 0, 0, 0, 0);
     }
+    palette_lut_release(lut);
 }
 
 int save_png(const char *path, const unsigned char *image, int width, int height) {
-    return stbi_write_png(path, width, height, 3, image, width * 3) != 0;
+    return png_write_image(path, image, (uint32_t)width, (uint32_t)height, PNG_RGB, 8, -1);
 }
 
 static int julia_pixel(double zx, double zy, double c_real, double c_imag, int max_iter) {
@@ -105,19 +154,27 @@ void generate_julia_serial(unsigned char *img, int width, int height,
     double aspect = (double)width / (double)height;
     double x_min = center_x - scale/2.0;
     double y_min = center_y - (scale/aspect)/2.0;
+    const uint32_t *lut = palette_lut(PALETTE_GRAY, max_iter);
+    if (!lut) return;
 
     for (int y = 0; y < height; y++) {
+        uint64_t span = trace_begin(), iterations = 0, escaped = 0;
         for (int x = 0; x < width; x++) {
             double zx = x_min + (double)x / width * scale;
             double zy = y_min + (double)y / height * (scale/aspect);
             int iter = julia_pixel(zx, zy, c_real, c_imag, max_iter);
-            int idx = (y * width + x) * 3;
-            unsigned char color = (unsigned char)(255.0 * iter / max_iter);
+            iterations += iter;
+            escaped += iter < max_iter;
+            size_t idx = ((size_t)y * width + x) * 3;
+            unsigned char color = lut[iter] & 0xFF;
             img[idx] = color;
             img[idx+1] = color;
             img[idx+2] = color;
         }
+        count_pixels(width, iterations, escaped);
+        trace_end("row", span, 0, y, width, 1);
     }
+    palette_lut_release(lut);
 }
 
 void generate_julia_parallel(unsigned char *img, int width, int height,
@@ -127,21 +184,313 @@ void generate_julia_parallel(unsigned char *img, int width, int height,
     double aspect = (double)width / (double)height;
     double x_min = center_x - scale/2.0;
     double y_min = center_y - (scale/aspect)/2.0;
+    const uint32_t *lut = palette_lut(PALETTE_GRAY, max_iter);
+    if (!lut) return;
 
-    #pragma omp parallel for schedule(dynamic)
-    for (int y = 0; y < height; y++) {
-        for (int x = 0; x < width; x++) {
-            double zx = x_min + (double)x / width * scale;
-            double zy = y_min + (double)y / height * (scale/aspect);
-            int iter = julia_pixel(zx, zy, c_real, c_imag, max_iter);
-            int idx = (y * width + x) * 3;
-            unsigned char color = (unsigned char)(255.0 * iter / max_iter);
-            img[idx] = color;
-            img[idx+1] = color;
-            img[idx+2] = color;
+    #pragma omp parallel
+    {
+        uint64_t thread_span = trace_begin();
+        #pragma omp for schedule(dynamic) nowait
+        for (int y = 0; y < height; y++) {
+            uint64_t span = trace_begin(), iterations = 0, escaped = 0;
+            for (int x = 0; x < width; x++) {
+                double zx = x_min + (double)x / width * scale;
+                double zy = y_min + (double)y / height * (scale/aspect);
+                int iter = julia_pixel(zx, zy, c_real, c_imag, max_iter);
+                iterations += iter;
+                escaped += iter < max_iter;
+                size_t idx = ((size_t)y * width + x) * 3;
+                unsigned char color = lut[iter] & 0xFF;
+                img[idx] = color;
+                img[idx+1] = color;
+                img[idx+2] = color;
+            }
+            count_pixels(width, iterations, escaped);
+            trace_end("row", span, 0, y, width, 1);
+        }
+        trace_end("thread", thread_span, 0, 0, 0, 0);
+    }
+    palette_lut_release(lut);
+}
+
+
+
+size_t output_pixel_bytes(int mode) {
+    return mode == OUTPUT_INDEXED ? 1 : mode == OUTPUT_ITER16 ? 2 : 3;
+}
+
+void render_tile_output(void *dst, size_t stride, int width, int height, const FractalView *view,
+                        int x0, int y0, int tile_w, int tile_h, int mode)
+{
+    double aspect = (double)width / (double)height;
+    double x_min = view->center_x - view->scale / 2.0;
+    double y_min = view->center_y - (view->scale / aspect) / 2.0;
+    int max_iter = view->max_iter;
+    const uint32_t *lut = mode == OUTPUT_RGB
+        ? palette_lut(palette_resolve(view->palette, view->julia), max_iter) : NULL;
+    if (mode == OUTPUT_RGB && !lut) return;
+    uint64_t span = trace_begin(), iterations = 0, escaped = 0;
+
+    for (int ty = 0; ty < tile_h; ty++) {
+        unsigned char *row = (unsigned char *)dst + (size_t)ty * stride;
+        double zy = y_min + (double)(y0 + ty) / height * (view->scale / aspect);
+        for (int tx = 0; tx < tile_w; tx++) {
+            double zx = x_min + (double)(x0 + tx) / width * view->scale;
+            int iter = view->julia ? julia_pixel(zx, zy, view->c_real, view->c_imag, max_iter)
+                                   : mandelbrot_pixel(zx, zy, max_iter);
+            iterations += iter;
+            escaped += iter < max_iter;
+            if (mode == OUTPUT_INDEXED) {
+                // 0..254 spread over the escape range, 255 is the interior entry
+                row[tx] = iter >= max_iter ? 255
+                        : (unsigned char)((int64_t)iter * 255 / max_iter);
+            } else if (mode == OUTPUT_ITER16) {
+                ((uint16_t *)row)[tx] = iter > 65535 ? 65535 : (uint16_t)iter;
+            } else {
+                uint32_t c = lut[iter];
+                unsigned char *px = row + (size_t)tx * 3;
+                px[0] = c & 0xFF;
+                px[1] = (c >> 8) & 0xFF;
+                px[2] = (c >> 16) & 0xFF;
+            }
+        }
+    }
+    count_pixels((uint64_t)tile_w * tile_h, iterations, escaped);
+    trace_end("tile", span, x0, y0, tile_w, tile_h);
+    palette_lut_release(lut);
+}
+
+void render_tile(unsigned char *dst, size_t stride, int width, int height,
+                 const FractalView *view, int x0, int y0, int tile_w, int tile_h)
+{
+    render_tile_output(dst, stride, width, height, view, x0, y0, tile_w, tile_h, OUTPUT_RGB);
+}
+
+// The kernels with the loop cut into RENDER_POLL_ITERATIONS chunks; -1
+// once cancelled. Escape counts match mandelbrot_pixel and julia_pixel.
+static int mandelbrot_pixel_polled(double cX, double cY, int max_iter, const int *cancel) {
+    double zx = 0.0, zy = 0.0;
+    int iter = 0;
+    while (iter < max_iter) {
+        int stop = max_iter - iter > RENDER_POLL_ITERATIONS ? iter + RENDER_POLL_ITERATIONS : max_iter;
+        for (; iter < stop; iter++) {
+            double tmp = zx * zx - zy * zy + cX;
+            zy = 2.0 * zx * zy + cY;
+            zx = tmp;
+            if ((zx * zx + zy * zy) > 4.0) return iter;
+        }
+        if (iter < max_iter && __atomic_load_n(cancel, __ATOMIC_RELAXED)) return -1;
+    }
+    return iter;
+}
+
+static int julia_pixel_polled(double zx, double zy, double c_real, double c_imag, int max_iter,
+                              const int *cancel) {
+    int iter = 0;
+    while (iter < max_iter) {
+        int stop = max_iter - iter > RENDER_POLL_ITERATIONS ? iter + RENDER_POLL_ITERATIONS : max_iter;
+        for (; iter < stop; iter++) {
+            if (zx*zx + zy*zy >= 4.0) return iter;
+            double tmp = zx*zx - zy*zy + c_real;
+            zy = 2.0*zx*zy + c_imag;
+            zx = tmp;
         }
+        if (iter < max_iter && __atomic_load_n(cancel, __ATOMIC_RELAXED)) return -1;
     }
+    return iter;
 }
 
+int render_tile_polled(unsigned char *dst, size_t stride, int width, int height,
+                       const FractalView *view, int x0, int y0, int tile_w, int tile_h,
+                       const int *cancel)
+{
+    double aspect = (double)width / (double)height;
+    double x_min = view->center_x - view->scale / 2.0;
+    double y_min = view->center_y - (view->scale / aspect) / 2.0;
+    int max_iter = view->max_iter;
+    const uint32_t *lut = palette_lut(palette_resolve(view->palette, view->julia), max_iter);
+    if (!lut) return 0;
+    uint64_t span = trace_begin(), pixels = 0, iterations = 0, escaped = 0;
+    // Iterations since the last poll, so runs of cheap pixels poll too
+    int64_t unpolled = 0;
+    int rows = 0;
 
+    for (; rows < tile_h; rows++) {
+        unsigned char *row = dst + (size_t)rows * stride;
+        double zy = y_min + (double)(y0 + rows) / height * (view->scale / aspect);
+        int tx = 0;
+        for (; tx < tile_w; tx++) {
+            if (unpolled >= RENDER_POLL_ITERATIONS) {
+                if (__atomic_load_n(cancel, __ATOMIC_RELAXED)) break;
+                unpolled = 0;
+            }
+            double zx = x_min + (double)(x0 + tx) / width * view->scale;
+            int iter = view->julia ? julia_pixel_polled(zx, zy, view->c_real, view->c_imag, max_iter, cancel)
+                                   : mandelbrot_pixel_polled(zx, zy, max_iter, cancel);
+            if (iter < 0) break;
+            unpolled += iter + 1;
+            pixels++;
+            iterations += iter;
+            escaped += iter < max_iter;
+            uint32_t c = lut[iter];
+            unsigned char *px = row + (size_t)tx * 3;
+            px[0] = c & 0xFF;
+            px[1] = (c >> 8) & 0xFF;
+            px[2] = (c >> 16) & 0xFF;
+        }
+        if (tx < tile_w) break;
+    }
+    count_pixels(pixels, iterations, escaped);
+    trace_end("tile", span, x0, y0, tile_w, rows);
+    palette_lut_release(lut);
+    return rows;
+}
 
+void render_expmap_tile(unsigned char *dst, size_t stride, int strip_w, double log_r0,
+                        const FractalView *view, int x0, int y0, int tile_w, int tile_h)
+{
+    double step = 2.0 * M_PI / strip_w;
+    int max_iter = view->max_iter;
+    const uint32_t *lut = palette_lut(palette_resolve(view->palette, view->julia), max_iter);
+    if (!lut) return;
+    uint64_t span = trace_begin(), iterations = 0, escaped = 0;
+
+    for (int ty = 0; ty < tile_h; ty++) {
+        unsigned char *row = dst + (size_t)ty * stride;
+        double r = exp(log_r0 + (y0 + ty) * step);
+        for (int tx = 0; tx < tile_w; tx++) {
+            double theta = (x0 + tx) * step;
+            double zx = view->center_x + r * cos(theta);
+            double zy = view->center_y + r * sin(theta);
+            int iter = view->julia ? julia_pixel(zx, zy, view->c_real, view->c_imag, max_iter)
+                                   : mandelbrot_pixel(zx, zy, max_iter);
+            iterations += iter;
+            escaped += iter < max_iter;
+            uint32_t c = lut[iter];
+            unsigned char *px = row + (size_t)tx * 3;
+            px[0] = c & 0xFF;
+            px[1] = (c >> 8) & 0xFF;
+            px[2] = (c >> 16) & 0xFF;
+        }
+    }
+    count_pixels((uint64_t)tile_w * tile_h, iterations, escaped);
+    trace_end("tile", span, x0, y0, tile_w, tile_h);
+    palette_lut_release(lut);
+}
+
+void generate_output_parallel(void *image, int width, int height, const FractalView *view, int mode) {
+    size_t stride = (size_t)width * output_pixel_bytes(mode);
+
+    #pragma omp parallel
+    {
+        uint64_t thread_span = trace_begin();
+        #pragma omp for schedule(dynamic) nowait
+        for (int y = 0; y < height; y++)
+            render_tile_output((unsigned char *)image + (size_t)y * stride, stride,
+                               width, height, view, 0, y, width, 1, mode);
+        trace_end("thread", thread_span, 0, 0, 0, 0);
+    }
+}
+
+void generate_iter_parallel(uint32_t *iters, int width, int height, const FractalView *view) {
+    double aspect = (double)width / (double)height;
+    double x_min = view->center_x - view->scale / 2.0;
+    double y_min = view->center_y - (view->scale / aspect) / 2.0;
+
+    #pragma omp parallel
+    {
+        uint64_t thread_span = trace_begin();
+        #pragma omp for schedule(dynamic) nowait
+        for (int y = 0; y < height; y++) {
+            uint32_t *row = iters + (size_t)y * width;
+            double zy = y_min + (double)y / height * (view->scale / aspect);
+            uint64_t span = trace_begin(), iterations = 0, escaped = 0;
+            for (int x = 0; x < width; x++) {
+                double zx = x_min + (double)x / width * view->scale;
+                row[x] = view->julia ? julia_pixel(zx, zy, view->c_real, view->c_imag, view->max_iter)
+                                     : mandelbrot_pixel(zx, zy, view->max_iter);
+                iterations += row[x];
+                escaped += row[x] < (uint32_t)view->max_iter;
+            }
+            count_pixels(width, iterations, escaped);
+            trace_end("row", span, 0, y, width, 1);
+        }
+        trace_end("thread", thread_span, 0, 0, 0, 0);
+    }
+}
+
+static int compare_int(const void *a, const void *b) {
+    int x = *(const int *)a, y = *(const int *)b;
+    return (x > y) - (x < y);
+}
+
+int auto_max_iter(int width, int height, double center_x, double center_y, double scale,
+                  int julia, double c_real, double c_imag, int fixed_iter, AutoIter *info)
+{
+    // Zoom depth estimate: deeper views need more iterations to resolve the boundary
+    double depth = log10((double)width / scale);
+    if (depth < 1.0) depth = 1.0;
+    int depth_iter = (int)(50.0 * pow(depth, 1.25));
+    if (depth_iter < AUTO_ITER_MIN) depth_iter = AUTO_ITER_MIN;
+
+    int probe_iter = depth_iter * 8;
+    if (probe_iter < fixed_iter) probe_iter = fixed_iter;
+    if (probe_iter > AUTO_ITER_MAX) probe_iter = AUTO_ITER_MAX;
+
+    // Low-resolution probe over the same viewport as the full render
+    int pw = AUTO_PROBE_SIZE;
+    int ph = (int)((double)AUTO_PROBE_SIZE * height / width);
+    if (ph < 1) ph = 1;
+    if (ph > AUTO_PROBE_SIZE) ph = AUTO_PROBE_SIZE;
+
+    double aspect = (double)width / height;
+    double x_min = center_x - scale / 2.0;
+    double y_min = center_y - (scale / aspect) / 2.0;
+
+    int *counts = malloc((size_t)pw * ph * sizeof(int));
+    if (!counts) return fixed_iter;
+
+    #pragma omp parallel for schedule(dynamic)
+    for (int py = 0; py < ph; py++) {
+        double y = (py + 0.5) * height / ph;
+        for (int px = 0; px < pw; px++) {
+            double x = (px + 0.5) * width / pw;
+            double zx = x_min + x / width * scale;
+            double zy = y_min + y / height * (scale / aspect);
+            counts[py * pw + px] = julia ? julia_pixel(zx, zy, c_real, c_imag, probe_iter)
+                                         : mandelbrot_pixel(zx, zy, probe_iter);
+        }
+    }
+
+    int n = pw * ph;
+    qsort(counts, n, sizeof(int), compare_int);
+
+    int escaped = 0;
+    while (escaped < n && counts[escaped] < probe_iter) escaped++;
+
+    // Cover nearly every escaping probe pixel, with headroom for detail between samples
+    int max_iter = depth_iter;
+    if (escaped > 0) {
+        int p = counts[(int)((escaped - 1) * AUTO_ITER_PERCENTILE)];
+        int wanted = p + p / 4 + 1;
+        if (wanted > max_iter) max_iter = wanted;
+    }
+    if (max_iter > probe_iter) max_iter = probe_iter;
+
+    if (info) {
+        double work_auto = 0.0, work_fixed = 0.0;
+        for (int i = 0; i < n; i++) {
+            work_auto += counts[i] < max_iter ? counts[i] : max_iter;
+            work_fixed += counts[i] < fixed_iter ? counts[i] : fixed_iter;
+        }
+        info->max_iter = max_iter;
+        info->depth_iter = depth_iter;
+        info->probe_iter = probe_iter;
+        info->interior_ratio = (double)(n - escaped) / n;
+        info->work_auto = work_auto / n;
+        info->work_fixed = work_fixed / n;
+    }
+
+    free(counts);
+    return max_iter;
+}
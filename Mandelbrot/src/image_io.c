@@ -0,0 +1,225 @@
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "image_io.h"
+#include "png_stream.h"
+#include "metrics.h"
+#include "trace.h"
+#include "stb_image_write.h"
+
+#define IMAGE_IO_BAND 64
+
+static const char *format_ext[IMAGE_FORMAT_COUNT] = {
+    "png", "qoi", "ppm", "pam", "bmp", "tga", "jpg"
+};
+
+const char *image_format_ext(int format) {
+    return format >= 0 && format < IMAGE_FORMAT_COUNT ? format_ext[format] : "png";
+}
+
+int image_format_from_name(const char *name) {
+    for (int i = 0; i < IMAGE_FORMAT_COUNT; i++)
+        if (strcmp(name, format_ext[i]) == 0) return i;
+    return -1;
+}
+
+static FILE *open_buffered(const char *path) {
+    FILE *f = fopen(path, "wb");
+    if (f) setvbuf(f, NULL, _IOFBF, IMAGE_IO_BUFFER);
+    return f;
+}
+
+static int close_checked(FILE *f, int ok) {
+    if (fclose(f) != 0) ok = 0;
+    return ok;
+}
+
+// Netpbm: a text header and the RGB buffer as-is, one large write
+static int save_netpbm(const char *path, const unsigned char *rgb, int width, int height, int pam) {
+    FILE *f = open_buffered(path);
+    if (!f) return 0;
+    size_t size = (size_t)width * height * 3;
+    int ok = pam
+        ? fprintf(f, "P7\nWIDTH %d\nHEIGHT %d\nDEPTH 3\nMAXVAL 255\nTUPLTYPE RGB\nENDHDR\n", width, height) > 0
+        : fprintf(f, "P6\n%d %d\n255\n", width, height) > 0;
+    ok = ok && fwrite(rgb, 1, size, f) == size;
+    return close_checked(f, ok);
+}
+
+static void put_le16(unsigned char *p, uint32_t v) {
+    p[0] = (unsigned char)v;
+    p[1] = (unsigned char)(v >> 8);
+}
+
+static void put_le32(unsigned char *p, uint32_t v) {
+    put_le16(p, v);
+    put_le16(p + 2, v >> 16);
+}
+
+// BMP and TGA store BGR; rows are swizzled a band at a time in parallel.
+// BMP rows are bottom-up and padded to 4 bytes, TGA rows are top-down here.
+static int write_bgr_rows(FILE *f, const unsigned char *rgb, int width, int height,
+                          size_t row_out, int bottom_up) {
+    unsigned char *band = calloc(row_out * IMAGE_IO_BAND, 1);
+    if (!band) return 0;
+    int ok = 1;
+    for (int b0 = 0; ok && b0 < height; b0 += IMAGE_IO_BAND) {
+        int rows = height - b0 < IMAGE_IO_BAND ? height - b0 : IMAGE_IO_BAND;
+        #pragma omp parallel for schedule(static)
+        for (int r = 0; r < rows; r++) {
+            int y = bottom_up ? height - 1 - (b0 + r) : b0 + r;
+            const unsigned char *src = rgb + (size_t)y * width * 3;
+            unsigned char *dst = band + (size_t)r * row_out;
+            for (int x = 0; x < width; x++) {
+                dst[x * 3] = src[x * 3 + 2];
+                dst[x * 3 + 1] = src[x * 3 + 1];
+                dst[x * 3 + 2] = src[x * 3];
+            }
+        }
+        ok = fwrite(band, 1, row_out * rows, f) == row_out * rows;
+    }
+    free(band);
+    return ok;
+}
+
+static int save_bmp(const char *path, const unsigned char *rgb, int width, int height) {
+    size_t row_out = ((size_t)width * 3 + 3) & ~(size_t)3;
+    size_t data = row_out * height;
+    if (data + 54 > UINT32_MAX) return 0;
+
+    unsigned char hdr[54] = { 'B', 'M' };
+    put_le32(hdr + 2, (uint32_t)(data + 54));
+    put_le32(hdr + 10, 54);
+    put_le32(hdr + 14, 40);
+    put_le32(hdr + 18, (uint32_t)width);
+    put_le32(hdr + 22, (uint32_t)height);
+    put_le16(hdr + 26, 1);
+    put_le16(hdr + 28, 24);
+    put_le32(hdr + 34, (uint32_t)data);
+
+    FILE *f = open_buffered(path);
+    if (!f) return 0;
+    int ok = fwrite(hdr, 1, sizeof(hdr), f) == sizeof(hdr)
+             && write_bgr_rows(f, rgb, width, height, row_out, 1);
+    return close_checked(f, ok);
+}
+
+static int save_tga(const char *path, const unsigned char *rgb, int width, int height) {
+    if (width > 65535 || height > 65535) return 0;
+    unsigned char hdr[18] = { 0 };
+    hdr[2] = 2;  // uncompressed true-color
+    put_le16(hdr + 12, (uint32_t)width);
+    put_le16(hdr + 14, (uint32_t)height);
+    hdr[16] = 24;
+    hdr[17] = 0x20;  // top-left origin
+
+    FILE *f = open_buffered(path);
+    if (!f) return 0;
+    int ok = fwrite(hdr, 1, sizeof(hdr), f) == sizeof(hdr)
+             && write_bgr_rows(f, rgb, width, height, (size_t)width * 3, 0);
+    return close_checked(f, ok);
+}
+
+// QOI ("Quite OK Image") encoder, https://qoiformat.org/qoi-specification.pdf
+#define QOI_OP_INDEX 0x00
+#define QOI_OP_DIFF 0x40
+#define QOI_OP_LUMA 0x80
+#define QOI_OP_RUN 0xc0
+#define QOI_OP_RGB 0xfe
+
+static int save_qoi(const char *path, const unsigned char *rgb, int width, int height) {
+    FILE *f = open_buffered(path);
+    if (!f) return 0;
+    size_t cap = IMAGE_IO_BUFFER;
+    unsigned char *out = malloc(cap);
+    if (!out) return close_checked(f, 0);
+
+    unsigned char hdr[14] = { 'q', 'o', 'i', 'f' };
+    for (int i = 0; i < 4; i++) {
+        hdr[4 + i] = (unsigned char)((uint32_t)width >> (24 - 8 * i));
+        hdr[8 + i] = (unsigned char)((uint32_t)height >> (24 - 8 * i));
+    }
+    hdr[12] = 3;  // RGB
+    hdr[13] = 0;  // sRGB with linear alpha
+    int ok = fwrite(hdr, 1, sizeof(hdr), f) == sizeof(hdr);
+
+    // RGBA like the decoder's: entries start as (0,0,0,0), so an opaque black
+    // pixel is not a hit in its slot until it has been stored there
+    unsigned char index[64][4];
+    memset(index, 0, sizeof(index));
+    unsigned char pr = 0, pg = 0, pb = 0;  // previous pixel, alpha stays 255
+    size_t n = (size_t)width * height, len = 0;
+    int run = 0;
+
+    for (size_t i = 0; ok && i < n; i++) {
+        unsigned char r = rgb[i * 3], g = rgb[i * 3 + 1], b = rgb[i * 3 + 2];
+        if (len + 8 > cap) {
+            ok = fwrite(out, 1, len, f) == len;
+            len = 0;
+        }
+        if (r == pr && g == pg && b == pb) {
+            if (++run == 62 || i == n - 1) {
+                out[len++] = (unsigned char)(QOI_OP_RUN | (run - 1));
+                run = 0;
+            }
+            continue;
+        }
+        if (run > 0) {
+            out[len++] = (unsigned char)(QOI_OP_RUN | (run - 1));
+            run = 0;
+        }
+        int h = (r * 3 + g * 5 + b * 7 + 255 * 11) % 64;
+        if (index[h][0] == r && index[h][1] == g && index[h][2] == b && index[h][3] == 255) {
+            out[len++] = (unsigned char)(QOI_OP_INDEX | h);
+        } else {
+            index[h][0] = r;
+            index[h][1] = g;
+            index[h][2] = b;
+            index[h][3] = 255;
+            signed char dr = (signed char)(r - pr), dg = (signed char)(g - pg), db = (signed char)(b - pb);
+            signed char dr_dg = (signed char)(dr - dg), db_dg = (signed char)(db - dg);
+            if (dr > -3 && dr < 2 && dg > -3 && dg < 2 && db > -3 && db < 2) {
+                out[len++] = (unsigned char)(QOI_OP_DIFF | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2));
+            } else if (dg > -33 && dg < 32 && dr_dg > -9 && dr_dg < 8 && db_dg > -9 && db_dg < 8) {
+                out[len++] = (unsigned char)(QOI_OP_LUMA | (dg + 32));
+                out[len++] = (unsigned char)((dr_dg + 8) << 4 | (db_dg + 8));
+            } else {
+                out[len++] = QOI_OP_RGB;
+                out[len++] = r;
+                out[len++] = g;
+                out[len++] = b;
+            }
+        }
+        pr = r;
+        pg = g;
+        pb = b;
+    }
+
+    static const unsigned char end[8] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+    ok = ok && fwrite(out, 1, len, f) == len && fwrite(end, 1, 8, f) == 8;
+    free(out);
+    return close_checked(f, ok);
+}
+
+int save_image(const char *path, const unsigned char *rgb, int width, int height,
+               int format, int level)
+{
+    double start = omp_get_wtime();
+    uint64_t span = trace_begin();
+    int ok;
+    switch (format) {
+    case IMAGE_QOI: ok = save_qoi(path, rgb, width, height); break;
+    case IMAGE_PPM: ok = save_netpbm(path, rgb, width, height, 0); break;
+    case IMAGE_PAM: ok = save_netpbm(path, rgb, width, height, 1); break;
+    case IMAGE_BMP: ok = save_bmp(path, rgb, width, height); break;
+    case IMAGE_TGA: ok = save_tga(path, rgb, width, height); break;
+    case IMAGE_JPG: ok = stbi_write_jpg(path, width, height, 3, rgb, 90) != 0; break;
+    default:
+        ok = png_write_image(path, rgb, (uint32_t)width, (uint32_t)height, PNG_RGB, 8, level);
+    }
+    metrics_observe(METRIC_ENCODE_SECONDS, omp_get_wtime() - start);
+    trace_end("encode", span, 0, 0, width, height);
+    return ok;
+}
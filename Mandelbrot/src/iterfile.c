@@ -0,0 +1,388 @@
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "iterfile.h"
+
+#define ITERFILE_MAGIC "MBITER1"
+#define RICE_ESCAPE 24  // unary quotients this long are followed by the raw 32-bit value
+
+typedef struct {
+    char magic[8];
+    int32_t width, height, tile;
+    int32_t tiles_x, tiles_y;
+    FractalView view;
+} IterFileHeader;
+
+struct IterFile {
+    int fd;
+    int width, height, tile, tiles_x, tiles_y;
+    uint32_t max_iter;
+    uint64_t *index;  // tiles + 1 offsets, tile t spans [index[t], index[t + 1])
+};
+
+static int write_full(int fd, const void *buf, size_t len, off_t off) {
+    const unsigned char *p = buf;
+    while (len > 0) {
+        ssize_t n = pwrite(fd, p, len, off);
+        if (n <= 0) return 0;
+        p += n; len -= (size_t)n; off += n;
+    }
+    return 1;
+}
+
+static int read_full(int fd, void *buf, size_t len, off_t off) {
+    unsigned char *p = buf;
+    while (len > 0) {
+        ssize_t n = pread(fd, p, len, off);
+        if (n <= 0) return 0;
+        p += n; len -= (size_t)n; off += n;
+    }
+    return 1;
+}
+
+// Worst case: every residual escaped (RICE_ESCAPE + 32 bits) plus block codes
+static size_t tile_bound(int tile) {
+    return (size_t)tile * tile * 8 + 16;
+}
+
+static void tile_dims(int width, int height, int tile, int tx, int ty, int *tw, int *th) {
+    *tw = width - tx * tile < tile ? width - tx * tile : tile;
+    *th = height - ty * tile < tile ? height - ty * tile : tile;
+}
+
+// Median edge detector (LOCO-I) on tile-local neighbours, so tiles decode independently
+static inline uint32_t predict(const uint32_t *p, size_t stride, int x, int y) {
+    if (y == 0) return x ? p[-1] : 0;
+    if (x == 0) return p[-(ptrdiff_t)stride];
+    uint32_t a = p[-1], b = p[-(ptrdiff_t)stride], c = p[-(ptrdiff_t)stride - 1];
+    uint32_t lo = a < b ? a : b, hi = a < b ? b : a;
+    if (c >= hi) return lo;
+    if (c <= lo) return hi;
+    return a + b - c;
+}
+
+typedef struct {
+    unsigned char *p;
+    uint64_t acc;
+    int bits;
+} BitWriter;
+
+static inline void put_bits(BitWriter *w, uint32_t v, int n) {
+    if (n < 32) v &= (1u << n) - 1;
+    w->acc = (w->acc << n) | v;
+    w->bits += n;
+    while (w->bits >= 8) {
+        w->bits -= 8;
+        *w->p++ = (unsigned char)(w->acc >> w->bits);
+    }
+}
+
+static inline void put_rice(BitWriter *w, uint32_t v, int k) {
+    uint32_t q = v >> k;
+    if (q >= RICE_ESCAPE) {
+        put_bits(w, (1u << RICE_ESCAPE) - 1, RICE_ESCAPE);
+        put_bits(w, v, 32);
+        return;
+    }
+    put_bits(w, ((1u << q) - 1) << 1, (int)q + 1);
+    if (k) put_bits(w, v, k);
+}
+
+static uint64_t rice_cost(const uint32_t *v, int n, int k) {
+    uint64_t bits = 0;
+    for (int i = 0; i < n; i++) {
+        uint32_t q = v[i] >> k;
+        bits += q >= RICE_ESCAPE ? RICE_ESCAPE + 32 : q + 1 + (uint32_t)k;
+    }
+    return bits;
+}
+
+// Each block starts with a 5-bit code: 0 = all residuals zero, else Rice k + 1
+static void put_block(BitWriter *w, const uint32_t *v, int n) {
+    uint64_t sum = 0;
+    for (int i = 0; i < n; i++) sum += v[i];
+    if (sum == 0) {
+        put_bits(w, 0, 5);
+        return;
+    }
+    int k = 0;
+    while (k < 30 && ((uint64_t)n << (k + 1)) <= sum) k++;
+    uint64_t best = rice_cost(v, n, k);
+    for (int c = k - 1; c <= k + 1; c += 2) {
+        if (c < 0 || c > 30) continue;
+        uint64_t cost = rice_cost(v, n, c);
+        if (cost < best) {
+            best = cost;
+            k = c;
+        }
+    }
+    put_bits(w, (uint32_t)k + 1, 5);
+    for (int i = 0; i < n; i++) put_rice(w, v[i], k);
+}
+
+// resid is scratch for tw * th values; returns the coded size in out
+static size_t encode_tile(unsigned char *out, uint32_t *resid, const uint32_t *src,
+                          size_t stride, int tw, int th) {
+    size_t n = 0;
+    for (int y = 0; y < th; y++) {
+        const uint32_t *row = src + (size_t)y * stride;
+        for (int x = 0; x < tw; x++) {
+            int32_t r = (int32_t)(row[x] - predict(row + x, stride, x, y));
+            resid[n++] = ((uint32_t)r << 1) ^ (uint32_t)(r >> 31);
+        }
+    }
+
+    BitWriter w = { out, 0, 0 };
+    for (size_t i = 0; i < n; i += ITERFILE_BLOCK)
+        put_block(&w, resid + i, n - i < ITERFILE_BLOCK ? (int)(n - i) : ITERFILE_BLOCK);
+    if (w.bits) *w.p++ = (unsigned char)(w.acc << (8 - w.bits));
+    return (size_t)(w.p - out);
+}
+
+typedef struct {
+    const unsigned char *p, *end;
+    uint64_t acc;  // MSB-aligned
+    int bits;
+} BitReader;
+
+static inline void refill(BitReader *r) {
+    while (r->bits <= 56) {
+        uint64_t byte = r->p < r->end ? *r->p++ : 0;
+        r->acc |= byte << (56 - r->bits);
+        r->bits += 8;
+    }
+}
+
+static inline uint32_t get_bits(BitReader *r, int n) {
+    if (n == 0) return 0;
+    refill(r);
+    uint32_t v = (uint32_t)(r->acc >> (64 - n));
+    r->acc <<= n;
+    r->bits -= n;
+    return v;
+}
+
+static inline uint32_t get_rice(BitReader *r, int k) {
+    refill(r);
+    // Leading ones of acc, capped at RICE_ESCAPE by a forced zero bit
+    int q = __builtin_clzll(~r->acc | (1ull << (63 - RICE_ESCAPE)));
+    if (q >= RICE_ESCAPE) {
+        r->acc <<= RICE_ESCAPE;
+        r->bits -= RICE_ESCAPE;
+        return get_bits(r, 32);
+    }
+    r->acc <<= q + 1;
+    r->bits -= q + 1;
+    return ((uint32_t)q << k) | get_bits(r, k);
+}
+
+static int decode_tile(uint32_t *dst, size_t stride, uint32_t *resid, const unsigned char *in,
+                       size_t len, int tw, int th, uint32_t max_iter) {
+    BitReader r = { in, in + len, 0, 0 };
+    size_t n = (size_t)tw * th;
+    for (size_t i = 0; i < n; i += ITERFILE_BLOCK) {
+        size_t m = n - i < ITERFILE_BLOCK ? n - i : ITERFILE_BLOCK;
+        uint32_t code = get_bits(&r, 5);
+        if (code == 0) {
+            memset(resid + i, 0, m * sizeof(uint32_t));
+            continue;
+        }
+        for (size_t j = 0; j < m; j++) resid[i + j] = get_rice(&r, (int)code - 1);
+    }
+
+    n = 0;
+    for (int y = 0; y < th; y++) {
+        uint32_t *row = dst + (size_t)y * stride;
+        for (int x = 0; x < tw; x++) {
+            uint32_t z = resid[n++];
+            uint32_t v = predict(row + x, stride, x, y) + ((z >> 1) ^ (0u - (z & 1)));
+            if (v > max_iter) return 0;  // corrupt, would index past the palette
+            row[x] = v;
+        }
+    }
+    return 1;
+}
+
+int iterfile_save(const char *path, const uint32_t *iters, int width, int height,
+                  const FractalView *view)
+{
+    IterFileHeader hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.width = width;
+    hdr.height = height;
+    hdr.tile = ITERFILE_TILE;
+    hdr.tiles_x = (width + ITERFILE_TILE - 1) / ITERFILE_TILE;
+    hdr.tiles_y = (height + ITERFILE_TILE - 1) / ITERFILE_TILE;
+    hdr.view = *view;
+    size_t tiles = (size_t)hdr.tiles_x * hdr.tiles_y;
+
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return 0;
+    uint64_t *index = malloc((tiles + 1) * sizeof(uint64_t));
+    unsigned char **coded = calloc((size_t)hdr.tiles_x, sizeof(unsigned char *));
+    size_t *sizes = calloc((size_t)hdr.tiles_x, sizeof(size_t));
+    int ok = index && coded && sizes;
+    uint64_t pos = sizeof(hdr) + (tiles + 1) * sizeof(uint64_t);
+
+    for (int ty = 0; ok && ty < hdr.tiles_y; ty++) {
+        int failed = 0;
+        #pragma omp parallel
+        {
+            uint32_t *resid = malloc((size_t)ITERFILE_TILE * ITERFILE_TILE * sizeof(uint32_t));
+            unsigned char *scratch = malloc(tile_bound(ITERFILE_TILE));
+            #pragma omp for schedule(dynamic)
+            for (int tx = 0; tx < hdr.tiles_x; tx++) {
+                if (!resid || !scratch) {
+                    failed = 1;
+                    continue;
+                }
+                int tw, th;
+                tile_dims(width, height, ITERFILE_TILE, tx, ty, &tw, &th);
+                const uint32_t *src = iters + (size_t)ty * ITERFILE_TILE * width + (size_t)tx * ITERFILE_TILE;
+                sizes[tx] = encode_tile(scratch, resid, src, (size_t)width, tw, th);
+                coded[tx] = malloc(sizes[tx]);
+                if (coded[tx]) memcpy(coded[tx], scratch, sizes[tx]);
+                else failed = 1;
+            }
+            free(resid);
+            free(scratch);
+        }
+        ok = !failed;
+
+        // Tile rows are written in order as soon as they are coded
+        for (int tx = 0; tx < hdr.tiles_x; tx++) {
+            index[(size_t)ty * hdr.tiles_x + tx] = pos;
+            ok = ok && write_full(fd, coded[tx], sizes[tx], (off_t)pos);
+            pos += sizes[tx];
+            free(coded[tx]);
+            coded[tx] = NULL;
+        }
+    }
+
+    if (ok) {
+        index[tiles] = pos;
+        // Header last: an interrupted save never carries a valid magic
+        memcpy(hdr.magic, ITERFILE_MAGIC, sizeof(hdr.magic));
+        ok = write_full(fd, index, (tiles + 1) * sizeof(uint64_t), sizeof(hdr))
+             && write_full(fd, &hdr, sizeof(hdr), 0);
+    }
+    free(index);
+    free(coded);
+    free(sizes);
+    if (close(fd) != 0) ok = 0;
+    return ok;
+}
+
+IterFile *iterfile_open(const char *path, int *width, int *height, FractalView *view) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+    IterFileHeader hdr;
+    // The writer always uses ITERFILE_TILE; any other tile size is corrupt,
+    // and a huge one would overflow the tile counts and the buffer sizes
+    // derived from it
+    if (!read_full(fd, &hdr, sizeof(hdr), 0) || memcmp(hdr.magic, ITERFILE_MAGIC, sizeof(hdr.magic)) != 0
+        || hdr.tile != ITERFILE_TILE || hdr.view.max_iter < 0
+        || hdr.width <= 0 || hdr.height <= 0
+        || hdr.width > INT_MAX - ITERFILE_TILE || hdr.height > INT_MAX - ITERFILE_TILE
+        || hdr.tiles_x != (hdr.width + hdr.tile - 1) / hdr.tile
+        || hdr.tiles_y != (hdr.height + hdr.tile - 1) / hdr.tile) {
+        close(fd);
+        return NULL;
+    }
+
+    IterFile *f = malloc(sizeof(IterFile));
+    size_t tiles = (size_t)hdr.tiles_x * hdr.tiles_y;
+    if (f) f->index = malloc((tiles + 1) * sizeof(uint64_t));
+    if (!f || !f->index || !read_full(fd, f->index, (tiles + 1) * sizeof(uint64_t), sizeof(hdr))) {
+        if (f) free(f->index);
+        free(f);
+        close(fd);
+        return NULL;
+    }
+    f->fd = fd;
+    f->width = hdr.width;
+    f->height = hdr.height;
+    f->tile = hdr.tile;
+    f->tiles_x = hdr.tiles_x;
+    f->tiles_y = hdr.tiles_y;
+    f->max_iter = (uint32_t)hdr.view.max_iter;
+    if (width) *width = hdr.width;
+    if (height) *height = hdr.height;
+    if (view) *view = hdr.view;
+    return f;
+}
+
+int iterfile_tile_size(const IterFile *f) {
+    return f->tile;
+}
+
+static int read_tile_scratch(IterFile *f, int tx, int ty, uint32_t *dst, size_t stride,
+                             uint32_t *resid, unsigned char *in) {
+    if (tx < 0 || ty < 0 || tx >= f->tiles_x || ty >= f->tiles_y) return 0;
+    size_t t = (size_t)ty * f->tiles_x + tx;
+    uint64_t off = f->index[t];
+    if (f->index[t + 1] < off || f->index[t + 1] - off > tile_bound(f->tile)) return 0;
+    size_t len = (size_t)(f->index[t + 1] - off);
+    int tw, th;
+    tile_dims(f->width, f->height, f->tile, tx, ty, &tw, &th);
+    return read_full(f->fd, in, len, (off_t)off)
+        && decode_tile(dst, stride, resid, in, len, tw, th, f->max_iter);
+}
+
+int iterfile_read_tile(IterFile *f, int tx, int ty, uint32_t *dst, size_t stride) {
+    uint32_t *resid = malloc((size_t)f->tile * f->tile * sizeof(uint32_t));
+    unsigned char *in = malloc(tile_bound(f->tile));
+    int ok = resid && in && read_tile_scratch(f, tx, ty, dst, stride, resid, in);
+    free(resid);
+    free(in);
+    return ok;
+}
+
+int iterfile_read_all(IterFile *f, uint32_t *iters) {
+    int tiles = f->tiles_x * f->tiles_y;
+    int failed = 0;
+    #pragma omp parallel
+    {
+        uint32_t *resid = malloc((size_t)f->tile * f->tile * sizeof(uint32_t));
+        unsigned char *in = malloc(tile_bound(f->tile));
+        #pragma omp for schedule(dynamic)
+        for (int t = 0; t < tiles; t++) {
+            int tx = t % f->tiles_x, ty = t / f->tiles_x;
+            uint32_t *dst = iters + (size_t)ty * f->tile * f->width + (size_t)tx * f->tile;
+            if (!resid || !in || !read_tile_scratch(f, tx, ty, dst, (size_t)f->width, resid, in))
+                failed = 1;
+        }
+        free(resid);
+        free(in);
+    }
+    return !failed;
+}
+
+void iterfile_close(IterFile *f) {
+    if (!f) return;
+    close(f->fd);
+    free(f->index);
+    free(f);
+}
+
+uint32_t *iterfile_load(const char *path, int *width, int *height, FractalView *view) {
+    int w, h;
+    IterFile *f = iterfile_open(path, &w, &h, view);
+    if (!f) return NULL;
+    uint32_t *iters = malloc((size_t)w * h * sizeof(uint32_t));
+    if (iters && !iterfile_read_all(f, iters)) {
+        free(iters);
+        iters = NULL;
+    }
+    iterfile_close(f);
+    if (iters) {
+        if (width) *width = w;
+        if (height) *height = h;
+    }
+    return iters;
+}
@@ -0,0 +1,99 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "julia_sweep.h"
+#include "palette.h"
+
+void julia_sweep_c(const JuliaSweep *sweep, int col, int row, double *c_real, double *c_imag) {
+    *c_real = sweep->cols > 1 ? sweep->re_min + (sweep->re_max - sweep->re_min) * col / (sweep->cols - 1)
+                              : sweep->re_min;
+    *c_imag = sweep->rows > 1 ? sweep->im_min + (sweep->im_max - sweep->im_min) * row / (sweep->rows - 1)
+                              : sweep->im_min;
+}
+
+// Same escape count as julia_pixel for every lane. The lanes are independent
+// dependency chains, so their multiplies overlap in the pipeline; escaped
+// lanes stop counting but keep their slot, which keeps the body free of
+// per-lane branches for the vectorizer.
+static void julia_lanes(double zx0, double zy0, const double *c_real, const double *c_imag,
+                        int max_iter, int *iter) {
+    double zx[SWEEP_LANES], zy[SWEEP_LANES], count[SWEEP_LANES];
+    for (int l = 0; l < SWEEP_LANES; l++) {
+        zx[l] = zx0;
+        zy[l] = zy0;
+        count[l] = 0.0;
+    }
+    for (int i = 0; i < max_iter; i++) {
+        double active = 0.0;
+        #pragma omp simd reduction(max:active)
+        for (int l = 0; l < SWEEP_LANES; l++) {
+            double x2 = zx[l] * zx[l], y2 = zy[l] * zy[l];
+            double inside = x2 + y2 < 4.0 ? 1.0 : 0.0;
+            double nx = x2 - y2 + c_real[l];
+            double ny = 2.0 * zx[l] * zy[l] + c_imag[l];
+            zx[l] = inside != 0.0 ? nx : zx[l];
+            zy[l] = inside != 0.0 ? ny : zy[l];
+            count[l] += inside;
+            active = active > inside ? active : inside;
+        }
+        if (active == 0.0) break;
+    }
+    for (int l = 0; l < SWEEP_LANES; l++) iter[l] = (int)count[l];
+}
+
+void generate_julia_sweep(unsigned char *atlas, const JuliaSweep *sweep, const FractalView *view,
+                          float *interior) {
+    int thumb = sweep->thumb, max_iter = view->max_iter;
+    int groups = (sweep->cols + SWEEP_LANES - 1) / SWEEP_LANES;
+    size_t stride = (size_t)sweep->cols * thumb * 3;
+    double x_min = view->center_x - view->scale / 2.0;
+    double y_min = view->center_y - view->scale / 2.0;
+    const uint32_t *lut = palette_lut(palette_resolve(view->palette, 1), max_iter);
+    if (!lut) return;
+
+    #pragma omp parallel for schedule(dynamic)
+    for (int task = 0; task < groups * sweep->rows; task++) {
+        int row = task / groups, col0 = (task % groups) * SWEEP_LANES;
+        int lanes = sweep->cols - col0 < SWEEP_LANES ? sweep->cols - col0 : SWEEP_LANES;
+        double c_real[SWEEP_LANES], c_imag[SWEEP_LANES];
+        long inside[SWEEP_LANES] = { 0 };
+        for (int l = 0; l < SWEEP_LANES; l++)  // spare lanes repeat the last c
+            julia_sweep_c(sweep, col0 + (l < lanes ? l : lanes - 1), row, &c_real[l], &c_imag[l]);
+
+        for (int y = 0; y < thumb; y++) {
+            double zy = y_min + (double)y / thumb * view->scale;
+            unsigned char *line = atlas + ((size_t)row * thumb + y) * stride + (size_t)col0 * thumb * 3;
+            for (int x = 0; x < thumb; x++) {
+                int iter[SWEEP_LANES];
+                julia_lanes(x_min + (double)x / thumb * view->scale, zy, c_real, c_imag, max_iter, iter);
+                for (int l = 0; l < lanes; l++) {
+                    uint32_t c = lut[iter[l]];
+                    unsigned char *px = line + ((size_t)l * thumb + x) * 3;
+                    px[0] = c & 0xFF;
+                    px[1] = (c >> 8) & 0xFF;
+                    px[2] = (c >> 16) & 0xFF;
+                    inside[l] += iter[l] >= max_iter;
+                }
+            }
+        }
+        for (int l = 0; interior && l < lanes; l++)
+            interior[(size_t)row * sweep->cols + col0 + l] = (float)inside[l] / ((float)thumb * thumb);
+    }
+    palette_lut_release(lut);
+}
+
+int save_julia_sweep_index(const char *path, const JuliaSweep *sweep, const float *interior) {
+    FILE *f = fopen(path, "w");
+    if (!f) return 0;
+    int ok = fprintf(f, "col,row,x,y,size,c_real,c_imag,interior\n") > 0;
+    for (int row = 0; ok && row < sweep->rows; row++) {
+        for (int col = 0; ok && col < sweep->cols; col++) {
+            double c_real, c_imag;
+            julia_sweep_c(sweep, col, row, &c_real, &c_imag);
+            ok = fprintf(f, "%d,%d,%d,%d,%d,%.17g,%.17g,%.4f\n", col, row, col * sweep->thumb,
+                         row * sweep->thumb, sweep->thumb, c_real, c_imag,
+                         interior ? interior[(size_t)row * sweep->cols + col] : 0.0f) > 0;
+        }
+    }
+    if (fclose(f) != 0) ok = 0;
+    return ok;
+}
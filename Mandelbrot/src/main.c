@@ -1,32 +1,359 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <omp.h>
+#include <sys/resource.h>
 #include "fractal.h"
+#include "checkpoint.h"
+#include "palette.h"
+#include "png_stream.h"
+#include "image_io.h"
+#include "mapped_render.h"
+#include "iterfile.h"
+#include "pyramid.h"
+#include "metrics.h"
+#include "trace.h"
+#include "perfcount.h"
 
-int main() {
-    int width, height, max_iter = 1000;
+static const char *metrics_path;
+static const char *trace_path;
+
+// Every mode returns from main, so the exposition and trace are written once at exit
+static void write_metrics(void) {
+    if (metrics_path && !metrics_write(metrics_path))
+        fprintf(stderr, "Cannot write metrics to %s\n", metrics_path);
+    if (trace_path && !trace_write(trace_path))
+        fprintf(stderr, "Cannot write trace to %s\n", trace_path);
+}
+
+// Long renders: tiled parallel pass only, flushing finished tiles to a checkpoint file
+static int run_checkpointed(unsigned char *image, int width, int height,
+                            const FractalView *view, const char *checkpoint, int resume) {
+    printf("\nGenerating (parallel, checkpoint %s%s)...\n", checkpoint, resume ? ", resuming" : "");
+    double start = omp_get_wtime();
+    if (!generate_parallel_checkpointed(image, width, height, view, checkpoint,
+                                        CHECKPOINT_INTERVAL, resume)) {
+        fprintf(stderr, "Checkpointed render failed (%s)\n", checkpoint);
+        return 0;
+    }
+    printf("Parallel done in %.3f seconds\n", omp_get_wtime() - start);
+    return 1;
+}
+
+// Hardware counters for one benchmark pass. IPC and iterations per cycle
+// say whether the kernel is latency bound, branch misses per thousand
+// instructions whether escapes are unpredictable, cache misses whether it
+// waits on memory, and the packed share of FP instructions how much of the
+// arithmetic is vectorized.
+static void print_perf(const char *label, const PerfReport *r, const PerfCounts *counts, uint64_t iterations) {
+    const uint64_t *v = counts->value;
+    double cycles = (double)v[PERF_CYCLES];
+    if (cycles <= 0.0) return;
+    printf("%-14s %.2f IPC, %.3f iterations/cycle", label,
+           r->available[PERF_INSTRUCTIONS] ? v[PERF_INSTRUCTIONS] / cycles : 0.0, iterations / cycles);
+    if (r->available[PERF_INSTRUCTIONS] && v[PERF_INSTRUCTIONS] > 0) {
+        double kilo = v[PERF_INSTRUCTIONS] / 1000.0;
+        if (r->available[PERF_BRANCH_MISSES]) printf(", %.2f branch misses/Kinstr", v[PERF_BRANCH_MISSES] / kilo);
+        if (r->available[PERF_CACHE_MISSES]) printf(", %.3f cache misses/Kinstr", v[PERF_CACHE_MISSES] / kilo);
+    }
+    uint64_t fp = v[PERF_FP_SCALAR] + v[PERF_FP_PACKED];
+    if (r->available[PERF_FP_SCALAR] && r->available[PERF_FP_PACKED] && fp > 0)
+        printf(", %.1f%% of FP instructions packed", 100.0 * v[PERF_FP_PACKED] / fp);
+    printf("\n");
+}
+
+static void prompt_path(char *path, size_t size, const char *ext) {
+    char filename[256];
+    printf("\nOutput filename (without extension): ");
+    scanf("%255s", filename);
+    snprintf(path, size, "image/%s.%s", filename, ext);
+}
+
+static int save_result(const unsigned char *image, int width, int height, int format, int level) {
+    char path[512];
+    prompt_path(path, sizeof(path), image_format_ext(format));
+
+    double start = omp_get_wtime();
+    if (save_image(path, image, width, height, format, level)) {
+        printf("Export done in %.3f seconds\n", omp_get_wtime() - start);
+        printf("Saved to %s\n", path);
+        return 1;
+    }
+    fprintf(stderr, "Failed to save image\n");
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    int width, height, max_iter = AUTO_ITER_FIXED;
     double center_x = -0.5, center_y = 0.0, scale = 4.0;
+    const char *checkpoint = NULL, *mapped = NULL, *save_iter = NULL, *recolor = NULL;
+    const char *dzi = NULL;
+    int resume = 0, stream = 0;
+    int palette = PALETTE_DEFAULT, equalize = 0, level = -1;
+    int output = OUTPUT_RGB, format = IMAGE_PNG, perf = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--checkpoint") == 0 && i + 1 < argc) {
+            checkpoint = argv[++i];
+        } else if (strcmp(argv[i], "--resume") == 0 && i + 1 < argc) {
+            checkpoint = argv[++i];
+            resume = 1;
+        } else if (strcmp(argv[i], "--palette") == 0 && i + 1 < argc && palette_from_name(argv[i + 1]) >= 0) {
+            palette = palette_from_name(argv[++i]);
+        } else if (strcmp(argv[i], "--equalize") == 0) {
+            equalize = 1;
+        } else if (strcmp(argv[i], "--mapped") == 0 && i + 1 < argc) {
+            mapped = argv[++i];
+        } else if (strcmp(argv[i], "--save-iter") == 0 && i + 1 < argc) {
+            save_iter = argv[++i];
+        } else if (strcmp(argv[i], "--recolor") == 0 && i + 1 < argc) {
+            recolor = argv[++i];
+        } else if (strcmp(argv[i], "--dzi") == 0 && i + 1 < argc) {
+            dzi = argv[++i];
+        } else if (strcmp(argv[i], "--stream") == 0) {
+            stream = 1;
+        } else if (strcmp(argv[i], "--level") == 0 && i + 1 < argc) {
+            level = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--format") == 0 && i + 1 < argc && image_format_from_name(argv[i + 1]) >= 0) {
+            format = image_format_from_name(argv[++i]);
+        } else if (strcmp(argv[i], "--metrics") == 0 && i + 1 < argc) {
+            metrics_path = argv[++i];
+        } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            trace_path = argv[++i];
+        } else if (strcmp(argv[i], "--perf") == 0) {
+            perf = 1;
+        } else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            i++;
+            output = strcmp(argv[i], "indexed") == 0 ? OUTPUT_INDEXED
+                   : strcmp(argv[i], "iter16") == 0 ? OUTPUT_ITER16 : OUTPUT_RGB;
+        } else {
+            fprintf(stderr, "Usage: %s [--checkpoint FILE | --resume FILE | --stream | --mapped FILE.ppm | --dzi FILE.dzi]\n"
+                            "       [--save-iter FILE.mbi | --recolor FILE.mbi] [--palette NAME] [--equalize] [--level 0-9]\n"
+                            "       [--output rgb|indexed|iter16] [--format png|qoi|ppm|pam|bmp|tga|jpg]\n"
+                            "       [--metrics FILE.prom] [--trace FILE.json] [--perf]\n"
+                            "Palettes: default classic gray fire ocean\n", argv[0]);
+            return 1;
+        }
+    }
+    if (trace_path && !trace_start(TRACE_DEFAULT_EVENTS)) {
+        fprintf(stderr, "Cannot allocate the trace buffer\n");
+        return 1;
+    }
+    atexit(write_metrics);
+
+    if (recolor) {
+        // Recolor archived iteration counts without rendering
+        FractalView view;
+        double start = omp_get_wtime();
+        uint32_t *iters = iterfile_load(recolor, &width, &height, &view);
+        if (!iters) {
+            fprintf(stderr, "Cannot read iteration file %s\n", recolor);
+            return 1;
+        }
+        printf("Loaded %dx%d iterations (max_iter %d) in %.3f seconds\n",
+               width, height, view.max_iter, omp_get_wtime() - start);
+
+        start = omp_get_wtime();
+        size_t count = (size_t)width * height;
+        int pal = palette_resolve(palette != PALETTE_DEFAULT ? palette : view.palette, view.julia);
+        uint32_t *eq = equalize ? palette_lut_equalized(pal, iters, count, view.max_iter) : NULL;
+        unsigned char *image = malloc(count * 3);
+        const uint32_t *lut = eq ? eq : equalize ? NULL : palette_lut(pal, view.max_iter);
+        int ok = image && lut;
+        if (ok) {
+            colorize(image, iters, count, lut);
+            printf("Recolored (%s) in %.3f seconds\n", palette_name(pal), omp_get_wtime() - start);
+            ok = save_result(image, width, height, format, level);
+        }
+        if (!eq) palette_lut_release(lut);
+        free(eq);
+        free(image);
+        free(iters);
+        return ok ? 0 : 1;
+    }
+
+    if (resume) {
+        FractalView view;
+        if (!checkpoint_read_params(checkpoint, &width, &height, &view)) {
+            fprintf(stderr, "Cannot read checkpoint %s\n", checkpoint);
+            return 1;
+        }
+        printf("Resuming %dx%d render, max_iter %d\n", width, height, view.max_iter);
+        unsigned char *image = malloc((size_t)width * height * 3);
+        int ok = image && run_checkpointed(image, width, height, &view, checkpoint, 1)
+                 && save_result(image, width, height, format, level);
+        if (ok) remove(checkpoint);
+        free(image);
+        return ok ? 0 : 1;
+    }
 
     printf("Width: "); 
     scanf("%d", &width);
     printf("Height: "); 
     scanf("%d", &height);
+    printf("Max iterations (0 = auto): ");
+    scanf("%d", &max_iter);
+
+    AutoIter auto_info;
+    int auto_iter = max_iter <= 0;
+    if (auto_iter) {
+        max_iter = auto_max_iter(width, height, center_x, center_y, scale,
+                                 0, 0.0, 0.0, AUTO_ITER_FIXED, &auto_info);
+        printf("Auto max_iter: %d (depth estimate %d, probe ceiling %d, interior %.1f%%)\n",
+               max_iter, auto_info.depth_iter, auto_info.probe_iter,
+               auto_info.interior_ratio * 100.0);
+    }
+
+    if (output != OUTPUT_RGB) {
+        // Kernels write 1-byte indices or 2-byte counts directly, no RGB frame
+        FractalView view = { max_iter, center_x, center_y, scale, 0, 0.0, 0.0, palette };
+        size_t bytes = (size_t)width * height * output_pixel_bytes(output);
+        void *frame = malloc(bytes);
+        if (!frame) return 1;
+        printf("\nGenerating (parallel, %s)...\n", output == OUTPUT_INDEXED ? "indexed" : "iter16");
+        double start = omp_get_wtime();
+        generate_output_parallel(frame, width, height, &view, output);
+        printf("Parallel done in %.3f seconds (frame %.1f MB, RGB would be %.1f MB)\n",
+               omp_get_wtime() - start, bytes / 1048576.0, (size_t)width * height * 3 / 1048576.0);
+
+        char path[512];
+        prompt_path(path, sizeof(path), "png");
+        int ok = output == OUTPUT_INDEXED
+            ? save_png_indexed(path, frame, width, height, palette_resolve(palette, 0), level)
+            : save_png_iter16(path, frame, width, height, level);
+        printf(ok ? "Saved to %s\n" : "Failed to save %s\n", path);
+        free(frame);
+        return ok ? 0 : 1;
+    }
+
+    if (save_iter) {
+        // Keep the raw escape counts so the frame can be recolored later
+        FractalView view = { max_iter, center_x, center_y, scale, 0, 0.0, 0.0, palette };
+        size_t raw = (size_t)width * height * sizeof(uint32_t);
+        uint32_t *iters = malloc(raw);
+        if (!iters) return 1;
+        printf("\nGenerating (parallel, iteration counts)...\n");
+        double start = omp_get_wtime();
+        generate_iter_parallel(iters, width, height, &view);
+        printf("Parallel done in %.3f seconds\n", omp_get_wtime() - start);
+
+        start = omp_get_wtime();
+        int ok = iterfile_save(save_iter, iters, width, height, &view);
+        free(iters);
+        if (!ok) {
+            fprintf(stderr, "Failed to save %s\n", save_iter);
+            return 1;
+        }
+        FILE *f = fopen(save_iter, "rb");
+        long size = -1;
+        if (f && fseek(f, 0, SEEK_END) == 0) size = ftell(f);
+        if (f) fclose(f);
+        printf("Encoded in %.3f seconds: %.2f MB (raw %.2f MB, %.1fx smaller)\nSaved to %s\n",
+               omp_get_wtime() - start, size / 1048576.0, raw / 1048576.0,
+               size > 0 ? (double)raw / size : 0.0, save_iter);
+        return 0;
+    }
+
+    if (dzi) {
+        // Deep Zoom pyramid: tiles of every level, lower levels downsampled from the render
+        FractalView view = { max_iter, center_x, center_y, scale, 0, 0.0, 0.0, palette };
+        PyramidInfo info;
+        printf("\nGenerating (parallel, DZI pyramid %s)...\n", dzi);
+        double start = omp_get_wtime();
+        if (!generate_dzi(dzi, width, height, &view, format, level, &info)) {
+            fprintf(stderr, "Pyramid export failed (%s)\n", dzi);
+            return 1;
+        }
+        printf("Render + pyramid done in %.3f seconds (%d levels, %ld tiles)\nSaved to %s\n",
+               omp_get_wtime() - start, info.levels, info.tiles, dzi);
+        return 0;
+    }
 
-    unsigned char *image = malloc(width * height * 3);
+    if (mapped) {
+        // Out-of-core: the frame lives in a file mapping, only one band stays resident
+        FractalView view = { max_iter, center_x, center_y, scale, 0, 0.0, 0.0, palette };
+        printf("\nGenerating (parallel, mapped to %s)...\n", mapped);
+        double start = omp_get_wtime();
+        if (!generate_parallel_mapped(mapped, width, height, &view)) {
+            fprintf(stderr, "Mapped render failed (%s)\n", mapped);
+            return 1;
+        }
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        printf("Parallel done in %.3f seconds\n", omp_get_wtime() - start);
+        printf("Image size %.1f MB, peak resident %.1f MB\nSaved to %s\n",
+               (size_t)width * height * 3 / 1048576.0, usage.ru_maxrss / 1024.0, mapped);
+        return 0;
+    }
+
+    if (stream) {
+        // Bands go straight from the engine into the PNG; the frame never exists in RAM
+        FractalView view = { max_iter, center_x, center_y, scale, 0, 0.0, 0.0, palette };
+        char path[512];
+        prompt_path(path, sizeof(path), "png");
+        printf("\nGenerating (parallel, streamed to %s)...\n", path);
+        double start = omp_get_wtime();
+        if (!generate_png_streamed(path, width, height, &view, level)) {
+            fprintf(stderr, "Failed to save image\n");
+            return 1;
+        }
+        printf("Render + export done in %.3f seconds\nSaved to %s\n", omp_get_wtime() - start, path);
+        return 0;
+    }
+
+    if (checkpoint) {
+        FractalView view = { max_iter, center_x, center_y, scale, 0, 0.0, 0.0, palette };
+        unsigned char *image = malloc((size_t)width * height * 3);
+        int ok = image && run_checkpointed(image, width, height, &view, checkpoint, 0)
+                 && save_result(image, width, height, format, level);
+        if (ok) remove(checkpoint);
+        free(image);
+        return ok ? 0 : 1;
+    }
+
+    unsigned char *image = malloc((size_t)width * height * 3);
     double time_serial, time_parallel, speedup;
+    PerfReport perf_serial, perf_parallel;
+    uint64_t iter_serial = 0, iter_parallel = 0;
+    char why[160];
+    if (perf && !perf_start(why, sizeof(why))) {
+        printf("\nHardware counters unavailable: %s\n", why);
+        perf = 0;
+    }
 
     printf("\nGenerating (serial)...\n");
+    uint64_t iter_before = metrics_counter(METRIC_ITERATIONS);
     double start_serial = omp_get_wtime();
+    uint64_t span = trace_begin();
     generate_serial(image, width, height, max_iter, center_x, center_y, scale);
+    trace_end("frame", span, 0, 0, width, height);
     double end_serial = omp_get_wtime();
     time_serial = end_serial - start_serial;
+    if (perf) {
+        iter_serial = metrics_counter(METRIC_ITERATIONS) - iter_before;
+        perf = perf_stop(&perf_serial) && perf_start(why, sizeof(why));
+    }
+    metrics_observe(METRIC_FRAME_SECONDS, time_serial);
     printf("Serial done in %.3f seconds\n", time_serial);
 
     printf("\nGenerating (parallel)...\n");
+    iter_before = metrics_counter(METRIC_ITERATIONS);
     double start_parallel = omp_get_wtime();
-    generate_parallel(image, width, height, max_iter, center_x, center_y, scale);
+    span = trace_begin();
+    if (palette != PALETTE_DEFAULT || equalize) {
+        FractalView view = { max_iter, center_x, center_y, scale, 0, 0.0, 0.0, palette };
+        generate_palette_parallel(image, width, height, &view, equalize);
+    } else {
+        generate_parallel(image, width, height, max_iter, center_x, center_y, scale);
+    }
+    trace_end("frame", span, 0, 0, width, height);
     double end_parallel = omp_get_wtime();
     time_parallel = end_parallel - start_parallel;
+    if (perf) {
+        iter_parallel = metrics_counter(METRIC_ITERATIONS) - iter_before;
+        perf = perf_stop(&perf_parallel);
+    }
+    metrics_observe(METRIC_FRAME_SECONDS, time_parallel);
     printf("Parallel done in %.3f seconds\n", time_parallel);
 
     speedup = time_serial / time_parallel;
@@ -34,17 +361,26 @@ int main() {
     printf("Serial time:   %.3f seconds\n", time_serial);
     printf("Parallel time: %.3f seconds\n", time_parallel);
     printf("Speedup:       %.2fx (parallel is %.2fx faster)\n", speedup, speedup);
+    // Both passes rendered the same frame, so the counters hold it twice
+    uint64_t pixels = metrics_counter(METRIC_PIXELS);
+    if (pixels > 0)
+        printf("Work:          %.1f iterations/pixel, %.1f%% of pixels escaped, %.0f Miter/s parallel\n",
+               (double)metrics_counter(METRIC_ITERATIONS) / pixels,
+               100.0 * metrics_counter(METRIC_ESCAPED) / pixels,
+               metrics_counter(METRIC_ITERATIONS) / 2.0 / time_parallel / 1e6);
+    if (auto_iter && auto_info.work_auto > 0) {
+        double time_fixed = time_parallel * auto_info.work_fixed / auto_info.work_auto;
+        printf("Max iter:      %d (auto) vs %d (fixed)\n", max_iter, AUTO_ITER_FIXED);
+        printf("Fixed time:    %.3f seconds (estimated, saved %.3f seconds)\n",
+               time_fixed, time_fixed - time_parallel);
+    }
+    if (perf) {
+        // The serial pass ran on this thread alone; the others only waited
+        print_perf("Serial perf:", &perf_serial, &perf_serial.thread[0], iter_serial);
+        print_perf("Parallel perf:", &perf_parallel, &perf_parallel.total, iter_parallel);
+    }
 
-    char filename[256];
-    printf("\nOutput filename (without extension): ");
-    scanf("%s", filename);
-    char path[512];
-    snprintf(path, sizeof(path), "image/%s.png", filename);
-
-    if (save_png(path, image, width, height))
-        printf("Saved to %s\n", path);
-    else
-        fprintf(stderr, "Failed to save image\n");
+    save_result(image, width, height, format, level);
 
     free(image);
     return 0;
@@ -6,6 +6,9 @@
 #include <iostream>
 #include <cmath>
 #include "fractal.h" 
+#include "palette.h"
+#include "image_io.h"
+#include "render_async.h"
 
 #define WINDOW_W 1280
 #define WINDOW_H 720
@@ -17,15 +20,23 @@ struct AppState {
     int width = FRACTAL_W;
     int height = FRACTAL_H;
     int max_iter = 1000;
+    int fixed_iter = AUTO_ITER_FIXED;
+    bool autoIter = false;
+    double work_ratio = 0.0;
     double center_x = -0.5;
     double center_y = 0.0;
     double scale = 3.5;
     double time_serial = 0.0;
     double time_parallel = 0.0;
     double ratio = 0.0;
+    bool asyncRender = false;
+    bool renderFailed = false;
     bool juliaMode = false;
     double c_real = 0.285;
     double c_imag = 0.01;
+    int palette = PALETTE_DEFAULT;
+    bool equalize = false;
+    int format = IMAGE_PNG;
 };
 
 struct InputField {
@@ -67,7 +78,7 @@ int main() {
         imgFull.create(state.width, state.height);
         for (int y = 0; y < state.height; y++) {
             for (int x = 0; x < state.width; x++) {
-                int idx = (y * state.width + x) * 3;
+                size_t idx = ((size_t)y * state.width + x) * 3;
                 imgFull.setPixel(x, y, sf::Color(imgData[idx], imgData[idx+1], imgData[idx+2]));
             }
         }
@@ -80,8 +91,35 @@ int main() {
         fractal_sprite.setPosition(0, 0);
     };
 
+    // Background render for view changes; the buffer belongs to the job
+    // until it is freed, so it is only resized after render_async_free
+    RenderJob *job = nullptr;
+    std::vector<unsigned char> asyncData;
+    sf::Clock asyncClock;
+
+    auto stop_async = [&]() {
+        render_async_free(job);
+        job = nullptr;
+    };
+
+    auto update_max_iter = [&]() {
+        state.max_iter = state.fixed_iter;
+        state.work_ratio = 0.0;
+        if (state.autoIter) {
+            AutoIter info;
+            state.max_iter = auto_max_iter(state.width, state.height, state.center_x, state.center_y, state.scale,
+                                           state.juliaMode, state.c_real, state.c_imag, state.fixed_iter, &info);
+            if (info.work_auto > 0)
+                state.work_ratio = info.work_fixed / info.work_auto;
+        }
+    };
+
     auto regenerate_full = [&](bool saveFull = false, const std::string &saveName = "") {
-        std::vector<unsigned char> imgData(state.width * state.height * 3);
+        stop_async();
+        std::vector<unsigned char> imgData((size_t)state.width * state.height * 3);
+        update_max_iter();
+        state.asyncRender = false;
+        state.renderFailed = false;
 
         // Serial
         {
@@ -95,7 +133,11 @@ int main() {
         // Parallel
         {
             sf::Clock clk;
-            if (!state.juliaMode)
+            if (state.palette != PALETTE_DEFAULT || state.equalize) {
+                FractalView view{state.max_iter, state.center_x, state.center_y, state.scale,
+                                 state.juliaMode, state.c_real, state.c_imag, state.palette};
+                generate_palette_parallel(imgData.data(), state.width, state.height, &view, state.equalize);
+            } else if (!state.juliaMode)
                 generate_parallel(imgData.data(), state.width, state.height, state.max_iter, state.center_x, state.center_y, state.scale);
             else
                 generate_julia_parallel(imgData.data(), state.width, state.height, state.max_iter, state.center_x, state.center_y, state.scale, state.c_real, state.c_imag);
@@ -106,18 +148,47 @@ int main() {
 
         if (saveFull && !saveName.empty()) {
             char path[512];
-            snprintf(path, sizeof(path), "image/%s.png", saveName.c_str());
-            save_png(path, imgData.data(), state.width, state.height);
+            snprintf(path, sizeof(path), "image/%s.%s", saveName.c_str(), image_format_ext(state.format));
+            save_image(path, imgData.data(), state.width, state.height, state.format, -1);
         }
 
         draw_image(imgData);
     };
 
+    // Starts the view in the background and returns at once; the frame loop
+    // shows progress and draws the image when the job is done. Clicking again
+    // cancels the render in flight. Equalized palettes need the whole
+    // frame's histogram first, so they stay on the synchronous path.
+    auto regenerate_async = [&]() {
+        if (state.equalize) {
+            regenerate_full();
+            return;
+        }
+        stop_async();
+        asyncData.assign((size_t)state.width * state.height * 3, 0);
+        update_max_iter();
+        FractalView view{state.max_iter, state.center_x, state.center_y, state.scale,
+                         state.juliaMode, state.c_real, state.c_imag, state.palette};
+        asyncClock.restart();
+        job = render_async_start(asyncData.data(), state.width, state.height, &view, nullptr, nullptr);
+        if (!job) {
+            regenerate_full();
+            return;
+        }
+        state.asyncRender = true;
+        state.renderFailed = false;
+        state.time_parallel = 0.0;
+    };
+
     InputField fieldWidth{{FRACTAL_W + 20, 40, UI_W - 40, 32}, std::to_string(state.width)};
     InputField fieldHeight{{FRACTAL_W + 20, 90, UI_W - 40, 32}, std::to_string(state.height)};
     Button btnGenerate{{FRACTAL_W + 20, 190, UI_W - 40, 40}, "Generate CPU", false, {66,133,244}, {46,92,184}};
     Button btnSave{{FRACTAL_W + 20, 240, UI_W - 40, 40}, "Save", false, {46,204,113}, {36,150,83}};
     Button btnToggle{{FRACTAL_W + 20, 290, UI_W - 40, 40}, "Mode: Mandelbrot", false, {155,89,182}, {115,59,142}};
+    Button btnIter{{FRACTAL_W + 20, 340, UI_W - 40, 40}, "Iter: Fixed", false, {230,126,34}, {180,90,20}};
+    Button btnPalette{{FRACTAL_W + 20, 390, UI_W - 40, 40}, "Palette: default", false, {26,188,156}, {22,140,116}};
+    Button btnEqualize{{FRACTAL_W + 20, 440, UI_W - 40, 40}, "Equalize: Off", false, {127,140,141}, {90,100,101}};
+    Button btnFormat{{FRACTAL_W + 20, 490, UI_W - 40, 40}, "Format: png", false, {52,73,94}, {36,52,68}};
 
     regenerate_full();
 
@@ -155,6 +226,10 @@ int main() {
                 if (btnGenerate.rect.contains(mpos)) btnGenerate.pressed = true;
                 if (btnSave.rect.contains(mpos)) btnSave.pressed = true;
                 if (btnToggle.rect.contains(mpos)) btnToggle.pressed = true;
+                if (btnIter.rect.contains(mpos)) btnIter.pressed = true;
+                if (btnPalette.rect.contains(mpos)) btnPalette.pressed = true;
+                if (btnEqualize.rect.contains(mpos)) btnEqualize.pressed = true;
+                if (btnFormat.rect.contains(mpos)) btnFormat.pressed = true;
             }
 
             if (event.type == sf::Event::MouseButtonReleased) {
@@ -173,8 +248,31 @@ int main() {
                     btnToggle.pressed = false;
                     state.juliaMode = !state.juliaMode;
                     btnToggle.label = std::string("Mode: ") + (state.juliaMode ? "Julia" : "Mandelbrot");
+                    regenerate_async();
+                }
+                if (btnIter.pressed) {
+                    btnIter.pressed = false;
+                    state.autoIter = !state.autoIter;
+                    btnIter.label = std::string("Iter: ") + (state.autoIter ? "Auto" : "Fixed");
+                    regenerate_async();
+                }
+                if (btnPalette.pressed) {
+                    btnPalette.pressed = false;
+                    state.palette = (state.palette + 1) % PALETTE_COUNT;
+                    btnPalette.label = std::string("Palette: ") + palette_name(state.palette);
+                    regenerate_async();
+                }
+                if (btnEqualize.pressed) {
+                    btnEqualize.pressed = false;
+                    state.equalize = !state.equalize;
+                    btnEqualize.label = std::string("Equalize: ") + (state.equalize ? "On" : "Off");
                     regenerate_full();
                 }
+                if (btnFormat.pressed) {
+                    btnFormat.pressed = false;
+                    state.format = (state.format + 1) % IMAGE_FORMAT_COUNT;
+                    btnFormat.label = std::string("Format: ") + image_format_ext(state.format);
+                }
             }
 
             if (event.type == sf::Event::TextEntered) {
@@ -194,6 +292,17 @@ int main() {
             }
         }
 
+        int asyncStatus = job ? render_async_status(job) : RENDER_RUNNING;
+        if (asyncStatus == RENDER_DONE) {
+            state.time_parallel = asyncClock.getElapsedTime().asSeconds();
+            stop_async();
+            draw_image(asyncData);
+        } else if (asyncStatus == RENDER_FAILED) {
+            // Keep the last image rather than the partly drawn one
+            stop_async();
+            state.renderFailed = true;
+        }
+
         window.clear(sf::Color(20,20,20));
         window.draw(fractal_sprite);
 
@@ -230,17 +339,34 @@ int main() {
         drawButton(btnGenerate);
         drawButton(btnSave);
         drawButton(btnToggle);
+        drawButton(btnIter);
+        drawButton(btnPalette);
+        drawButton(btnEqualize);
+        drawButton(btnFormat);
 
         std::ostringstream oss;
-        oss << "Serial: " << std::fixed << std::setprecision(3) << state.time_serial << "s\n"
-            << "Parallel: " << state.time_parallel << "s (" << state.ratio << "x)";
+        oss << std::fixed << std::setprecision(3);
+        if (state.renderFailed)
+            oss << "Render failed: out of memory\n\n";
+        else if (job)
+            oss << "Rendering: " << std::setprecision(0) << render_async_progress(job) * 100.0
+                << "%" << std::setprecision(3) << "\n\n";
+        else if (state.asyncRender)
+            oss << "Background: " << state.time_parallel << "s\n\n";
+        else
+            oss << "Serial: " << state.time_serial << "s\n"
+                << "Parallel: " << state.time_parallel << "s (" << state.ratio << "x)\n";
+        oss << "Max iter: " << state.max_iter;
+        if (state.autoIter && state.work_ratio > 0)
+            oss << " (fixed " << state.fixed_iter << ": ~" << state.time_parallel * state.work_ratio << "s)";
         sf::Text statTxt(oss.str(), font, 14);
         statTxt.setFillColor(sf::Color(200, 200, 200));
-        statTxt.setPosition(FRACTAL_W + 20, btnToggle.rect.top + btnToggle.rect.height + 20);
+        statTxt.setPosition(FRACTAL_W + 20, btnFormat.rect.top + btnFormat.rect.height + 20);
         window.draw(statTxt);
 
         window.display();
     }
+    stop_async();
 }
 
 
@@ -0,0 +1,71 @@
+#include <omp.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "mapped_render.h"
+#include "metrics.h"
+
+static size_t page_floor(size_t off, size_t page) {
+    return off / page * page;
+}
+
+int generate_parallel_mapped(const char *path, int width, int height, const FractalView *view) {
+    char header[64];
+    int header_len = snprintf(header, sizeof(header), "P6\n%d %d\n255\n", width, height);
+    size_t stride = (size_t)width * 3;
+    size_t size = (size_t)header_len + stride * (size_t)height;
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return 0;
+    if (ftruncate(fd, (off_t)size) != 0 || pwrite(fd, header, (size_t)header_len, 0) != header_len) {
+        close(fd);
+        return 0;
+    }
+    unsigned char *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return 0;
+    madvise(map, size, MADV_SEQUENTIAL);
+
+    unsigned char *pixels = map + header_len;
+    int tiles_x = (width + MAPPED_TILE - 1) / MAPPED_TILE;
+    int ok = 1;
+
+    for (int y0 = 0; ok && y0 < height; y0 += MAPPED_TILE) {
+        int th = height - y0 < MAPPED_TILE ? height - y0 : MAPPED_TILE;
+        size_t band_start = (size_t)header_len + (size_t)y0 * stride;
+        size_t band_end = band_start + (size_t)th * stride;
+
+        // Prefetch the next band while this one renders
+        if (band_end < size) {
+            size_t next = page_floor(band_end, page);
+            size_t len = stride * MAPPED_TILE;
+            if (next + len > size) len = size - next;
+            madvise(map + next, len, MADV_WILLNEED);
+        }
+
+        #pragma omp parallel for schedule(dynamic)
+        for (int tx = 0; tx < tiles_x; tx++) {
+            int x0 = tx * MAPPED_TILE;
+            int tw = width - x0 < MAPPED_TILE ? width - x0 : MAPPED_TILE;
+            double start = omp_get_wtime();
+            render_tile(pixels + (size_t)y0 * stride + (size_t)x0 * 3, stride,
+                        width, height, view, x0, y0, tw, th);
+            metrics_tile(omp_get_wtime() - start);
+        }
+
+        // Write the band back and release its pages; the partial page at the
+        // end is shared with the next band and is released with it
+        size_t lo = page_floor(band_start, page);
+        size_t hi = band_end == size ? size : page_floor(band_end, page);
+        if (hi > lo) {
+            ok = msync(map + lo, hi - lo, MS_SYNC) == 0;
+            madvise(map + lo, hi - lo, MADV_DONTNEED);
+        }
+    }
+
+    if (munmap(map, size) != 0) ok = 0;
+    return ok;
+}
@@ -0,0 +1,176 @@
+#include <stdio.h>
+#include <stdarg.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include "metrics.h"
+
+typedef struct {
+    uint64_t counters[METRIC_COUNTER_COUNT];
+    uint64_t buckets[METRIC_HISTOGRAM_COUNT][METRICS_BUCKETS];
+    uint64_t sum_ns[METRIC_HISTOGRAM_COUNT];
+} __attribute__((aligned(64))) MetricsSlot;
+
+// The last slot is shared by threads beyond METRICS_MAX_THREADS
+static MetricsSlot slots[METRICS_MAX_THREADS + 1];
+static int slots_claimed;
+static __thread MetricsSlot *own_slot;
+
+// Private slots of exited threads, reused before new ones are claimed.
+// slot_lock orders the old owner's last stores before the new owner's first.
+static pthread_mutex_t slot_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t slot_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t slot_key;
+static int free_slots[METRICS_MAX_THREADS];
+static int free_count;
+
+static const double bucket_bounds[METRICS_BUCKETS - 1] = {
+    1e-5, 2.5e-5, 5e-5, 1e-4, 2.5e-4, 5e-4, 1e-3, 2.5e-3, 5e-3, 1e-2, 2.5e-2,
+    5e-2, 0.1, 0.25, 0.5, 1.0, 2.5, 5.0, 10.0, 25.0, 50.0
+};
+
+static const struct { const char *name, *help; } counter_info[METRIC_COUNTER_COUNT] = {
+    { "mandelbrot_pixels_total", "Pixels computed by the escape-time kernels" },
+    { "mandelbrot_iterations_total", "Iterations of z -> z^2 + c spent on those pixels" },
+    { "mandelbrot_escaped_pixels_total", "Pixels whose iteration stopped before max_iter" },
+    { "mandelbrot_tiles_total", "Tiles finished by tiled renders" },
+    { "mandelbrot_cache_hits_total", "Tile server cache hits" },
+    { "mandelbrot_cache_misses_total", "Tile server cache misses" },
+};
+
+static const struct { const char *name, *help; } histogram_info[METRIC_HISTOGRAM_COUNT] = {
+    { "mandelbrot_tile_seconds", "Time to render one tile" },
+    { "mandelbrot_frame_seconds", "Time to render one whole frame" },
+    { "mandelbrot_encode_seconds", "Time to encode and write one image" },
+    { "mandelbrot_request_seconds", "Tile server time from request to queued response" },
+};
+
+// Runs at thread exit. The slot keeps its counts, so the next thread adds to
+// them and totals never go down.
+static void release_slot(void *slot) {
+    pthread_mutex_lock(&slot_lock);
+    free_slots[free_count++] = (int)((MetricsSlot *)slot - slots);
+    pthread_mutex_unlock(&slot_lock);
+}
+
+static void make_slot_key(void) {
+    pthread_key_create(&slot_key, release_slot);
+}
+
+static MetricsSlot *claim_slot(void) {
+    if (!own_slot) {
+        pthread_once(&slot_key_once, make_slot_key);
+        pthread_mutex_lock(&slot_lock);
+        int i = METRICS_MAX_THREADS;
+        if (free_count > 0) {
+            i = free_slots[--free_count];
+        } else if (slots_claimed < METRICS_MAX_THREADS) {
+            i = slots_claimed;
+            __atomic_store_n(&slots_claimed, i + 1, __ATOMIC_RELAXED);
+        } else {
+            __atomic_store_n(&slots_claimed, METRICS_MAX_THREADS + 1, __ATOMIC_RELAXED);
+        }
+        pthread_mutex_unlock(&slot_lock);
+        own_slot = &slots[i];
+        if (i < METRICS_MAX_THREADS) pthread_setspecific(slot_key, own_slot);
+    }
+    return own_slot;
+}
+
+// A private slot has one writer, so a relaxed load and store is enough;
+// the shared overflow slot needs a real atomic add
+static inline void bump(MetricsSlot *s, uint64_t *field, uint64_t value) {
+    if (s == &slots[METRICS_MAX_THREADS])
+        __atomic_fetch_add(field, value, __ATOMIC_RELAXED);
+    else
+        __atomic_store_n(field, __atomic_load_n(field, __ATOMIC_RELAXED) + value, __ATOMIC_RELAXED);
+}
+
+void metrics_add(int counter, uint64_t value) {
+    MetricsSlot *s = claim_slot();
+    bump(s, &s->counters[counter], value);
+}
+
+void metrics_observe(int histogram, double seconds) {
+    MetricsSlot *s = claim_slot();
+    int b = 0;
+    while (b < METRICS_BUCKETS - 1 && seconds > bucket_bounds[b]) b++;
+    bump(s, &s->buckets[histogram][b], 1);
+    bump(s, &s->sum_ns[histogram], seconds > 0.0 ? (uint64_t)(seconds * 1e9) : 0);
+}
+
+void metrics_tile(double seconds) {
+    metrics_add(METRIC_TILES, 1);
+    metrics_observe(METRIC_TILE_SECONDS, seconds);
+}
+
+static int slots_in_use(void) {
+    return __atomic_load_n(&slots_claimed, __ATOMIC_RELAXED);
+}
+
+uint64_t metrics_counter(int counter) {
+    uint64_t total = 0;
+    for (int i = 0, n = slots_in_use(); i < n; i++)
+        total += __atomic_load_n(&slots[i].counters[counter], __ATOMIC_RELAXED);
+    return total;
+}
+
+typedef struct {
+    char *buf;
+    size_t size, len;
+} Text;
+
+static void append(Text *t, const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    size_t room = t->len < t->size ? t->size - t->len : 0;
+    int n = vsnprintf(room ? t->buf + t->len : NULL, room, fmt, ap);
+    va_end(ap);
+    if (n > 0) t->len += (size_t)n;
+}
+
+size_t metrics_format(char *buf, size_t size) {
+    Text t = { buf, size, 0 };
+    if (size) buf[0] = '\0';
+    int n = slots_in_use();
+
+    for (int c = 0; c < METRIC_COUNTER_COUNT; c++) {
+        append(&t, "# HELP %s %s\n# TYPE %s counter\n%s %llu\n", counter_info[c].name, counter_info[c].help,
+               counter_info[c].name, counter_info[c].name, (unsigned long long)metrics_counter(c));
+    }
+    for (int h = 0; h < METRIC_HISTOGRAM_COUNT; h++) {
+        const char *name = histogram_info[h].name;
+        append(&t, "# HELP %s %s\n# TYPE %s histogram\n", name, histogram_info[h].help, name);
+        uint64_t cumulative = 0, sum_ns = 0;
+        for (int i = 0; i < n; i++) sum_ns += __atomic_load_n(&slots[i].sum_ns[h], __ATOMIC_RELAXED);
+        for (int b = 0; b < METRICS_BUCKETS; b++) {
+            for (int i = 0; i < n; i++) cumulative += __atomic_load_n(&slots[i].buckets[h][b], __ATOMIC_RELAXED);
+            if (b < METRICS_BUCKETS - 1)
+                append(&t, "%s_bucket{le=\"%g\"} %llu\n", name, bucket_bounds[b], (unsigned long long)cumulative);
+            else
+                append(&t, "%s_bucket{le=\"+Inf\"} %llu\n", name, (unsigned long long)cumulative);
+        }
+        append(&t, "%s_sum %.9f\n%s_count %llu\n", name, sum_ns / 1e9, name, (unsigned long long)cumulative);
+    }
+    return t.len;
+}
+
+int metrics_write(const char *path) {
+    // Counters may grow between sizing and formatting: leave room, and
+    // write what fit
+    size_t cap = metrics_format(NULL, 0) + 1024;
+    char *text = malloc(cap);
+    if (!text) return 0;
+    metrics_format(text, cap);
+    size_t len = strlen(text);
+
+    char tmp[4096];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE *f = fopen(tmp, "w");
+    int ok = f && fwrite(text, 1, len, f) == len;
+    if (f && fclose(f) != 0) ok = 0;
+    free(text);
+    if (ok && rename(tmp, path) != 0) ok = 0;
+    if (!ok) remove(tmp);
+    return ok;
+}
@@ -0,0 +1,153 @@
+#include <omp.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "miim.h"
+#include "palette.h"
+
+typedef struct {
+    double x, y;
+    int depth;
+} MiimNode;
+
+typedef struct {
+    int width, height;
+    double x_min, y_min, x_unit, y_unit;      // z -> frame pixel
+    double radius, coarse_unit;               // z -> coarse cell over [-radius, radius]^2
+    uint64_t *frame_bits, *coarse_bits;
+    unsigned char *image;
+    uint32_t ink;                             // boundary color
+    int max_depth;
+} MiimFrame;
+
+// Principal square root of z - c; the other preimage is its negation
+static inline void preimage(double zx, double zy, double cx, double cy, double *rx, double *ry) {
+    double a = zx - cx, b = zy - cy;
+    double r = sqrt(a * a + b * b);
+    *rx = sqrt(0.5 * (r + a));
+    *ry = copysign(sqrt(0.5 * (r - a)), b);
+}
+
+// 1 if the bit was already set; the plain load skips the atomic for the
+// common case of a pixel marked long ago
+static inline int test_and_set(uint64_t *bits, size_t i) {
+    uint64_t mask = (uint64_t)1 << (i & 63);
+    if (__atomic_load_n(&bits[i >> 6], __ATOMIC_RELAXED) & mask) return 1;
+    return (__atomic_fetch_or(&bits[i >> 6], mask, __ATOMIC_RELAXED) & mask) != 0;
+}
+
+// Marks z; returns 0 if it was marked before (prune), 1 for a new coarse
+// cell off the frame and 2 for a new frame pixel, which is colored here
+static int visit(const MiimFrame *f, double x, double y) {
+    double fx = (x - f->x_min) * f->x_unit, fy = (y - f->y_min) * f->y_unit;
+    if (fx >= 0.0 && fy >= 0.0 && fx < f->width && fy < f->height) {
+        size_t i = (size_t)fy * f->width + (size_t)fx;
+        if (test_and_set(f->frame_bits, i)) return 0;
+        f->image[i * 3] = f->ink & 0xFF;
+        f->image[i * 3 + 1] = (f->ink >> 8) & 0xFF;
+        f->image[i * 3 + 2] = (f->ink >> 16) & 0xFF;
+        return 2;
+    }
+    int gx = (int)((x + f->radius) * f->coarse_unit), gy = (int)((y + f->radius) * f->coarse_unit);
+    gx = gx < 0 ? 0 : gx >= MIIM_COARSE ? MIIM_COARSE - 1 : gx;
+    gy = gy < 0 ? 0 : gy >= MIIM_COARSE ? MIIM_COARSE - 1 : gy;
+    return !test_and_set(f->coarse_bits, (size_t)gy * MIIM_COARSE + gx);
+}
+
+int generate_julia_miim(unsigned char *image, int width, int height, const FractalView *view,
+                        MiimStats *stats) {
+    memset(stats, 0, sizeof(*stats));
+    if (width <= 0 || height <= 0 || view->max_iter <= 0) return 0;
+    double cx = view->c_real, cy = view->c_imag;
+    size_t pixels = (size_t)width * height;
+    double aspect = (double)width / height;
+
+    MiimFrame f;
+    f.width = width;
+    f.height = height;
+    f.x_min = view->center_x - view->scale / 2.0;
+    f.y_min = view->center_y - (view->scale / aspect) / 2.0;
+    f.x_unit = width / view->scale;
+    f.y_unit = height / (view->scale / aspect);
+    // Every preimage stays inside the escape radius
+    f.radius = fmax(2.0, sqrt(cx * cx + cy * cy));
+    f.coarse_unit = MIIM_COARSE / (2.0 * f.radius);
+    f.frame_bits = calloc((pixels + 63) / 64, sizeof(uint64_t));
+    f.coarse_bits = calloc((size_t)MIIM_COARSE * MIIM_COARSE / 64, sizeof(uint64_t));
+    f.image = image;
+    f.max_depth = view->max_iter;
+    // Boundary pixels take the color escape time gives the slowest escapes,
+    // everything else the color of points that escape at once
+    const uint32_t *lut = palette_lut(palette_resolve(view->palette, 1), view->max_iter);
+    f.ink = lut ? lut[view->max_iter - 1] : 0;
+    uint32_t bg = lut ? lut[0] : 0;
+    palette_lut_release(lut);
+    size_t branches = (size_t)1 << MIIM_SPLIT;
+    MiimNode *roots = malloc(branches * sizeof(MiimNode));
+    if (!lut || !f.frame_bits || !f.coarse_bits || !roots) {
+        free(f.frame_bits);
+        free(f.coarse_bits);
+        free(roots);
+        return 0;
+    }
+
+    #pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < pixels; i++) {
+        image[i * 3] = bg & 0xFF;
+        image[i * 3 + 1] = (bg >> 8) & 0xFF;
+        image[i * 3 + 2] = (bg >> 16) & 0xFF;
+    }
+
+    // Repelling fixed point z = 1/2 + sqrt(1/4 - c), then the first
+    // MIIM_SPLIT levels of preimages breadth first, without pruning
+    double sx, sy;
+    preimage(0.25, 0.0, cx, cy, &sx, &sy);
+    roots[0] = (MiimNode){ 0.5 + sx, sy, 0 };
+    size_t count = 1;
+    for (int level = 0; level < MIIM_SPLIT; level++) {
+        for (size_t i = count; i-- > 0;) {
+            double px, py;
+            preimage(roots[i].x, roots[i].y, cx, cy, &px, &py);
+            roots[2 * i] = (MiimNode){ px, py, level + 1 };
+            roots[2 * i + 1] = (MiimNode){ -px, -py, level + 1 };
+        }
+        count *= 2;
+    }
+
+    uint64_t points = count, lit = 0;
+    int deepest = MIIM_SPLIT, failed = 0;
+    #pragma omp parallel reduction(+:points, lit, failed) reduction(max:deepest)
+    {
+        // Depth first: each pop pushes at most two, so depth + 2 entries suffice
+        MiimNode *stack = malloc(((size_t)f.max_depth + 2) * sizeof(MiimNode));
+        if (!stack) failed = 1;
+        #pragma omp for schedule(dynamic)
+        for (size_t b = 0; b < branches; b++) {
+            if (!stack) continue;
+            int top = 0;
+            stack[top++] = roots[b];
+            while (top > 0) {
+                MiimNode n = stack[--top];
+                int seen = visit(&f, n.x, n.y);
+                if (!seen) continue;
+                lit += seen == 2;
+                if (n.depth > deepest) deepest = n.depth;
+                if (n.depth >= f.max_depth) continue;
+                double px, py;
+                preimage(n.x, n.y, cx, cy, &px, &py);
+                stack[top++] = (MiimNode){ px, py, n.depth + 1 };
+                stack[top++] = (MiimNode){ -px, -py, n.depth + 1 };
+                points += 2;
+            }
+        }
+        free(stack);
+    }
+
+    free(roots);
+    free(f.frame_bits);
+    free(f.coarse_bits);
+    stats->points = points;
+    stats->pixels = lit;
+    stats->depth = deepest;
+    return !failed;
+}
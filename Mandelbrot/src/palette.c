@@ -0,0 +1,331 @@
+#include <omp.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+#include "palette.h"
+#include "trace.h"
+
+typedef struct PaletteCache {
+    int palette, max_iter;
+    uint32_t *lut;
+    int refs;                  // palette_lut calls not yet released
+    uint64_t used;             // cache_clock at the last lookup
+    struct PaletteCache *next;
+} PaletteCache;
+
+// Guarded by the palette_cache critical section. Tables still referenced are
+// never freed, so the list can exceed PALETTE_CACHE_ENTRIES by the number of
+// tables in use at once.
+static PaletteCache *palette_cache = NULL;
+static int cache_entries = 0;
+static size_t cache_bytes = 0;     // table bytes of every cached entry, held or not
+static uint64_t cache_clock = 0;
+
+static const char *palette_names[PALETTE_COUNT] = {
+    "default", "classic", "gray", "fire", "ocean"
+};
+
+const char *palette_name(int palette) {
+    return palette >= 0 && palette < PALETTE_COUNT ? palette_names[palette] : "unknown";
+}
+
+int palette_from_name(const char *name) {
+    for (int i = 0; i < PALETTE_COUNT; i++)
+        if (strcmp(name, palette_names[i]) == 0) return i;
+    return -1;
+}
+
+int palette_resolve(int palette, int julia) {
+    if (palette <= PALETTE_DEFAULT || palette >= PALETTE_COUNT)
+        return julia ? PALETTE_GRAY : PALETTE_CLASSIC;
+    return palette;
+}
+
+static inline uint32_t pack_rgb(int r, int g, int b) {
+    return (uint32_t)(r & 0xFF) | (uint32_t)(g & 0xFF) << 8 | (uint32_t)(b & 0xFF) << 16;
+}
+
+// Linear blend between gradient stops spaced evenly over [0, 1]
+static uint32_t gradient(const unsigned char (*stops)[3], int n, double t) {
+    double pos = t * (n - 1);
+    int i = (int)pos;
+    if (i >= n - 1) return pack_rgb(stops[n-1][0], stops[n-1][1], stops[n-1][2]);
+    double f = pos - i;
+    return pack_rgb((int)(stops[i][0] + f * (stops[i+1][0] - stops[i][0])),
+                    (int)(stops[i][1] + f * (stops[i+1][1] - stops[i][1])),
+                    (int)(stops[i][2] + f * (stops[i+1][2] - stops[i][2])));
+}
+
+static const unsigned char fire_stops[][3] = {
+    {0, 0, 0}, {128, 0, 0}, {230, 60, 0}, {255, 180, 20}, {255, 255, 200}
+};
+static const unsigned char ocean_stops[][3] = {
+    {0, 7, 30}, {0, 60, 120}, {20, 140, 190}, {120, 220, 230}, {255, 255, 255}
+};
+
+// Color at position num/den along the palette. Gray keeps the Julia
+// engines' original brightest-interior look; the others paint it black.
+static uint32_t palette_eval(int palette, double num, double den, int interior) {
+    double t = interior ? 1.0 : num / den;
+    switch (palette) {
+    case PALETTE_GRAY: {
+        int c = interior ? 255 : (int)(255.0 * num / den);
+        return pack_rgb(c, c, c);
+    }
+    case PALETTE_FIRE:
+        return interior ? 0 : gradient(fire_stops, 5, t);
+    case PALETTE_OCEAN:
+        return interior ? 0 : gradient(ocean_stops, 5, t);
+    default:
+        if (interior) return 0;
+        return pack_rgb((int)(9*(1-t)*t*t*t*255),
+                        (int)(15*(1-t)*(1-t)*t*t*255),
+                        (int)(8.5*(1-t)*(1-t)*(1-t)*t*255));
+    }
+}
+
+static size_t lut_bytes(int max_iter) {
+    return ((size_t)max_iter + 1) * sizeof(uint32_t);
+}
+
+uint32_t *palette_lut_build(int palette, int max_iter) {
+    uint32_t *lut = malloc(lut_bytes(max_iter));
+    if (!lut) return NULL;
+    for (int i = 0; i <= max_iter; i++)
+        lut[i] = palette_eval(palette, i, max_iter, i == max_iter);
+    return lut;
+}
+
+// Frees least recently used unreferenced tables until the cache is within
+// both bounds. Called inside the palette_cache critical section.
+static void cache_evict(void) {
+    while (cache_entries > PALETTE_CACHE_ENTRIES || cache_bytes > PALETTE_CACHE_BYTES) {
+        PaletteCache **victim = NULL;
+        for (PaletteCache **e = &palette_cache; *e; e = &(*e)->next)
+            if ((*e)->refs == 0 && (!victim || (*e)->used < (*victim)->used)) victim = e;
+        if (!victim) return;
+        PaletteCache *dead = *victim;
+        *victim = dead->next;
+        cache_bytes -= lut_bytes(dead->max_iter);
+        free(dead->lut);
+        free(dead);
+        cache_entries--;
+    }
+}
+
+const uint32_t *palette_lut(int palette, int max_iter) {
+    PaletteCache *found = NULL;
+    #pragma omp critical(palette_cache)
+    {
+        for (PaletteCache *e = palette_cache; e && !found; e = e->next)
+            if (e->palette == palette && e->max_iter == max_iter) found = e;
+        if (found) {
+            found->refs++;
+            found->used = ++cache_clock;
+        }
+    }
+    if (found) return found->lut;
+
+    // Built outside the lock: a large table takes a while, and other
+    // lookups should not wait for it
+    PaletteCache *e = malloc(sizeof(PaletteCache));
+    uint32_t *lut = e ? palette_lut_build(palette, max_iter) : NULL;
+    if (!lut) {
+        free(e);
+        return NULL;
+    }
+    e->palette = palette;
+    e->max_iter = max_iter;
+    e->lut = lut;
+    e->refs = 1;
+
+    #pragma omp critical(palette_cache)
+    {
+        // Another thread may have built the same table meanwhile; keep theirs
+        for (PaletteCache *o = palette_cache; o && !found; o = o->next)
+            if (o->palette == palette && o->max_iter == max_iter) found = o;
+        if (found) {
+            found->refs++;
+            found->used = ++cache_clock;
+        } else {
+            e->used = ++cache_clock;
+            e->next = palette_cache;
+            palette_cache = e;
+            cache_entries++;
+            cache_bytes += lut_bytes(max_iter);
+            cache_evict();
+        }
+    }
+    if (!found) return lut;
+    free(lut);
+    free(e);
+    return found->lut;
+}
+
+void palette_lut_release(const uint32_t *lut) {
+    if (!lut) return;
+    #pragma omp critical(palette_cache)
+    {
+        for (PaletteCache *e = palette_cache; e; e = e->next) {
+            if (e->lut == lut && e->refs > 0) {
+                e->refs--;
+                break;
+            }
+        }
+        cache_evict();
+    }
+}
+
+size_t palette_cache_bytes(void) {
+    size_t bytes;
+    #pragma omp critical(palette_cache)
+    bytes = cache_bytes;
+    return bytes;
+}
+
+void palette_plte(int palette, unsigned char plte[256 * 3]) {
+    for (int k = 0; k < 256; k++) {
+        uint32_t c = palette_eval(palette, k, 255, k == 255);
+        plte[k * 3] = c & 0xFF;
+        plte[k * 3 + 1] = (c >> 8) & 0xFF;
+        plte[k * 3 + 2] = (c >> 16) & 0xFF;
+    }
+}
+
+uint32_t *palette_lut_equalized(int palette, const uint32_t *iters, size_t count, int max_iter) {
+    size_t bins = (size_t)max_iter + 1;
+    int threads = omp_get_max_threads();
+    uint32_t *hist = calloc(bins * threads, sizeof(uint32_t));
+    uint32_t *lut = malloc(bins * sizeof(uint32_t));
+    if (!hist || !lut) {
+        free(hist);
+        free(lut);
+        return NULL;
+    }
+
+    // Private histogram per thread, no atomics in the counting loop
+    #pragma omp parallel num_threads(threads)
+    {
+        uint32_t *local = hist + bins * omp_get_thread_num();
+        #pragma omp for schedule(static)
+        for (size_t i = 0; i < count; i++)
+            local[iters[i] < (uint32_t)max_iter ? iters[i] : (uint32_t)max_iter]++;
+    }
+
+    // Merge by bin so each thread owns a contiguous slice of the result
+    #pragma omp parallel for schedule(static)
+    for (size_t b = 0; b < bins; b++) {
+        uint32_t sum = hist[b];
+        for (int t = 1; t < threads; t++) sum += hist[bins * t + b];
+        hist[b] = sum;
+    }
+
+    // Only escaped pixels take part; the interior keeps its own color
+    double escaped = (double)(count - hist[max_iter]);
+    double cdf = 0.0;
+    for (int i = 0; i < max_iter; i++) {
+        cdf += hist[i];
+        lut[i] = palette_eval(palette, cdf, escaped > 0 ? escaped : 1.0, 0);
+    }
+    lut[max_iter] = palette_eval(palette, 1.0, 1.0, 1);
+
+    free(hist);
+    return lut;
+}
+
+// Pixels per OpenMP work item: large enough that dispatch is noise, small
+// enough to balance over threads
+#define COLORIZE_BLOCK 4096
+
+static void colorize_pixels(unsigned char *rgb, const uint32_t *iters, size_t n, const uint32_t *lut) {
+    size_t groups = n / 4;
+    for (size_t g = 0; g < groups; g++) {
+        const uint32_t *it = iters + g * 4;
+        uint32_t c0 = lut[it[0]], c1 = lut[it[1]], c2 = lut[it[2]], c3 = lut[it[3]];
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        // Four RGB pixels are exactly three 32-bit words: pack and store them whole
+        uint32_t w[3] = { c0 | c1 << 24, c1 >> 8 | c2 << 16, c2 >> 16 | c3 << 8 };
+        memcpy(rgb + g * 12, w, sizeof(w));
+#else
+        uint32_t c[4] = { c0, c1, c2, c3 };
+        for (int k = 0; k < 4; k++) {
+            rgb[g * 12 + k * 3] = c[k] & 0xFF;
+            rgb[g * 12 + k * 3 + 1] = (c[k] >> 8) & 0xFF;
+            rgb[g * 12 + k * 3 + 2] = (c[k] >> 16) & 0xFF;
+        }
+#endif
+    }
+    for (size_t i = groups * 4; i < n; i++) {
+        uint32_t c = lut[iters[i]];
+        rgb[i * 3] = c & 0xFF;
+        rgb[i * 3 + 1] = (c >> 8) & 0xFF;
+        rgb[i * 3 + 2] = (c >> 16) & 0xFF;
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+// Eight pixels per step: one AVX2 gather loads their colors from the LUT and
+// a byte shuffle drops each color's unused top byte, leaving 24 bytes of RGB.
+// Iteration counts fit the gather's signed 32-bit indices since max_iter is an int.
+__attribute__((target("avx2")))
+static void colorize_pixels_avx2(unsigned char *rgb, const uint32_t *iters, size_t n, const uint32_t *lut) {
+    const __m256i pack = _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+                                          0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i idx = _mm256_loadu_si256((const __m256i *)(iters + i));
+        __m256i rgbx = _mm256_shuffle_epi8(_mm256_i32gather_epi32((const int *)lut, idx, 4), pack);
+        __m128i high = _mm256_extracti128_si256(rgbx, 1);
+        _mm_storeu_si128((__m128i *)(rgb + i * 3), _mm256_castsi256_si128(rgbx));
+        memcpy(rgb + i * 3 + 12, &high, 12);  // the low lane's 4 spare bytes are overwritten here
+    }
+    colorize_pixels(rgb + i * 3, iters + i, n - i, lut);
+}
+#endif
+
+void colorize(unsigned char *rgb, const uint32_t *iters, size_t count, const uint32_t *lut) {
+    void (*pixels)(unsigned char *, const uint32_t *, size_t, const uint32_t *) = colorize_pixels;
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) pixels = colorize_pixels_avx2;
+#endif
+    size_t blocks = (count + COLORIZE_BLOCK - 1) / COLORIZE_BLOCK;
+
+    #pragma omp parallel
+    {
+        uint64_t span = trace_begin();
+        #pragma omp for schedule(static) nowait
+        for (size_t b = 0; b < blocks; b++) {
+            size_t first = b * COLORIZE_BLOCK;
+            size_t n = count - first < COLORIZE_BLOCK ? count - first : COLORIZE_BLOCK;
+            pixels(rgb + first * 3, iters + first, n, lut);
+        }
+        trace_end("colorize", span, 0, 0, 0, 0);
+    }
+}
+
+int generate_palette_parallel(unsigned char *image, int width, int height,
+                              const FractalView *view, int equalize)
+{
+    size_t count = (size_t)width * height;
+    uint32_t *iters = malloc(count * sizeof(uint32_t));
+    if (!iters) return 0;
+
+    generate_iter_parallel(iters, width, height, view);
+
+    int palette = palette_resolve(view->palette, view->julia);
+    uint32_t *eq = equalize ? palette_lut_equalized(palette, iters, count, view->max_iter) : NULL;
+    if (equalize && !eq) {
+        free(iters);
+        return 0;
+    }
+    const uint32_t *lut = eq ? eq : palette_lut(palette, view->max_iter);
+    if (lut) colorize(image, iters, count, lut);
+    if (!eq) palette_lut_release(lut);
+
+    free(eq);
+    free(iters);
+    return lut != NULL;
+}
@@ -0,0 +1,128 @@
+#include <omp.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "perfcount.h"
+
+static __thread int fds[PERF_COUNTER_COUNT];
+static __thread int opened;
+static int open_threads;
+static int open_counts[PERF_COUNTER_COUNT];
+
+// Intel FP_ARITH_INST_RETIRED (event 0xC7): umask 0x01 scalar double,
+// 0x04 | 0x10 | 0x40 packed double at 128, 256 and 512 bits
+static int fp_events_supported(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    return __builtin_cpu_is("intel");
+#else
+    return 0;
+#endif
+}
+
+static int open_counter(int counter) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    switch (counter) {
+    case PERF_CYCLES:        attr.type = PERF_TYPE_HARDWARE; attr.config = PERF_COUNT_HW_CPU_CYCLES; break;
+    case PERF_INSTRUCTIONS:  attr.type = PERF_TYPE_HARDWARE; attr.config = PERF_COUNT_HW_INSTRUCTIONS; break;
+    case PERF_BRANCH_MISSES: attr.type = PERF_TYPE_HARDWARE; attr.config = PERF_COUNT_HW_BRANCH_MISSES; break;
+    case PERF_CACHE_MISSES:  attr.type = PERF_TYPE_HARDWARE; attr.config = PERF_COUNT_HW_CACHE_MISSES; break;
+    case PERF_FP_SCALAR:     attr.type = PERF_TYPE_RAW; attr.config = 0x01C7; break;
+    default:                 attr.type = PERF_TYPE_RAW; attr.config = 0x54C7; break;
+    }
+    // pid 0, cpu -1: this thread only, on whichever CPU it runs
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static void close_own(void) {
+    if (!opened) return;
+    for (int c = 0; c < PERF_COUNTER_COUNT; c++) {
+        if (fds[c] >= 0) close(fds[c]);
+        fds[c] = -1;
+    }
+    opened = 0;
+}
+
+int perf_start(char *why, int why_size) {
+    int fp = fp_events_supported(), cycles_errno = 0;
+    open_threads = 0;
+    memset(open_counts, 0, sizeof(open_counts));
+
+    #pragma omp parallel
+    {
+        for (int c = 0; c < PERF_COUNTER_COUNT; c++) {
+            fds[c] = c >= PERF_FP_SCALAR && !fp ? -1 : open_counter(c);
+            if (fds[c] >= 0) {
+                #pragma omp atomic
+                open_counts[c]++;
+            } else if (c == PERF_CYCLES) {
+                #pragma omp atomic write
+                cycles_errno = errno;
+            }
+        }
+        opened = 1;
+        #pragma omp atomic
+        open_threads++;
+    }
+    if (open_counts[PERF_CYCLES] < open_threads) {
+        #pragma omp parallel
+        close_own();
+        snprintf(why, (size_t)why_size, "%s%s", strerror(cycles_errno),
+                 cycles_errno == EACCES || cycles_errno == EPERM
+                     ? " (lower /proc/sys/kernel/perf_event_paranoid or grant CAP_PERFMON)"
+                     : cycles_errno == ENOENT || cycles_errno == ENODEV ? " (no hardware PMU, e.g. inside a VM)" : "");
+        return 0;
+    }
+
+    // Enabled last, so opening the counters is not counted
+    #pragma omp parallel
+    {
+        for (int c = 0; c < PERF_COUNTER_COUNT; c++) {
+            if (fds[c] < 0) continue;
+            ioctl(fds[c], PERF_EVENT_IOC_RESET, 0);
+            ioctl(fds[c], PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+    return 1;
+}
+
+int perf_stop(PerfReport *report) {
+    memset(report, 0, sizeof(*report));
+    int failed = 0, threads = 0;
+
+    #pragma omp parallel reduction(+:failed, threads)
+    {
+        for (int c = 0; c < PERF_COUNTER_COUNT; c++)
+            if (opened && fds[c] >= 0) ioctl(fds[c], PERF_EVENT_IOC_DISABLE, 0);
+        int t = omp_get_thread_num();
+        if (!opened) {
+            failed = 1;
+        } else {
+            threads = 1;
+            for (int c = 0; c < PERF_COUNTER_COUNT; c++) {
+                uint64_t v[3];   // value, time enabled, time running
+                if (fds[c] < 0 || read(fds[c], v, sizeof(v)) != (ssize_t)sizeof(v)) continue;
+                uint64_t scaled = v[2] == 0 ? 0 : v[2] >= v[1] ? v[0]
+                                : (uint64_t)((double)v[0] * v[1] / v[2]);
+                if (t < PERF_MAX_THREADS) report->thread[t].value[c] = scaled;
+                #pragma omp atomic
+                report->total.value[c] += scaled;
+            }
+            close_own();
+        }
+    }
+    report->threads = threads;
+    for (int c = 0; c < PERF_COUNTER_COUNT; c++)
+        report->available[c] = open_threads > 0 && open_counts[c] == open_threads;
+    return !failed && threads == open_threads;
+}
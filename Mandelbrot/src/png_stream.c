@@ -0,0 +1,429 @@
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+#include "png_stream.h"
+#include "palette.h"
+#include "trace.h"
+
+#define DEFLATE_WINDOW 32768
+
+typedef struct {
+    unsigned char *data;
+    size_t size;
+    uLong adler;
+    int ok;
+} DeflateBlock;
+
+struct PngStream {
+    FILE *file;
+    uint32_t width, height, rows_written;
+    size_t row_bytes;
+    int bpp;                 // bytes per complete pixel, for the Sub/Average/Paeth filters
+    int level;
+
+    unsigned char *band;     // unfiltered rows waiting to be encoded, prev row in front
+    uint32_t band_rows, band_used;
+    unsigned char *filtered; // filtered band, one filter byte per row
+    unsigned char *window;   // last DEFLATE_WINDOW filtered bytes of the previous band
+    size_t window_len;
+
+    unsigned char *out;      // pending IDAT payload
+    size_t out_len;
+    uLong adler;
+    int ok;
+};
+
+static void put_u32(unsigned char *p, uint32_t v) {
+    p[0] = (unsigned char)(v >> 24);
+    p[1] = (unsigned char)(v >> 16);
+    p[2] = (unsigned char)(v >> 8);
+    p[3] = (unsigned char)v;
+}
+
+static int write_chunk(FILE *f, const char *type, const unsigned char *data, uint32_t len) {
+    unsigned char hdr[8], crc_buf[4];
+    put_u32(hdr, len);
+    memcpy(hdr + 4, type, 4);
+    uLong crc = crc32(0L, (const Bytef *)type, 4);
+    if (len > 0) crc = crc32(crc, data, len);
+    put_u32(crc_buf, (uint32_t)crc);
+    return fwrite(hdr, 1, 8, f) == 8
+        && (len == 0 || fwrite(data, 1, len, f) == len)
+        && fwrite(crc_buf, 1, 4, f) == 4;
+}
+
+// Appends to the IDAT payload, emitting a chunk each time PNG_STREAM_CHUNK fills
+static int idat_append(PngStream *png, const unsigned char *data, size_t len) {
+    while (len > 0) {
+        size_t n = PNG_STREAM_CHUNK - png->out_len;
+        if (n > len) n = len;
+        memcpy(png->out + png->out_len, data, n);
+        png->out_len += n;
+        data += n;
+        len -= n;
+        if (png->out_len == PNG_STREAM_CHUNK) {
+            if (!write_chunk(png->file, "IDAT", png->out, PNG_STREAM_CHUNK)) return 0;
+            png->out_len = 0;
+        }
+    }
+    return 1;
+}
+
+static inline int paeth(int a, int b, int c) {
+    int p = a + b - c;
+    int pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+    if (pa <= pb && pa <= pc) return a;
+    return pb <= pc ? b : c;
+}
+
+static inline unsigned char filter_byte(int f, const unsigned char *row, const unsigned char *up,
+                                        size_t i, int bpp) {
+    int a = i >= (size_t)bpp ? row[i - bpp] : 0;
+    int b = up[i];
+    int c = i >= (size_t)bpp ? up[i - bpp] : 0;
+    switch (f) {
+    case 0: return row[i];
+    case 1: return (unsigned char)(row[i] - a);
+    case 2: return (unsigned char)(row[i] - b);
+    case 3: return (unsigned char)(row[i] - ((a + b) >> 1));
+    default: return (unsigned char)(row[i] - paeth(a, b, c));
+    }
+}
+
+// Picks the filter with the smallest sum of absolute signed bytes (the
+// libpng heuristic) and writes the filter byte plus filtered row to dst.
+static void filter_row(unsigned char *dst, const unsigned char *row, const unsigned char *up,
+                       size_t n, int bpp) {
+    int best = 0;
+    unsigned long best_sum = 0;
+    for (int f = 0; f < 5; f++) {
+        unsigned long sum = 0;
+        for (size_t i = 0; i < n && (f == 0 || sum < best_sum); i++) {
+            unsigned char v = filter_byte(f, row, up, i, bpp);
+            sum += v < 128 ? v : 256 - v;
+        }
+        if (f == 0 || sum < best_sum) {
+            best = f;
+            best_sum = sum;
+        }
+    }
+    dst[0] = (unsigned char)best;
+    for (size_t i = 0; i < n; i++)
+        dst[i + 1] = filter_byte(best, row, up, i, bpp);
+}
+
+// One independent raw deflate block, primed with the preceding 32 KB so
+// splitting the stream costs almost nothing in ratio (the pigz approach).
+static void deflate_block(DeflateBlock *blk, const unsigned char *data, size_t len,
+                          const unsigned char *dict, size_t dict_len, int level, int last) {
+    z_stream z;
+    memset(&z, 0, sizeof(z));
+    blk->ok = 0;
+    blk->size = 0;
+    blk->adler = adler32(1L, data, (uInt)len);
+    if (deflateInit2(&z, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) return;
+    size_t cap = deflateBound(&z, (uLong)len) + 16;
+    blk->data = malloc(cap);
+    if (blk->data) {
+        if (dict_len > 0) deflateSetDictionary(&z, dict, (uInt)dict_len);
+        z.next_in = (Bytef *)data;
+        z.avail_in = (uInt)len;
+        z.next_out = blk->data;
+        z.avail_out = (uInt)cap;
+        // Non-final blocks end byte-aligned without BFINAL so they concatenate
+        int ret = deflate(&z, last ? Z_FINISH : Z_SYNC_FLUSH);
+        blk->ok = last ? ret == Z_STREAM_END : ret == Z_OK && z.avail_in == 0;
+        blk->size = cap - z.avail_out;
+    }
+    deflateEnd(&z);
+}
+
+// Filters and compresses the buffered band on all cores, then appends the
+// blocks in order and folds their Adler-32 sums into the stream checksum.
+static int encode_band(PngStream *png, int last) {
+    size_t rb = png->row_bytes;
+    uint32_t rows = png->band_used;
+    const unsigned char *first = png->band + rb;
+
+    #pragma omp parallel for schedule(static)
+    for (uint32_t r = 0; r < rows; r++)
+        filter_row(png->filtered + (size_t)r * (rb + 1), first + (size_t)r * rb,
+                   png->band + (size_t)r * rb, rb, png->bpp);
+
+    size_t total = (size_t)rows * (rb + 1);
+    int blocks = (int)((total + PNG_PAR_BLOCK - 1) / PNG_PAR_BLOCK);
+    DeflateBlock *blk = calloc((size_t)blocks, sizeof(DeflateBlock));
+    if (!blk) return 0;
+
+    #pragma omp parallel for schedule(dynamic)
+    for (int b = 0; b < blocks; b++) {
+        size_t start = (size_t)b * PNG_PAR_BLOCK;
+        size_t len = total - start < PNG_PAR_BLOCK ? total - start : PNG_PAR_BLOCK;
+        const unsigned char *dict;
+        size_t dict_len;
+        if (b == 0) {
+            dict = png->window;
+            dict_len = png->window_len;
+        } else {
+            dict_len = start < DEFLATE_WINDOW ? start : DEFLATE_WINDOW;
+            dict = png->filtered + start - dict_len;
+        }
+        uint64_t span = trace_begin();
+        deflate_block(&blk[b], png->filtered + start, len, dict, dict_len,
+                      png->level, last && b == blocks - 1);
+        trace_end("deflate", span, 0, 0, 0, 0);
+    }
+
+    int ok = 1;
+    for (int b = 0; b < blocks; b++) {
+        ok = ok && blk[b].ok && idat_append(png, blk[b].data, blk[b].size);
+        size_t len = total - (size_t)b * PNG_PAR_BLOCK;
+        if (len > PNG_PAR_BLOCK) len = PNG_PAR_BLOCK;
+        png->adler = adler32_combine(png->adler, blk[b].adler, (z_off_t)len);
+        free(blk[b].data);
+    }
+    free(blk);
+
+    // Carry the dictionary window and the last unfiltered row into the next band
+    size_t keep = total < DEFLATE_WINDOW ? total : DEFLATE_WINDOW;
+    if (keep < DEFLATE_WINDOW && png->window_len > 0) {
+        size_t old = png->window_len + keep > DEFLATE_WINDOW ? DEFLATE_WINDOW - keep : png->window_len;
+        memmove(png->window, png->window + png->window_len - old, old);
+        png->window_len = old;
+    } else {
+        png->window_len = 0;
+    }
+    memcpy(png->window + png->window_len, png->filtered + total - keep, keep);
+    png->window_len += keep;
+    memcpy(png->band, png->band + (size_t)rows * rb, rb);
+    png->band_used = 0;
+    return ok;
+}
+
+PngStream *png_stream_open(const char *path, uint32_t width, uint32_t height,
+                           int color_type, int bit_depth, int level)
+{
+    int channels = color_type == PNG_RGB ? 3 : 1;
+    PngStream *png = calloc(1, sizeof(PngStream));
+    if (!png) return NULL;
+    png->width = width;
+    png->height = height;
+    png->level = level;
+    png->row_bytes = ((size_t)width * channels * bit_depth + 7) / 8;
+    png->bpp = (channels * bit_depth + 7) / 8;
+
+    // Enough rows for a few deflate blocks per thread, bounded regardless of height
+    size_t band_bytes = (size_t)omp_get_max_threads() * PNG_PAR_BLOCK * 2;
+    png->band_rows = (uint32_t)(band_bytes / (png->row_bytes + 1));
+    if (png->band_rows < 1) png->band_rows = 1;
+    if (png->band_rows > height) png->band_rows = height;
+
+    png->band = calloc(((size_t)png->band_rows + 1) * png->row_bytes, 1);
+    png->filtered = malloc((size_t)png->band_rows * (png->row_bytes + 1));
+    png->window = malloc(DEFLATE_WINDOW);
+    png->out = malloc(PNG_STREAM_CHUNK);
+    png->adler = adler32(0L, NULL, 0);
+    png->file = fopen(path, "wb");
+    if (!png->band || !png->filtered || !png->window || !png->out || !png->file) {
+        if (png->file) fclose(png->file);
+        free(png->band);
+        free(png->filtered);
+        free(png->window);
+        free(png->out);
+        free(png);
+        return NULL;
+    }
+    setvbuf(png->file, NULL, _IOFBF, 1 << 20);
+
+    static const unsigned char signature[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+    unsigned char ihdr[13];
+    put_u32(ihdr, width);
+    put_u32(ihdr + 4, height);
+    ihdr[8] = (unsigned char)bit_depth;
+    ihdr[9] = (unsigned char)color_type;
+    ihdr[10] = ihdr[11] = ihdr[12] = 0;
+    // zlib header: deflate, 32 KB window, FLEVEL hint, check bits
+    int flevel = level < 0 || level == 6 ? 2 : level < 2 ? 0 : level < 6 ? 1 : 3;
+    unsigned char zhdr[2] = { 0x78, (unsigned char)(flevel << 6) };
+    zhdr[1] |= (unsigned char)((31 - ((zhdr[0] << 8) | zhdr[1]) % 31) % 31);
+    png->ok = fwrite(signature, 1, 8, png->file) == 8
+              && write_chunk(png->file, "IHDR", ihdr, sizeof(ihdr))
+              && idat_append(png, zhdr, 2);
+    return png;
+}
+
+int png_stream_set_palette(PngStream *png, const unsigned char *plte, int entries) {
+    // PLTE must precede IDAT; nothing is flushed to IDAT before the first row
+    if (png->rows_written > 0 || entries < 1 || entries > 256) png->ok = 0;
+    png->ok = png->ok && write_chunk(png->file, "PLTE", plte, (uint32_t)entries * 3);
+    return png->ok;
+}
+
+int png_stream_write_rows(PngStream *png, const unsigned char *rows, uint32_t count) {
+    size_t rb = png->row_bytes;
+    while (count > 0 && png->ok) {
+        if (png->rows_written + count > png->height) {
+            png->ok = 0;
+            break;
+        }
+        // Encode only when space is needed, so the final band is always
+        // left for png_stream_close to finish with BFINAL set
+        if (png->band_used == png->band_rows)
+            png->ok = encode_band(png, 0);
+        uint32_t n = png->band_rows - png->band_used;
+        if (n > count) n = count;
+        memcpy(png->band + ((size_t)png->band_used + 1) * rb, rows, (size_t)n * rb);
+        png->band_used += n;
+        png->rows_written += n;
+        rows += (size_t)n * rb;
+        count -= n;
+    }
+    return png->ok;
+}
+
+int png_stream_close(PngStream *png) {
+    if (!png) return 0;
+    int ok = png->ok && png->rows_written == png->height && png->band_used > 0
+             && encode_band(png, 1);
+    if (ok) {
+        unsigned char trailer[4];
+        put_u32(trailer, (uint32_t)png->adler);
+        ok = idat_append(png, trailer, 4)
+             && (png->out_len == 0 || write_chunk(png->file, "IDAT", png->out, (uint32_t)png->out_len))
+             && write_chunk(png->file, "IEND", NULL, 0);
+    }
+    if (fclose(png->file) != 0) ok = 0;
+    free(png->band);
+    free(png->filtered);
+    free(png->window);
+    free(png->out);
+    free(png);
+    return ok;
+}
+
+size_t png_stream_row_bytes(const PngStream *png) {
+    return png->row_bytes;
+}
+
+int png_write_image(const char *path, const unsigned char *pixels, uint32_t width, uint32_t height,
+                    int color_type, int bit_depth, int level)
+{
+    PngStream *png = png_stream_open(path, width, height, color_type, bit_depth, level);
+    if (!png) return 0;
+    png_stream_write_rows(png, pixels, height);
+    return png_stream_close(png);
+}
+
+static size_t put_chunk(unsigned char *p, const char *type, const unsigned char *data, uint32_t len) {
+    put_u32(p, len);
+    memcpy(p + 4, type, 4);
+    if (len > 0) memcpy(p + 8, data, len);
+    put_u32(p + 8 + len, (uint32_t)crc32(0L, p + 4, len + 4));
+    return (size_t)len + 12;
+}
+
+unsigned char *png_encode_rgb(const unsigned char *pixels, uint32_t width, uint32_t height,
+                              int level, size_t *out_len)
+{
+    uint64_t span = trace_begin();
+    size_t rb = (size_t)width * 3, raw_len = (rb + 1) * height;
+    unsigned char *filtered = malloc(raw_len);
+    unsigned char *zero = calloc(rb, 1);
+    uLongf zlen = compressBound((uLong)raw_len);
+    unsigned char *png = malloc(8 + 25 + 12 + zlen + 12);
+    if (!filtered || !zero || !png) {
+        free(filtered);
+        free(zero);
+        free(png);
+        return NULL;
+    }
+    for (uint32_t y = 0; y < height; y++)
+        filter_row(filtered + y * (rb + 1), pixels + y * rb, y ? pixels + (y - 1) * rb : zero, rb, 3);
+
+    static const unsigned char signature[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+    unsigned char ihdr[13] = { 0 };
+    put_u32(ihdr, width);
+    put_u32(ihdr + 4, height);
+    ihdr[8] = 8;
+    ihdr[9] = PNG_RGB;
+    memcpy(png, signature, 8);
+    size_t len = 8 + put_chunk(png + 8, "IHDR", ihdr, sizeof(ihdr));
+
+    // IDAT payload is compressed in place after its chunk header
+    int ok = compress2(png + len + 8, &zlen, filtered, (uLong)raw_len, level) == Z_OK;
+    if (ok) {
+        put_u32(png + len, (uint32_t)zlen);
+        memcpy(png + len + 4, "IDAT", 4);
+        put_u32(png + len + 8 + zlen, (uint32_t)crc32(0L, png + len + 4, (uInt)zlen + 4));
+        len += zlen + 12;
+        len += put_chunk(png + len, "IEND", NULL, 0);
+    }
+    free(filtered);
+    free(zero);
+    if (!ok) {
+        free(png);
+        return NULL;
+    }
+    *out_len = len;
+    trace_end("encode", span, 0, 0, (int)width, (int)height);
+    return png;
+}
+
+int save_png_indexed(const char *path, const unsigned char *indices, int width, int height,
+                     int palette, int level)
+{
+    unsigned char plte[256 * 3];
+    palette_plte(palette, plte);
+    PngStream *png = png_stream_open(path, (uint32_t)width, (uint32_t)height, PNG_INDEXED, 8, level);
+    if (!png) return 0;
+    png_stream_set_palette(png, plte, 256);
+    png_stream_write_rows(png, indices, (uint32_t)height);
+    return png_stream_close(png);
+}
+
+int save_png_iter16(const char *path, const uint16_t *iters, int width, int height, int level) {
+    PngStream *png = png_stream_open(path, (uint32_t)width, (uint32_t)height, PNG_GRAY, 16, level);
+    if (!png) return 0;
+    size_t row_bytes = (size_t)width * 2;
+    unsigned char *band = malloc(row_bytes * PNG_STREAM_BAND);
+    int ok = band != NULL;
+
+    // PNG samples are big-endian; swap one band at a time
+    for (int y0 = 0; ok && y0 < height; y0 += PNG_STREAM_BAND) {
+        int rows = height - y0 < PNG_STREAM_BAND ? height - y0 : PNG_STREAM_BAND;
+        const uint16_t *src = iters + (size_t)y0 * width;
+        size_t n = (size_t)rows * width;
+        #pragma omp parallel for schedule(static)
+        for (size_t i = 0; i < n; i++) {
+            band[i * 2] = (unsigned char)(src[i] >> 8);
+            band[i * 2 + 1] = (unsigned char)src[i];
+        }
+        ok = png_stream_write_rows(png, band, (uint32_t)rows);
+    }
+
+    free(band);
+    return png_stream_close(png) && ok;
+}
+
+int generate_png_streamed(const char *path, int width, int height,
+                          const FractalView *view, int level)
+{
+    PngStream *png = png_stream_open(path, (uint32_t)width, (uint32_t)height, PNG_RGB, 8, level);
+    if (!png) return 0;
+    size_t stride = (size_t)width * 3;
+    unsigned char *band = malloc(stride * PNG_STREAM_BAND);
+    int ok = band != NULL;
+
+    for (int y0 = 0; ok && y0 < height; y0 += PNG_STREAM_BAND) {
+        int rows = height - y0 < PNG_STREAM_BAND ? height - y0 : PNG_STREAM_BAND;
+        #pragma omp parallel for schedule(dynamic)
+        for (int r = 0; r < rows; r++)
+            render_tile(band + (size_t)r * stride, stride, width, height, view, 0, y0 + r, width, 1);
+        ok = png_stream_write_rows(png, band, (uint32_t)rows);
+    }
+
+    free(band);
+    return png_stream_close(png) && ok;
+}
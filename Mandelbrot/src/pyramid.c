@@ -0,0 +1,166 @@
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include "pyramid.h"
+#include "image_io.h"
+#include "metrics.h"
+
+typedef struct {
+    int width, height;
+    int y0, rows;         // first image row held in buf and rows buffered
+    unsigned char *buf;   // one tile row: PYRAMID_TILE rows of width * 3
+} Level;
+
+typedef struct {
+    Level *levels;
+    char dir[1024];       // <name>_files
+    int format, level;
+    long tiles;
+    int failed;
+} Pyramid;
+
+static int make_dir(const char *path) {
+    return mkdir(path, 0755) == 0 || errno == EEXIST;
+}
+
+// Writes the buffered tile row of level l, one file per tile, tiles in parallel
+static void emit_tiles(Pyramid *p, int l) {
+    Level *lv = &p->levels[l];
+    int tiles_x = (lv->width + PYRAMID_TILE - 1) / PYRAMID_TILE;
+    int row = lv->y0 / PYRAMID_TILE;
+    long written = 0;
+    int failed = 0;
+
+    #pragma omp parallel reduction(+:written)
+    {
+        unsigned char *tile = malloc((size_t)PYRAMID_TILE * PYRAMID_TILE * 3);
+        char path[1200];
+        #pragma omp for schedule(dynamic)
+        for (int tx = 0; tx < tiles_x; tx++) {
+            int x0 = tx * PYRAMID_TILE;
+            int tw = lv->width - x0 < PYRAMID_TILE ? lv->width - x0 : PYRAMID_TILE;
+            if (!tile) {
+                failed = 1;
+                continue;
+            }
+            for (int y = 0; y < lv->rows; y++)
+                memcpy(tile + (size_t)y * tw * 3, lv->buf + ((size_t)y * lv->width + x0) * 3, (size_t)tw * 3);
+            snprintf(path, sizeof(path), "%s/%d/%d_%d.%s", p->dir, l, tx, row, image_format_ext(p->format));
+            if (save_image(path, tile, tw, lv->rows, p->format, p->level)) written++;
+            else failed = 1;
+        }
+        free(tile);
+    }
+    p->tiles += written;
+    if (failed) p->failed = 1;
+}
+
+// 2x2 box filter of src's buffered rows appended to dst; odd edges repeat the last pixel
+static void downsample(const Level *src, Level *dst) {
+    int out_rows = (src->rows + 1) / 2;
+    size_t src_stride = (size_t)src->width * 3, dst_stride = (size_t)dst->width * 3;
+
+    #pragma omp parallel for schedule(static)
+    for (int r = 0; r < out_rows; r++) {
+        const unsigned char *a = src->buf + (size_t)(2 * r) * src_stride;
+        const unsigned char *b = 2 * r + 1 < src->rows ? a + src_stride : a;
+        unsigned char *out = dst->buf + (size_t)(dst->rows + r) * dst_stride;
+        for (int x = 0; x < dst->width; x++) {
+            size_t i = (size_t)(2 * x) * 3;
+            size_t j = 2 * x + 1 < src->width ? i + 3 : i;
+            for (int c = 0; c < 3; c++)
+                out[(size_t)x * 3 + c] = (unsigned char)((a[i + c] + a[j + c] + b[i + c] + b[j + c] + 2) >> 2);
+        }
+    }
+}
+
+// A full (or final) tile row of level l is ready: write it, feed the level
+// below, and cascade whenever that level completes a tile row of its own
+static void flush_level(Pyramid *p, int l) {
+    Level *lv = &p->levels[l];
+    emit_tiles(p, l);
+    if (l > 0) {
+        Level *down = &p->levels[l - 1];
+        downsample(lv, down);
+        down->rows += (lv->rows + 1) / 2;
+        if (down->rows == PYRAMID_TILE || down->y0 + down->rows == down->height)
+            flush_level(p, l - 1);
+    }
+    lv->y0 += lv->rows;
+    lv->rows = 0;
+}
+
+static int write_descriptor(const char *path, int width, int height, int format) {
+    FILE *f = fopen(path, "w");
+    if (!f) return 0;
+    int ok = fprintf(f, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                        "<Image xmlns=\"http://schemas.microsoft.com/deepzoom/2008\" "
+                        "TileSize=\"%d\" Overlap=\"0\" Format=\"%s\">\n"
+                        "  <Size Width=\"%d\" Height=\"%d\"/>\n"
+                        "</Image>\n",
+                     PYRAMID_TILE, image_format_ext(format), width, height) > 0;
+    if (fclose(f) != 0) ok = 0;
+    return ok;
+}
+
+int generate_dzi(const char *dzi_path, int width, int height, const FractalView *view,
+                 int format, int level, PyramidInfo *info)
+{
+    Pyramid p;
+    memset(&p, 0, sizeof(p));
+    p.format = format;
+    p.level = level;
+
+    size_t base = strlen(dzi_path);
+    if (base > 4 && strcmp(dzi_path + base - 4, ".dzi") == 0) base -= 4;
+    if (base + 16 > sizeof(p.dir)) return 0;
+    snprintf(p.dir, sizeof(p.dir), "%.*s_files", (int)base, dzi_path);
+    if (!make_dir(p.dir)) return 0;
+
+    // Level count: halve (rounding up) until the image is a single pixel
+    int top = 0;
+    while ((1L << top) < (width > height ? width : height)) top++;
+    int count = top + 1;
+    p.levels = calloc((size_t)count, sizeof(Level));
+    if (!p.levels) return 0;
+
+    int ok = 1;
+    for (int l = top, w = width, h = height; l >= 0; l--, w = (w + 1) / 2, h = (h + 1) / 2) {
+        char path[1100];
+        snprintf(path, sizeof(path), "%s/%d", p.dir, l);
+        p.levels[l].width = w;
+        p.levels[l].height = h;
+        p.levels[l].buf = malloc((size_t)w * PYRAMID_TILE * 3);
+        if (!p.levels[l].buf || !make_dir(path)) ok = 0;
+    }
+
+    Level *full = &p.levels[top];
+    int tiles_x = (width + PYRAMID_TILE - 1) / PYRAMID_TILE;
+    size_t stride = (size_t)width * 3;
+    for (int y0 = 0; ok && !p.failed && y0 < height; y0 += PYRAMID_TILE) {
+        int th = height - y0 < PYRAMID_TILE ? height - y0 : PYRAMID_TILE;
+
+        #pragma omp parallel for schedule(dynamic)
+        for (int tx = 0; tx < tiles_x; tx++) {
+            int x0 = tx * PYRAMID_TILE;
+            int tw = width - x0 < PYRAMID_TILE ? width - x0 : PYRAMID_TILE;
+            double start = omp_get_wtime();
+            render_tile(full->buf + (size_t)x0 * 3, stride, width, height, view, x0, y0, tw, th);
+            metrics_tile(omp_get_wtime() - start);
+        }
+        full->rows = th;
+        flush_level(&p, top);
+    }
+
+    ok = ok && !p.failed && write_descriptor(dzi_path, width, height, format);
+    if (info) {
+        info->levels = count;
+        info->tiles = p.tiles;
+    }
+    for (int l = 0; l < count; l++) free(p.levels[l].buf);
+    free(p.levels);
+    return ok;
+}
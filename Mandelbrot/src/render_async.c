@@ -0,0 +1,146 @@
+#include <omp.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+#include <errno.h>
+#include "render_async.h"
+#include "metrics.h"
+
+struct RenderJob {
+    unsigned char *image;
+    int width, height;
+    FractalView view;
+    RenderTileFn on_tile;
+    void *user;
+
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t finished;
+    int status;
+    int cancel;
+    int failed;                   // a tile came back short without a cancel
+    long long pixels_done;
+};
+
+static int cancel_requested(const RenderJob *job) {
+    return __atomic_load_n(&job->cancel, __ATOMIC_RELAXED);
+}
+
+static int job_failed(const RenderJob *job) {
+    return __atomic_load_n(&job->failed, __ATOMIC_RELAXED);
+}
+
+static void *render_async_main(void *arg) {
+    RenderJob *job = arg;
+    int tiles_x = (job->width + RENDER_ASYNC_TILE - 1) / RENDER_ASYNC_TILE;
+    int tiles_y = (job->height + RENDER_ASYNC_TILE - 1) / RENDER_ASYNC_TILE;
+    int tiles = tiles_x * tiles_y;
+    size_t stride = (size_t)job->width * 3;
+    int completed = 0;
+
+    #pragma omp parallel for schedule(dynamic) reduction(+:completed)
+    for (int t = 0; t < tiles; t++) {
+        if (cancel_requested(job) || job_failed(job)) continue;
+        int x0 = (t % tiles_x) * RENDER_ASYNC_TILE;
+        int y0 = (t / tiles_x) * RENDER_ASYNC_TILE;
+        int tw = job->width - x0 < RENDER_ASYNC_TILE ? job->width - x0 : RENDER_ASYNC_TILE;
+        int th = job->height - y0 < RENDER_ASYNC_TILE ? job->height - y0 : RENDER_ASYNC_TILE;
+
+        // The kernel polls the flag inside its iteration loop, so a cancel
+        // lands within microseconds even on deep interior pixels
+        double start = omp_get_wtime();
+        int rows = render_tile_polled(job->image + (size_t)y0 * stride + (size_t)x0 * 3, stride,
+                                      job->width, job->height, &job->view, x0, y0, tw, th, &job->cancel);
+        #pragma omp atomic
+        job->pixels_done += (long long)rows * tw;
+        if (rows < th) {
+            // Short without a cancel: the kernel could not run, and the
+            // remaining tiles would only retry the same allocation
+            if (!cancel_requested(job)) __atomic_store_n(&job->failed, 1, __ATOMIC_RELAXED);
+            continue;
+        }
+        completed++;
+        metrics_tile(omp_get_wtime() - start);
+        if (job->on_tile) job->on_tile(job->user, x0, y0, tw, th);
+    }
+
+    pthread_mutex_lock(&job->lock);
+    // A cancel that arrives after the last tile finished changes nothing
+    job->status = completed == tiles ? RENDER_DONE : job_failed(job) ? RENDER_FAILED : RENDER_CANCELLED;
+    pthread_cond_broadcast(&job->finished);
+    pthread_mutex_unlock(&job->lock);
+    return NULL;
+}
+
+RenderJob *render_async_start(unsigned char *image, int width, int height,
+                              const FractalView *view, RenderTileFn on_tile, void *user)
+{
+    RenderJob *job = calloc(1, sizeof(RenderJob));
+    if (!job) return NULL;
+    job->image = image;
+    job->width = width;
+    job->height = height;
+    job->view = *view;
+    job->on_tile = on_tile;
+    job->user = user;
+    job->status = RENDER_RUNNING;
+    pthread_mutex_init(&job->lock, NULL);
+    pthread_cond_init(&job->finished, NULL);
+
+    if (pthread_create(&job->thread, NULL, render_async_main, job) != 0) {
+        pthread_cond_destroy(&job->finished);
+        pthread_mutex_destroy(&job->lock);
+        free(job);
+        return NULL;
+    }
+    return job;
+}
+
+double render_async_progress(const RenderJob *job) {
+    long long done;
+    #pragma omp atomic read
+    done = job->pixels_done;
+    return (double)done / ((double)job->width * job->height);
+}
+
+int render_async_status(const RenderJob *job) {
+    int status;
+    pthread_mutex_lock((pthread_mutex_t *)&job->lock);
+    status = job->status;
+    pthread_mutex_unlock((pthread_mutex_t *)&job->lock);
+    return status;
+}
+
+int render_async_wait(RenderJob *job, double timeout) {
+    pthread_mutex_lock(&job->lock);
+    if (timeout < 0) {
+        while (job->status == RENDER_RUNNING)
+            pthread_cond_wait(&job->finished, &job->lock);
+    } else {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        long long ns = deadline.tv_nsec + (long long)(timeout * 1e9);
+        deadline.tv_sec += ns / 1000000000LL;
+        deadline.tv_nsec = ns % 1000000000LL;
+        while (job->status == RENDER_RUNNING) {
+            if (pthread_cond_timedwait(&job->finished, &job->lock, &deadline) == ETIMEDOUT)
+                break;
+        }
+    }
+    int status = job->status;
+    pthread_mutex_unlock(&job->lock);
+    return status;
+}
+
+void render_async_cancel(RenderJob *job) {
+    __atomic_store_n(&job->cancel, 1, __ATOMIC_RELAXED);
+}
+
+void render_async_free(RenderJob *job) {
+    if (!job) return;
+    render_async_cancel(job);
+    pthread_join(job->thread, NULL);
+    pthread_cond_destroy(&job->finished);
+    pthread_mutex_destroy(&job->lock);
+    free(job);
+}
@@ -0,0 +1,77 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "shm_ring.h"
+
+// Minimal shm_ring consumer: follows a ring published by `anim --shm NAME`,
+// reports notification latency and dropped frames, optionally saves the last frame
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s NAME [--frames N] [--timeout SECONDS] [--dump FILE.ppm]\n", argv[0]);
+        return 1;
+    }
+    const char *name = argv[1], *dump = NULL;
+    long limit = -1;
+    double timeout = 5.0;
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) limit = atol(argv[++i]);
+        else if (strcmp(argv[i], "--timeout") == 0 && i + 1 < argc) timeout = atof(argv[++i]);
+        else if (strcmp(argv[i], "--dump") == 0 && i + 1 < argc) dump = argv[++i];
+        else {
+            fprintf(stderr, "Unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    // The writer may start after us
+    ShmRing *ring = NULL;
+    for (int tries = 0; !ring && tries < (int)(timeout * 100); tries++) {
+        ring = shm_ring_open(name);
+        if (!ring) nanosleep(&(struct timespec){ 0, 10000000 }, NULL);
+    }
+    if (!ring) {
+        fprintf(stderr, "Cannot open ring %s\n", name);
+        return 1;
+    }
+    int width, height;
+    shm_ring_size(ring, &width, &height);
+    printf("Ring %s: %dx%d\n", name, width, height);
+
+    ShmFrame frame;
+    uint64_t last = 0;
+    long received = 0, dropped = 0, torn = 0;
+    double latency_sum = 0.0, latency_max = 0.0;
+    unsigned char *copy = dump ? malloc((size_t)width * height * 3) : NULL;
+
+    while ((limit < 0 || received < limit) && shm_ring_wait(ring, last, timeout, &frame)) {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        double latency = ((double)ts.tv_sec * 1e9 + ts.tv_nsec - frame.timestamp_ns) / 1000.0;
+        if (last && frame.seq > last + 1) dropped += (long)(frame.seq - last - 1);
+        last = frame.seq;
+        received++;
+        latency_sum += latency;
+        if (latency > latency_max) latency_max = latency;
+
+        if (copy) {
+            memcpy(copy, frame.pixels, (size_t)width * height * 3);
+            if (!shm_ring_valid(ring, &frame)) torn++;
+        }
+        printf("frame %d seq %llu scale %.6g latency %.1f us\n", frame.frame,
+               (unsigned long long)frame.seq, frame.view.scale, latency);
+    }
+
+    printf("%ld frames, %ld dropped, %ld overwritten while copying, latency avg %.1f us max %.1f us\n",
+           received, dropped, torn, received ? latency_sum / received : 0.0, latency_max);
+    if (copy && received) {
+        FILE *f = fopen(dump, "wb");
+        int ok = f && fprintf(f, "P6\n%d %d\n255\n", width, height) > 0
+                 && fwrite(copy, 1, (size_t)width * height * 3, f) == (size_t)width * height * 3;
+        if (f && fclose(f) != 0) ok = 0;
+        printf(ok ? "Last frame saved to %s\n" : "Failed to save %s\n", dump);
+    }
+    free(copy);
+    shm_ring_close(ring);
+    return 0;
+}
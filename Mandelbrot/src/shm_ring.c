@@ -0,0 +1,234 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include "shm_ring.h"
+
+#define SHM_RING_MAGIC 0x4d42524eu  // "MBRN"
+#define SHM_RING_ALIGN 4096
+#define SHM_RING_RETRIES 64
+
+typedef struct {
+    uint64_t seq;           // 2 * publish sequence when stable, odd while being written
+    int32_t frame;
+    int32_t reserved;
+    int64_t timestamp_ns;
+    FractalView view;
+} ShmSlotMeta;
+
+typedef struct {
+    uint32_t magic, slots;
+    int32_t width, height;
+    uint64_t frame_bytes, slot_stride, data_offset, map_size;
+    uint64_t head;          // sequence of the newest published frame, 0 = none
+    uint32_t notify;        // futex word, bumped on every publish
+    uint32_t waiters;       // readers sleeping on notify
+    ShmSlotMeta meta[];
+} ShmRingHeader;
+
+struct ShmRing {
+    ShmRingHeader *hdr;
+    unsigned char *base;
+    size_t size;
+    uint64_t next;          // writer: sequence being drawn
+};
+
+static int64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static long futex(uint32_t *addr, int op, uint32_t val, const struct timespec *timeout) {
+    return syscall(SYS_futex, addr, op, val, timeout, NULL, 0);
+}
+
+static ShmRing *map_ring(int fd, size_t size) {
+    void *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return NULL;
+    ShmRing *ring = calloc(1, sizeof(ShmRing));
+    if (!ring) {
+        munmap(map, size);
+        return NULL;
+    }
+    ring->base = map;
+    ring->hdr = map;
+    ring->size = size;
+    return ring;
+}
+
+ShmRing *shm_ring_create(const char *name, int width, int height, int slots) {
+    if (width <= 0 || height <= 0 || slots < 2) return NULL;
+    uint64_t frame_bytes = (uint64_t)width * height * 3;
+    uint64_t slot_stride = (frame_bytes + SHM_RING_ALIGN - 1) / SHM_RING_ALIGN * SHM_RING_ALIGN;
+    uint64_t data_offset = (sizeof(ShmRingHeader) + (uint64_t)slots * sizeof(ShmSlotMeta)
+                            + SHM_RING_ALIGN - 1) / SHM_RING_ALIGN * SHM_RING_ALIGN;
+    uint64_t size = data_offset + slot_stride * (uint64_t)slots;
+
+    shm_unlink(name);
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd < 0) return NULL;
+    if (ftruncate(fd, (off_t)size) != 0) {
+        close(fd);
+        shm_unlink(name);
+        return NULL;
+    }
+    ShmRing *ring = map_ring(fd, (size_t)size);
+    if (!ring) {
+        shm_unlink(name);
+        return NULL;
+    }
+
+    // Fresh shm is zero-filled: head 0, every slot seq 0 (stable, empty)
+    ShmRingHeader *hdr = ring->hdr;
+    hdr->slots = (uint32_t)slots;
+    hdr->width = width;
+    hdr->height = height;
+    hdr->frame_bytes = frame_bytes;
+    hdr->slot_stride = slot_stride;
+    hdr->data_offset = data_offset;
+    hdr->map_size = size;
+    __atomic_store_n(&hdr->magic, SHM_RING_MAGIC, __ATOMIC_RELEASE);
+    ring->next = 1;
+    return ring;
+}
+
+static unsigned char *slot_pixels(const ShmRing *ring, uint64_t seq) {
+    const ShmRingHeader *hdr = ring->hdr;
+    return ring->base + hdr->data_offset + (seq % hdr->slots) * hdr->slot_stride;
+}
+
+unsigned char *shm_ring_acquire(ShmRing *ring) {
+    ShmSlotMeta *m = &ring->hdr->meta[ring->next % ring->hdr->slots];
+    // Odd marks the slot as being written before any pixel changes
+    __atomic_store_n(&m->seq, 2 * ring->next - 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    return slot_pixels(ring, ring->next);
+}
+
+void shm_ring_publish(ShmRing *ring, int frame, const FractalView *view) {
+    ShmRingHeader *hdr = ring->hdr;
+    ShmSlotMeta *m = &hdr->meta[ring->next % hdr->slots];
+    m->frame = frame;
+    m->timestamp_ns = now_ns();
+    m->view = *view;
+    __atomic_store_n(&m->seq, 2 * ring->next, __ATOMIC_RELEASE);
+    __atomic_store_n(&hdr->head, ring->next, __ATOMIC_RELEASE);
+    ring->next++;
+
+    // Pairs with the waiter's increment-then-read in shm_ring_wait: either
+    // the reader sees the new notify value or we see its waiter count
+    __atomic_add_fetch(&hdr->notify, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&hdr->waiters, __ATOMIC_SEQ_CST) > 0)
+        futex(&hdr->notify, FUTEX_WAKE, INT_MAX, NULL);
+}
+
+int shm_ring_unlink(const char *name) {
+    return shm_unlink(name) == 0;
+}
+
+// The reader sizes every access from the header, so it must describe frames
+// that fit in the mapping: metadata for every slot before the pixel data,
+// slots large enough for a frame, and all of them within map_size
+static int header_valid(const ShmRingHeader *hdr, size_t size) {
+    if (__atomic_load_n(&hdr->magic, __ATOMIC_ACQUIRE) != SHM_RING_MAGIC
+        || hdr->map_size != size || hdr->slots < 2 || hdr->width <= 0 || hdr->height <= 0)
+        return 0;
+    uint64_t meta_end = sizeof(ShmRingHeader) + (uint64_t)hdr->slots * sizeof(ShmSlotMeta);
+    return hdr->frame_bytes == (uint64_t)hdr->width * (uint64_t)hdr->height * 3
+        && hdr->slot_stride >= hdr->frame_bytes
+        && hdr->data_offset >= meta_end && hdr->data_offset <= hdr->map_size
+        && hdr->slot_stride <= (hdr->map_size - hdr->data_offset) / hdr->slots;
+}
+
+ShmRing *shm_ring_open(const char *name) {
+    int fd = shm_open(name, O_RDWR, 0);
+    if (fd < 0) return NULL;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(ShmRingHeader)) {
+        close(fd);
+        return NULL;
+    }
+    ShmRing *ring = map_ring(fd, (size_t)st.st_size);
+    if (!ring) return NULL;
+    if (!header_valid(ring->hdr, ring->size)) {
+        shm_ring_close(ring);
+        return NULL;
+    }
+    return ring;
+}
+
+void shm_ring_size(const ShmRing *ring, int *width, int *height) {
+    *width = ring->hdr->width;
+    *height = ring->hdr->height;
+}
+
+int shm_ring_latest(ShmRing *ring, ShmFrame *out) {
+    ShmRingHeader *hdr = ring->hdr;
+    for (int attempt = 0; attempt < SHM_RING_RETRIES; attempt++) {
+        uint64_t seq = __atomic_load_n(&hdr->head, __ATOMIC_ACQUIRE);
+        if (seq == 0) return 0;
+        uint32_t slot = (uint32_t)(seq % hdr->slots);
+        const ShmSlotMeta *m = &hdr->meta[slot];
+        // Slot already reused by a newer frame: head moved on, reload it
+        if (__atomic_load_n(&m->seq, __ATOMIC_ACQUIRE) != 2 * seq) continue;
+        out->seq = seq;
+        out->frame = m->frame;
+        out->timestamp_ns = m->timestamp_ns;
+        out->view = m->view;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&m->seq, __ATOMIC_RELAXED) != 2 * seq) continue;
+        out->width = hdr->width;
+        out->height = hdr->height;
+        out->pixels = slot_pixels(ring, seq);
+        out->slot = (int)slot;
+        return 1;
+    }
+    return 0;
+}
+
+int shm_ring_wait(ShmRing *ring, uint64_t after_seq, double timeout, ShmFrame *out) {
+    ShmRingHeader *hdr = ring->hdr;
+    int64_t deadline = timeout >= 0 ? now_ns() + (int64_t)(timeout * 1e9) : 0;
+    for (;;) {
+        if (__atomic_load_n(&hdr->head, __ATOMIC_ACQUIRE) > after_seq && shm_ring_latest(ring, out))
+            return 1;
+
+        __atomic_add_fetch(&hdr->waiters, 1, __ATOMIC_SEQ_CST);
+        uint32_t seen = __atomic_load_n(&hdr->notify, __ATOMIC_SEQ_CST);
+        int ready = __atomic_load_n(&hdr->head, __ATOMIC_SEQ_CST) > after_seq;
+        int timed_out = 0;
+        if (!ready) {
+            struct timespec ts, *tp = NULL;
+            if (timeout >= 0) {
+                int64_t left = deadline - now_ns();
+                if (left <= 0) timed_out = 1;
+                ts.tv_sec = left / 1000000000;
+                ts.tv_nsec = left % 1000000000;
+                tp = &ts;
+            }
+            if (!timed_out) futex(&hdr->notify, FUTEX_WAIT, seen, tp);
+        }
+        __atomic_sub_fetch(&hdr->waiters, 1, __ATOMIC_SEQ_CST);
+        if (timed_out) return 0;
+    }
+}
+
+int shm_ring_valid(const ShmRing *ring, const ShmFrame *frame) {
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&ring->hdr->meta[frame->slot].seq, __ATOMIC_RELAXED) == 2 * frame->seq;
+}
+
+void shm_ring_close(ShmRing *ring) {
+    if (!ring) return;
+    munmap(ring->base, ring->size);
+    free(ring);
+}
@@ -0,0 +1,688 @@
+#define _GNU_SOURCE
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <signal.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/uio.h>
+#include "fractal.h"
+#include "palette.h"
+#include "png_stream.h"
+#include "metrics.h"
+
+// XYZ tile server: GET /{z}/{x}/{y}.png on localhost. Zoom 0 is one tile
+// covering [-2.5, 1.5] x [-2, 2]; each level splits tiles 2x2.
+#define TILE_SIZE 256
+#define TILE_MAX_ZOOM 46          // tile pixels still distinct in double precision
+#define TILE_QUEUE_MAX 1024       // queued renders before 503 backpressure
+#define TILE_CACHE_MB 256
+#define TILE_CACHE_BUCKETS 65536
+#define TILE_PENDING_BUCKETS 4096
+#define TILE_IN_BUF 8192
+#define TILE_PNG_LEVEL 1          // tiles are small; favour encode speed
+
+typedef struct {
+    int refs;                     // main thread only
+    size_t len;
+    unsigned char data[];
+} Blob;
+
+typedef struct {
+    int z;
+    long long x, y;
+} TileKey;
+
+typedef struct CacheEntry {
+    TileKey key;
+    Blob *png;
+    struct CacheEntry *hnext;     // hash chain
+    struct CacheEntry *prev, *next;  // LRU list, head = most recent
+} CacheEntry;
+
+enum { JOB_QUEUED = 0, JOB_RENDERING, JOB_DONE, JOB_CANCELLED };
+
+typedef struct Job {
+    TileKey key;
+    int max_iter;
+    int prefetch;
+    uint64_t seq;
+    int waiters;                  // connections still interested, under queue_lock
+    int state;                    // under queue_lock
+    Blob *png;                    // set by the worker
+    int *wait_fd;                 // main thread: who gets the tile
+    unsigned *wait_id;
+    int nwait, wait_cap;
+    struct Job *hnext;            // pending table chain
+    struct Job *done_next;
+} Job;
+
+typedef struct {
+    int fd;
+    unsigned id;
+    char in[TILE_IN_BUF];
+    size_t in_len;
+    char hdr[256];
+    size_t hdr_len;
+    Blob *body;
+    size_t out_off;               // bytes of hdr + body already sent
+    Job *job;                     // tile this connection waits for
+    double started;               // when the request being answered was parsed
+    int keep_alive, writing;
+    uint32_t events;              // epoll interest currently registered
+} Conn;
+
+typedef struct {
+    int iter_base, iter_per_zoom, palette, threads;
+    size_t cache_limit;
+} ServerConfig;
+
+static ServerConfig config = { 256, 64, PALETTE_DEFAULT, 0, (size_t)TILE_CACHE_MB << 20 };
+
+static int epfd, wake_fd;
+static Conn **conns;
+static int conns_cap;
+static unsigned next_conn_id = 1;
+
+static CacheEntry *cache_buckets[TILE_CACHE_BUCKETS];
+static CacheEntry *lru_head, *lru_tail;
+static size_t cache_bytes, cache_count;
+static Job *pending[TILE_PENDING_BUCKETS];
+static uint64_t job_seq;
+
+static pthread_mutex_t queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queue_ready = PTHREAD_COND_INITIALIZER;
+static Job *queue[TILE_QUEUE_MAX];
+static int queued;
+static int visible_zoom;          // zoom of the latest on-screen request, under queue_lock
+
+static pthread_mutex_t done_lock = PTHREAD_MUTEX_INITIALIZER;
+static Job *done_list;
+
+static struct {
+    unsigned long long requests, hits, misses, coalesced, rejected, cancelled, rendered, failed;
+} stats;
+
+static Blob *blob_new(const void *data, size_t len) {
+    Blob *b = malloc(sizeof(Blob) + len);
+    if (!b) return NULL;
+    b->refs = 1;
+    b->len = len;
+    if (data) memcpy(b->data, data, len);
+    return b;
+}
+
+static void blob_release(Blob *b) {
+    if (b && --b->refs == 0) free(b);
+}
+
+static size_t key_hash(TileKey k) {
+    uint64_t h = (uint64_t)k.x * 0x9E3779B97F4A7C15ull ^ (uint64_t)k.y * 0xC2B2AE3D27D4EB4Full ^ (uint64_t)k.z;
+    return (size_t)(h ^ (h >> 29));
+}
+
+static int key_eq(TileKey a, TileKey b) {
+    return a.z == b.z && a.x == b.x && a.y == b.y;
+}
+
+// LRU cache of encoded tiles, main thread only
+
+static void lru_unlink(CacheEntry *e) {
+    if (e->prev) e->prev->next = e->next; else lru_head = e->next;
+    if (e->next) e->next->prev = e->prev; else lru_tail = e->prev;
+}
+
+static void lru_push_front(CacheEntry *e) {
+    e->prev = NULL;
+    e->next = lru_head;
+    if (lru_head) lru_head->prev = e;
+    lru_head = e;
+    if (!lru_tail) lru_tail = e;
+}
+
+static Blob *cache_get(TileKey key) {
+    for (CacheEntry *e = cache_buckets[key_hash(key) % TILE_CACHE_BUCKETS]; e; e = e->hnext) {
+        if (!key_eq(e->key, key)) continue;
+        lru_unlink(e);
+        lru_push_front(e);
+        return e->png;
+    }
+    return NULL;
+}
+
+static void cache_evict(void) {
+    CacheEntry *e = lru_tail;
+    CacheEntry **pp = &cache_buckets[key_hash(e->key) % TILE_CACHE_BUCKETS];
+    while (*pp != e) pp = &(*pp)->hnext;
+    *pp = e->hnext;
+    lru_unlink(e);
+    cache_bytes -= e->png->len;
+    cache_count--;
+    blob_release(e->png);  // connections still sending it keep their reference
+    free(e);
+}
+
+static void cache_put(TileKey key, Blob *png) {
+    CacheEntry *e = malloc(sizeof(CacheEntry));
+    if (!e) return;
+    size_t b = key_hash(key) % TILE_CACHE_BUCKETS;
+    e->key = key;
+    e->png = png;
+    png->refs++;
+    e->hnext = cache_buckets[b];
+    cache_buckets[b] = e;
+    lru_push_front(e);
+    cache_bytes += png->len;
+    cache_count++;
+    while (cache_bytes > config.cache_limit && lru_tail != e) cache_evict();
+}
+
+// Pending renders, main thread only: identical requests share one job
+
+static Job *pending_get(TileKey key) {
+    for (Job *j = pending[key_hash(key) % TILE_PENDING_BUCKETS]; j; j = j->hnext)
+        if (key_eq(j->key, key)) return j;
+    return NULL;
+}
+
+static void pending_remove(Job *job) {
+    Job **pp = &pending[key_hash(job->key) % TILE_PENDING_BUCKETS];
+    while (*pp && *pp != job) pp = &(*pp)->hnext;
+    if (*pp) *pp = job->hnext;
+}
+
+static void job_free(Job *job) {
+    free(job->wait_fd);
+    free(job->wait_id);
+    free(job);
+}
+
+static int job_add_waiter(Job *job, Conn *c) {
+    if (job->nwait == job->wait_cap) {
+        int cap = job->wait_cap ? job->wait_cap * 2 : 4;
+        int *fds = realloc(job->wait_fd, (size_t)cap * sizeof(int));
+        if (fds) job->wait_fd = fds;
+        unsigned *ids = realloc(job->wait_id, (size_t)cap * sizeof(unsigned));
+        if (ids) job->wait_id = ids;
+        if (!fds || !ids) return 0;
+        job->wait_cap = cap;
+    }
+    job->wait_fd[job->nwait] = c->fd;
+    job->wait_id[job->nwait] = c->id;
+    job->nwait++;
+    pthread_mutex_lock(&queue_lock);
+    job->waiters++;
+    pthread_mutex_unlock(&queue_lock);
+    c->job = job;
+    return 1;
+}
+
+// Workers: take the most urgent job, render it single-threaded, encode, hand back
+
+static int job_before(const Job *a, const Job *b) {
+    // On-screen before prefetch, the zoom being viewed before stale zooms, newest first
+    int ra = a->prefetch * 2 + (a->key.z != visible_zoom);
+    int rb = b->prefetch * 2 + (b->key.z != visible_zoom);
+    return ra != rb ? ra < rb : a->seq > b->seq;
+}
+
+static void *worker_main(void *arg) {
+    (void)arg;
+    unsigned char *rgb = malloc((size_t)TILE_SIZE * TILE_SIZE * 3);
+    for (;;) {
+        pthread_mutex_lock(&queue_lock);
+        while (queued == 0) pthread_cond_wait(&queue_ready, &queue_lock);
+        // The queue is bounded and a tile costs milliseconds, so a scan is cheap
+        // and lets priorities follow the viewer as it moves
+        int best = 0;
+        for (int i = 1; i < queued; i++)
+            if (job_before(queue[i], queue[best])) best = i;
+        Job *job = queue[best];
+        queue[best] = queue[--queued];
+        job->state = JOB_RENDERING;
+        pthread_mutex_unlock(&queue_lock);
+
+        job->png = NULL;
+        if (rgb) {
+            double start = omp_get_wtime();
+            double scale = 4.0 / (double)(1LL << job->key.z);
+            FractalView view = { job->max_iter, -2.5 + (job->key.x + 0.5) * scale,
+                                 -2.0 + (job->key.y + 0.5) * scale, scale, 0, 0.0, 0.0, config.palette };
+            render_tile(rgb, (size_t)TILE_SIZE * 3, TILE_SIZE, TILE_SIZE, &view, 0, 0, TILE_SIZE, TILE_SIZE);
+            size_t len;
+            unsigned char *png = png_encode_rgb(rgb, TILE_SIZE, TILE_SIZE, TILE_PNG_LEVEL, &len);
+            if (png) {
+                job->png = blob_new(png, len);
+                free(png);
+            }
+            metrics_tile(omp_get_wtime() - start);
+        }
+
+        pthread_mutex_lock(&done_lock);
+        job->done_next = done_list;
+        done_list = job;
+        pthread_mutex_unlock(&done_lock);
+        uint64_t one = 1;
+        if (write(wake_fd, &one, sizeof(one)) < 0) { /* counter already nonzero */ }
+    }
+    return NULL;
+}
+
+// Connections
+
+// Registers only what the connection can act on. Interest is level-triggered,
+// so unread or buffered requests must not be polled while a response is being
+// sent or a render is pending: only writability, or a hangup, matters then
+static void update_events(Conn *c) {
+    uint32_t events = c->writing ? EPOLLOUT : c->job ? EPOLLRDHUP : EPOLLIN;
+    if (c->events == events) return;
+    struct epoll_event ev = { .events = events, .data.fd = c->fd };
+    epoll_ctl(epfd, EPOLL_CTL_MOD, c->fd, &ev);
+    c->events = events;
+}
+
+static void conn_close(Conn *c) {
+    if (c->job) {
+        // Last interested client gone: drop the render if it has not started
+        Job *job = c->job;
+        int cancelled = 0;
+        pthread_mutex_lock(&queue_lock);
+        if (--job->waiters == 0 && job->state == JOB_QUEUED) {
+            for (int i = 0; i < queued; i++) {
+                if (queue[i] != job) continue;
+                queue[i] = queue[--queued];
+                break;
+            }
+            job->state = JOB_CANCELLED;
+            cancelled = 1;
+        }
+        pthread_mutex_unlock(&queue_lock);
+        if (cancelled) {
+            pending_remove(job);
+            job_free(job);
+            stats.cancelled++;
+        }
+    }
+    blob_release(c->body);
+    epoll_ctl(epfd, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    conns[c->fd] = NULL;
+    free(c);
+}
+
+static void process_requests(Conn *c);
+
+// Sends as much of the response as the socket takes; 0 if the connection closed
+static int conn_flush(Conn *c) {
+    while (c->writing) {
+        size_t body_len = c->body ? c->body->len : 0;
+        struct iovec iov[2];
+        int n = 0;
+        if (c->out_off < c->hdr_len) {
+            iov[n].iov_base = c->hdr + c->out_off;
+            iov[n++].iov_len = c->hdr_len - c->out_off;
+        }
+        size_t body_off = c->out_off > c->hdr_len ? c->out_off - c->hdr_len : 0;
+        if (body_off < body_len) {
+            iov[n].iov_base = c->body->data + body_off;
+            iov[n++].iov_len = body_len - body_off;
+        }
+        if (n == 0) {
+            c->writing = 0;
+            blob_release(c->body);
+            c->body = NULL;
+            if (!c->keep_alive) {
+                conn_close(c);
+                return 0;
+            }
+            break;
+        }
+        ssize_t w = writev(c->fd, iov, n);
+        if (w < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            update_events(c);
+            return 1;
+        }
+        if (w <= 0) {
+            conn_close(c);
+            return 0;
+        }
+        c->out_off += (size_t)w;
+    }
+    return 1;
+}
+
+// Queues a response holding a reference to body; 0 if the connection closed
+static int respond(Conn *c, int status, const char *type, Blob *body, int cacheable) {
+    const char *reason = status == 200 ? "OK" : status == 400 ? "Bad Request"
+                       : status == 404 ? "Not Found" : status == 405 ? "Method Not Allowed"
+                       : status == 503 ? "Service Unavailable" : "Internal Server Error";
+    c->hdr_len = (size_t)snprintf(c->hdr, sizeof(c->hdr),
+        "HTTP/1.1 %d %s\r\nContent-Type: %s\r\nContent-Length: %zu\r\n"
+        "Access-Control-Allow-Origin: *\r\n%s%s\r\n",
+        status, reason, type, body ? body->len : 0,
+        cacheable ? "Cache-Control: public, max-age=86400\r\n" : status == 503 ? "Retry-After: 1\r\n" : "",
+        c->keep_alive ? "Connection: keep-alive\r\n" : "Connection: close\r\n");
+    metrics_observe(METRIC_REQUEST_SECONDS, omp_get_wtime() - c->started);
+    c->body = body;
+    if (body) body->refs++;
+    c->out_off = 0;
+    c->writing = 1;
+    return conn_flush(c);
+}
+
+static int respond_text(Conn *c, int status, const char *text) {
+    Blob *b = blob_new(text, strlen(text));
+    int alive = respond(c, status, "text/plain", b, 0);
+    blob_release(b);
+    return alive;
+}
+
+static int handle_stats(Conn *c) {
+    char text[1024];
+    pthread_mutex_lock(&queue_lock);
+    int depth = queued;
+    pthread_mutex_unlock(&queue_lock);
+    snprintf(text, sizeof(text),
+             "requests %llu\nhits %llu\nmisses %llu\ncoalesced %llu\nrejected %llu\n"
+             "cancelled %llu\nrendered %llu\nfailed %llu\nqueue %d\ncache_tiles %zu\ncache_bytes %zu\n",
+             stats.requests, stats.hits, stats.misses, stats.coalesced, stats.rejected,
+             stats.cancelled, stats.rendered, stats.failed, depth, cache_count, cache_bytes);
+    return respond_text(c, 200, text);
+}
+
+// Prometheus scrape target; the counters are shared with every render path
+static int handle_metrics(Conn *c) {
+    size_t cap = metrics_format(NULL, 0) + 1024;
+    Blob *b = malloc(sizeof(Blob) + cap);
+    if (!b) return respond_text(c, 500, "out of memory\n");
+    b->refs = 1;
+    metrics_format((char *)b->data, cap);
+    b->len = strlen((char *)b->data);
+    int alive = respond(c, 200, "text/plain; version=0.0.4", b, 0);
+    blob_release(b);
+    return alive;
+}
+
+static int handle_tile(Conn *c, TileKey key, int prefetch) {
+    Blob *png = cache_get(key);
+    if (png) {
+        stats.hits++;
+        metrics_add(METRIC_CACHE_HITS, 1);
+        return respond(c, 200, "image/png", png, 1);
+    }
+    stats.misses++;
+    metrics_add(METRIC_CACHE_MISSES, 1);
+
+    Job *job = pending_get(key);
+    if (job) {
+        stats.coalesced++;
+        if (!job_add_waiter(job, c)) return respond_text(c, 500, "out of memory\n");
+        if (!prefetch) {
+            // Someone is looking at it now
+            pthread_mutex_lock(&queue_lock);
+            job->prefetch = 0;
+            visible_zoom = key.z;
+            pthread_mutex_unlock(&queue_lock);
+        }
+        return 1;
+    }
+
+    job = calloc(1, sizeof(Job));
+    if (!job) return respond_text(c, 500, "out of memory\n");
+    job->key = key;
+    job->prefetch = prefetch;
+    job->seq = ++job_seq;
+    int iter = config.iter_base + config.iter_per_zoom * key.z;
+    job->max_iter = iter < AUTO_ITER_MAX ? iter : AUTO_ITER_MAX;
+
+    pthread_mutex_lock(&queue_lock);
+    int full = queued >= TILE_QUEUE_MAX;
+    if (!full) {
+        queue[queued++] = job;
+        if (!prefetch) visible_zoom = key.z;
+        pthread_cond_signal(&queue_ready);
+    }
+    pthread_mutex_unlock(&queue_lock);
+    if (full) {
+        free(job);
+        stats.rejected++;
+        return respond_text(c, 503, "render queue full\n");
+    }
+    size_t b = key_hash(key) % TILE_PENDING_BUCKETS;
+    job->hnext = pending[b];
+    pending[b] = job;
+    if (!job_add_waiter(job, c)) return respond_text(c, 500, "out of memory\n");
+    return 1;
+}
+
+// Parses "/z/x/y[.png][?prefetch=1]"; returns 0 if the path is not a tile
+static int parse_tile(const char *path, TileKey *key, int *prefetch) {
+    int z, n = 0;
+    long long x, y;
+    if (sscanf(path, "/%d/%lld/%lld%n", &z, &x, &y, &n) != 3) return 0;
+    const char *rest = path + n;
+    if (strncmp(rest, ".png", 4) == 0) rest += 4;
+    if (*rest != '\0' && *rest != '?') return 0;
+    if (z < 0 || z > TILE_MAX_ZOOM || x < 0 || y < 0 || x >= (1LL << z) || y >= (1LL << z)) return -1;
+    key->z = z;
+    key->x = x;
+    key->y = y;
+    *prefetch = strstr(rest, "prefetch=1") != NULL;
+    return 1;
+}
+
+// Handles pipelined requests one at a time; stops while a response is in flight
+// or a render is pending, then registers the matching epoll interest
+static void process_requests(Conn *c) {
+    while (!c->writing && !c->job) {
+        char *end = memmem(c->in, c->in_len, "\r\n\r\n", 4);
+        if (!end) {
+            if (c->in_len == sizeof(c->in)) {
+                c->started = omp_get_wtime();
+                c->keep_alive = 0;
+                if (!respond_text(c, 400, "request too large\n")) return;
+                continue;
+            }
+            break;
+        }
+        *end = '\0';
+        size_t used = (size_t)(end - c->in) + 4;
+
+        char method[8], path[512], version[16];
+        int ok = sscanf(c->in, "%7s %511s %15s", method, path, version) == 3;
+        const char *conn_hdr = strcasestr(c->in, "\r\nConnection:");
+        int close_req = conn_hdr && strncasecmp(conn_hdr + 13 + strspn(conn_hdr + 13, " "), "close", 5) == 0;
+        int keep_req = conn_hdr && strncasecmp(conn_hdr + 13 + strspn(conn_hdr + 13, " "), "keep-alive", 10) == 0;
+        c->keep_alive = ok && (strcmp(version, "HTTP/1.1") == 0 ? !close_req : keep_req);
+        memmove(c->in, c->in + used, c->in_len - used);
+        c->in_len -= used;
+        stats.requests++;
+        c->started = omp_get_wtime();
+
+        TileKey key;
+        int prefetch, tile = ok ? parse_tile(path, &key, &prefetch) : 0;
+        int alive;
+        if (!ok) alive = respond_text(c, 400, "bad request\n");
+        else if (strcmp(method, "GET") != 0) alive = respond_text(c, 405, "GET only\n");
+        else if (tile == 1) alive = handle_tile(c, key, prefetch);
+        else if (tile < 0) alive = respond_text(c, 404, "tile out of range\n");
+        else if (strcmp(path, "/stats") == 0) alive = handle_stats(c);
+        else if (strcmp(path, "/metrics") == 0) alive = handle_metrics(c);
+        else alive = respond_text(c, 404, "not found\n");
+        if (!alive) return;
+    }
+    update_events(c);
+}
+
+static void on_readable(Conn *c) {
+    for (;;) {
+        if (c->in_len == sizeof(c->in)) break;
+        ssize_t n = read(c->fd, c->in + c->in_len, sizeof(c->in) - c->in_len);
+        if (n > 0) {
+            c->in_len += (size_t)n;
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        conn_close(c);  // EOF or error
+        return;
+    }
+    process_requests(c);
+}
+
+static void on_accept(int listen_fd) {
+    for (;;) {
+        int fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) return;
+        if (fd >= conns_cap) {
+            int cap = conns_cap ? conns_cap : 1024;
+            while (cap <= fd) cap *= 2;
+            Conn **grown = realloc(conns, (size_t)cap * sizeof(Conn *));
+            if (!grown) {
+                close(fd);
+                continue;
+            }
+            memset(grown + conns_cap, 0, (size_t)(cap - conns_cap) * sizeof(Conn *));
+            conns = grown;
+            conns_cap = cap;
+        }
+        Conn *c = calloc(1, sizeof(Conn));
+        if (!c) {
+            close(fd);
+            continue;
+        }
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        c->fd = fd;
+        c->id = next_conn_id++;
+        c->events = EPOLLIN;
+        conns[fd] = c;
+        struct epoll_event ev = { .events = EPOLLIN, .data.fd = fd };
+        epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+    }
+}
+
+// Finished renders: cache them and answer every connection still waiting
+static void on_jobs_done(void) {
+    uint64_t count;
+    if (read(wake_fd, &count, sizeof(count)) < 0) { /* spurious wakeup */ }
+    pthread_mutex_lock(&done_lock);
+    Job *list = done_list;
+    done_list = NULL;
+    pthread_mutex_unlock(&done_lock);
+
+    while (list) {
+        Job *job = list;
+        list = job->done_next;
+        pending_remove(job);
+        if (job->png) {
+            stats.rendered++;
+            cache_put(job->key, job->png);
+        } else {
+            stats.failed++;
+        }
+        for (int i = 0; i < job->nwait; i++) {
+            int fd = job->wait_fd[i];
+            Conn *c = fd < conns_cap ? conns[fd] : NULL;
+            if (!c || c->id != job->wait_id[i] || c->job != job) continue;
+            c->job = NULL;
+            int alive = job->png ? respond(c, 200, "image/png", job->png, 1)
+                                 : respond_text(c, 500, "render failed\n");
+            if (alive) process_requests(c);
+        }
+        blob_release(job->png);
+        job_free(job);
+    }
+}
+
+int main(int argc, char **argv) {
+    int port = 8080;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--port") == 0 && i + 1 < argc) port = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) config.threads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--cache-mb") == 0 && i + 1 < argc) config.cache_limit = (size_t)atol(argv[++i]) << 20;
+        else if (strcmp(argv[i], "--iter") == 0 && i + 1 < argc) config.iter_base = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--iter-per-zoom") == 0 && i + 1 < argc) config.iter_per_zoom = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--palette") == 0 && i + 1 < argc && palette_from_name(argv[i + 1]) >= 0)
+            config.palette = palette_from_name(argv[++i]);
+        else {
+            fprintf(stderr, "Usage: %s [--port N] [--threads N] [--cache-mb N] [--iter N] [--iter-per-zoom N] [--palette NAME]\n"
+                            "Serves GET /{z}/{x}/{y}.png (add ?prefetch=1 for low priority) /stats and /metrics on 127.0.0.1\n",
+                    argv[0]);
+            return 1;
+        }
+    }
+    if (config.threads <= 0) config.threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (config.threads <= 0) config.threads = 1;
+    signal(SIGPIPE, SIG_IGN);
+
+    int listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    int one = 1;
+    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = htons((uint16_t)port) };
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (listen_fd < 0 || bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0
+        || listen(listen_fd, 1024) != 0) {
+        perror("listen");
+        return 1;
+    }
+    epfd = epoll_create1(EPOLL_CLOEXEC);
+    wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    struct epoll_event ev = { .events = EPOLLIN, .data.fd = listen_fd };
+    epoll_ctl(epfd, EPOLL_CTL_ADD, listen_fd, &ev);
+    ev.data.fd = wake_fd;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, wake_fd, &ev);
+
+    // Warm the palette table shared by the zoom-0 tiles; the reference is
+    // never released, so it stays cached for the life of the server
+    palette_lut(palette_resolve(config.palette, 0), config.iter_base);
+    for (int i = 0; i < config.threads; i++) {
+        pthread_t t;
+        if (pthread_create(&t, NULL, worker_main, NULL) != 0) {
+            perror("pthread_create");
+            return 1;
+        }
+        pthread_detach(t);
+    }
+    printf("Serving tiles on http://127.0.0.1:%d/{z}/{x}/{y}.png with %d render threads\n",
+           port, config.threads);
+    fflush(stdout);
+
+    struct epoll_event events[256];
+    for (;;) {
+        int n = epoll_wait(epfd, events, 256, -1);
+        if (n < 0 && errno != EINTR) {
+            perror("epoll_wait");
+            return 1;
+        }
+        for (int i = 0; i < n; i++) {
+            int fd = events[i].data.fd;
+            if (fd == listen_fd) {
+                on_accept(listen_fd);
+            } else if (fd == wake_fd) {
+                on_jobs_done();
+            } else if (fd < conns_cap && conns[fd]) {
+                Conn *c = conns[fd];
+                // A hangup while a render is pending drops the request, as EOF does
+                if (events[i].events & (EPOLLHUP | EPOLLERR | EPOLLRDHUP)) {
+                    conn_close(c);
+                    continue;
+                }
+                if (events[i].events & EPOLLOUT) {
+                    if (conn_flush(c)) process_requests(c);
+                } else if (events[i].events & EPOLLIN) {
+                    on_readable(c);
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,94 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include "trace.h"
+
+typedef struct {
+    const char *name;
+    uint64_t start, end;    // CLOCK_MONOTONIC nanoseconds
+    int32_t tid;
+    int32_t x, y, w, h;
+    int32_t ready;          // set last, with release, once the fields above are written
+} TraceEvent;
+
+static TraceEvent *events;
+static size_t capacity;
+static size_t claimed;
+static int recording;
+static uint64_t origin;
+static __thread int32_t own_tid;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+int trace_start(size_t max_events) {
+    if (events) return 1;
+    if (max_events == 0) return 0;
+    // calloc leaves untouched pages unmapped, so a large buffer is cheap
+    events = calloc(max_events, sizeof(TraceEvent));
+    if (!events) return 0;
+    capacity = max_events;
+    origin = now_ns();
+    __atomic_store_n(&recording, 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+uint64_t trace_begin(void) {
+    return __atomic_load_n(&recording, __ATOMIC_RELAXED) ? now_ns() : 0;
+}
+
+void trace_end(const char *name, uint64_t begin, int x, int y, int w, int h) {
+    if (!begin || !__atomic_load_n(&recording, __ATOMIC_ACQUIRE)) return;
+    uint64_t end = now_ns();
+    size_t i = __atomic_fetch_add(&claimed, 1, __ATOMIC_RELAXED);
+    if (i >= capacity) return;
+    if (!own_tid) own_tid = (int32_t)syscall(SYS_gettid);
+    TraceEvent *e = &events[i];
+    e->name = name;
+    e->start = begin;
+    e->end = end;
+    e->tid = own_tid;
+    e->x = x;
+    e->y = y;
+    e->w = w;
+    e->h = h;
+    __atomic_store_n(&e->ready, 1, __ATOMIC_RELEASE);
+}
+
+int trace_write(const char *path) {
+    if (!events) return 0;
+    __atomic_store_n(&recording, 0, __ATOMIC_RELEASE);
+    size_t count = __atomic_load_n(&claimed, __ATOMIC_RELAXED);
+    size_t dropped = count > capacity ? count - capacity : 0;
+    if (count > capacity) count = capacity;
+
+    FILE *f = fopen(path, "w");
+    if (!f) return 0;
+    static char buf[1 << 20];
+    setvbuf(f, buf, _IOFBF, sizeof(buf));
+    int pid = (int)getpid();
+    fprintf(f, "{\"displayTimeUnit\":\"ms\",\"otherData\":{\"dropped_events\":%zu},\"traceEvents\":[\n", dropped);
+    fprintf(f, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"mandelbrot\"}},\n"
+               "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"main\"}}",
+            pid, pid, pid, pid);
+    for (size_t i = 0; i < count; i++) {
+        // Spans still being written when recording stopped are left out
+        const TraceEvent *e = &events[i];
+        if (!__atomic_load_n(&e->ready, __ATOMIC_ACQUIRE)) continue;
+        // Timestamps are microseconds from trace_start
+        fprintf(f, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f",
+                e->name, pid, e->tid, (double)(e->start - origin) / 1e3, (double)(e->end - e->start) / 1e3);
+        if (e->w > 0)
+            fprintf(f, ",\"args\":{\"x\":%d,\"y\":%d,\"w\":%d,\"h\":%d}", e->x, e->y, e->w, e->h);
+        fputc('}', f);
+    }
+    fprintf(f, "\n]}\n");
+    int ok = !ferror(f);
+    if (fclose(f) != 0) ok = 0;
+    return ok;
+}
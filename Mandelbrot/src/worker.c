@@ -0,0 +1,28 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "distributed.h"
+
+// Render worker for the distributed coordinator: connects, renders the
+// tiles it is sent with every core and exits when the frame is done
+int main(int argc, char **argv) {
+    if (argc < 3) {
+        fprintf(stderr, "Usage: %s HOST PORT [--threads N] [--fail-after TILES]\n", argv[0]);
+        return 1;
+    }
+    int threads = 0;
+    long fail_after = -1;
+    for (int i = 3; i < argc; i++) {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) threads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--fail-after") == 0 && i + 1 < argc) fail_after = atol(argv[++i]);
+        else {
+            fprintf(stderr, "Unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (!dist_worker_run(argv[1], atoi(argv[2]), threads, fail_after)) {
+        fprintf(stderr, "Worker stopped before the render finished\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,131 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "fractal.h"
+#include "image_io.h"
+#include "palette.h"
+
+// QOI round trips through a decoder written from the specification, with
+// black pixels in every position the encoder treats specially
+static int failures = 0;
+
+#define CHECK(cond, ...) do { \
+    if (!(cond)) { failures++; printf("FAIL %s:%d: ", __FILE__, __LINE__); printf(__VA_ARGS__); printf("\n"); } \
+} while (0)
+
+static unsigned char *read_file(const char *path, size_t *size) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return NULL;
+    fseek(f, 0, SEEK_END);
+    long len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    unsigned char *data = malloc(len > 0 ? (size_t)len : 1);
+    if (data && fread(data, 1, (size_t)len, f) != (size_t)len) {
+        free(data);
+        data = NULL;
+    }
+    fclose(f);
+    *size = (size_t)len;
+    return data;
+}
+
+// Decodes to RGBA the way the reference decoder does: index entries start
+// as (0,0,0,0) and the previous pixel as (0,0,0,255). Returns 0 on a
+// malformed stream.
+static int qoi_decode(const unsigned char *data, size_t size, int width, int height, unsigned char *rgba) {
+    if (size < 14 + 8 || memcmp(data, "qoif", 4) != 0) return 0;
+    uint32_t w = (uint32_t)data[4] << 24 | data[5] << 16 | data[6] << 8 | data[7];
+    uint32_t h = (uint32_t)data[8] << 24 | data[9] << 16 | data[10] << 8 | data[11];
+    if (w != (uint32_t)width || h != (uint32_t)height || data[12] != 3) return 0;
+
+    unsigned char index[64][4], px[4] = { 0, 0, 0, 255 };
+    memset(index, 0, sizeof(index));
+    size_t p = 14, end = size - 8, n = (size_t)width * height;
+    int run = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (run > 0) {
+            run--;
+        } else {
+            if (p >= end) return 0;
+            int b1 = data[p++];
+            if (b1 == 0xfe) {
+                if (p + 3 > end) return 0;
+                px[0] = data[p]; px[1] = data[p + 1]; px[2] = data[p + 2];
+                p += 3;
+            } else if (b1 == 0xff) {
+                if (p + 4 > end) return 0;
+                memcpy(px, data + p, 4);
+                p += 4;
+            } else if ((b1 & 0xc0) == 0x00) {
+                memcpy(px, index[b1], 4);
+            } else if ((b1 & 0xc0) == 0x40) {
+                px[0] += ((b1 >> 4) & 3) - 2;
+                px[1] += ((b1 >> 2) & 3) - 2;
+                px[2] += (b1 & 3) - 2;
+            } else if ((b1 & 0xc0) == 0x80) {
+                if (p >= end) return 0;
+                int b2 = data[p++], dg = (b1 & 0x3f) - 32;
+                px[0] += dg - 8 + ((b2 >> 4) & 0x0f);
+                px[1] += dg;
+                px[2] += dg - 8 + (b2 & 0x0f);
+            } else {
+                run = b1 & 0x3f;
+            }
+            memcpy(index[(px[0] * 3 + px[1] * 5 + px[2] * 7 + px[3] * 11) % 64], px, 4);
+        }
+        memcpy(rgba + i * 4, px, 4);
+    }
+    static const unsigned char marker[8] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+    return p == end && memcmp(data + end, marker, 8) == 0;
+}
+
+static void check_round_trip(const char *name, const unsigned char *rgb, int width, int height) {
+    const char *path = "test_image_io.qoi";
+    size_t n = (size_t)width * height, size = 0;
+    CHECK(save_image(path, rgb, width, height, IMAGE_QOI, -1), "%s: save_image failed", name);
+    unsigned char *data = read_file(path, &size), *rgba = malloc(n * 4);
+    remove(path);
+    CHECK(data != NULL, "%s: cannot read back", name);
+    if (data) {
+        int ok = qoi_decode(data, size, width, height, rgba);
+        CHECK(ok, "%s: malformed QOI stream", name);
+        size_t bad = n;
+        for (size_t i = 0; ok && i < n && bad == n; i++)
+            if (memcmp(rgba + i * 4, rgb + i * 3, 3) != 0 || rgba[i * 4 + 3] != 255) bad = i;
+        CHECK(!ok || bad == n, "%s: pixel %zu decodes to %d,%d,%d,%d", name, bad,
+              rgba[bad * 4], rgba[bad * 4 + 1], rgba[bad * 4 + 2], rgba[bad * 4 + 3]);
+    }
+    free(data);
+    free(rgba);
+}
+
+int main(void) {
+    // Black after other colours and repeated. The image starts with another
+    // colour: a leading black is a run, which fills the decoder's index slot
+    static const unsigned char stripes[][3] = {
+        { 200, 10, 10 }, { 0, 0, 0 }, { 0, 0, 0 }, { 0, 0, 0 }, { 30, 240, 91 },
+        { 0, 0, 0 }, { 200, 10, 10 }, { 30, 240, 91 }, { 1, 1, 1 }, { 0, 0, 0 },
+    };
+    int w = 10, h = 7;
+    unsigned char *rgb = malloc((size_t)w * h * 3);
+    for (int i = 0; i < w * h; i++)
+        memcpy(rgb + (size_t)i * 3, stripes[(i * 7 + i / 3) % 10], 3);
+    check_round_trip("stripes", rgb, w, h);
+    free(rgb);
+
+    // A rendered frame: long black interior runs between smooth gradients
+    w = 320;
+    h = 200;
+    rgb = malloc((size_t)w * h * 3);
+    for (int palette = 0; palette < PALETTE_COUNT; palette++) {
+        char name[32];
+        FractalView view = { 200, -0.5, 0.0, 3.5, 0, 0.0, 0.0, palette };
+        render_tile(rgb, (size_t)w * 3, w, h, &view, 0, 0, w, h);
+        snprintf(name, sizeof(name), "palette %d", palette);
+        check_round_trip(name, rgb, w, h);
+    }
+    free(rgb);
+
+    printf("%s: %s\n", __FILE__, failures ? "FAILED" : "passed");
+    return failures ? 1 : 0;
+}
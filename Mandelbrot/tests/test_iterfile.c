@@ -0,0 +1,59 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include "iterfile.h"
+
+// Iteration files round trip, and headers with a forged tile size or
+// dimensions are rejected before anything is sized from them
+static int failures = 0;
+
+#define CHECK(cond, ...) do { \
+    if (!(cond)) { failures++; printf("FAIL %s:%d: ", __FILE__, __LINE__); printf(__VA_ARGS__); printf("\n"); } \
+} while (0)
+
+static const char *path = "test_iterfile.mbi";
+
+// Overwrites the header's int32 fields from width on: width, height, tile, tiles_x, tiles_y
+static void patch_header(const int32_t fields[5]) {
+    FILE *f = fopen(path, "r+b");
+    if (!f) return;
+    fseek(f, 8, SEEK_SET);
+    fwrite(fields, sizeof(int32_t), 5, f);
+    fclose(f);
+}
+
+int main(void) {
+    int w = 300, h = 200;
+    FractalView view = { 500, -0.5, 0.0, 3.5, 0, 0.0, 0.0, 0 };
+    uint32_t *iters = malloc((size_t)w * h * sizeof(uint32_t));
+    for (int y = 0; y < h; y++)
+        for (int x = 0; x < w; x++)
+            iters[(size_t)y * w + x] = (uint32_t)((x * x + 3 * y) % 501);
+
+    CHECK(iterfile_save(path, iters, w, h, &view), "iterfile_save failed");
+    int rw = 0, rh = 0;
+    uint32_t *back = iterfile_load(path, &rw, &rh, NULL);
+    CHECK(back && rw == w && rh == h && memcmp(back, iters, (size_t)w * h * sizeof(uint32_t)) == 0,
+          "round trip differs");
+    free(back);
+
+    static const struct { const char *what; int32_t fields[5]; } forged[] = {
+        { "huge tile", { 300, 200, INT_MAX, 1, 1 } },
+        { "large tile", { 300, 200, 1 << 20, 1, 1 } },
+        { "small tile", { 300, 200, 128, 3, 2 } },
+        { "width near INT_MAX", { INT_MAX - 10, 200, ITERFILE_TILE, (INT_MAX - 10) / ITERFILE_TILE + 1, 1 } },
+        { "tile counts", { 300, 200, ITERFILE_TILE, 1, 1 } },
+    };
+    for (size_t i = 0; i < sizeof(forged) / sizeof(forged[0]); i++) {
+        patch_header(forged[i].fields);
+        IterFile *f = iterfile_open(path, NULL, NULL, NULL);
+        CHECK(f == NULL, "header with %s accepted", forged[i].what);
+        if (f) iterfile_close(f);
+    }
+
+    remove(path);
+    free(iters);
+    printf("%s: %s\n", __FILE__, failures ? "FAILED" : "passed");
+    return failures ? 1 : 0;
+}
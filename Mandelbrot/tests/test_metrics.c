@@ -0,0 +1,60 @@
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include "metrics.h"
+
+// Slots of exited threads are reused without losing their counts: many more
+// short-lived threads than METRICS_MAX_THREADS, then a concurrent burst,
+// still add up exactly
+static int failures = 0;
+
+#define CHECK(cond, ...) do { \
+    if (!(cond)) { failures++; printf("FAIL %s:%d: ", __FILE__, __LINE__); printf(__VA_ARGS__); printf("\n"); } \
+} while (0)
+
+#define ADDS_PER_THREAD 10000
+
+static void *record(void *arg) {
+    (void)arg;
+    for (int i = 0; i < ADDS_PER_THREAD; i++) metrics_add(METRIC_CACHE_HITS, 1);
+    metrics_observe(METRIC_REQUEST_SECONDS, 1e-3);
+    return NULL;
+}
+
+static int run_threads(int count) {
+    pthread_t threads[64];
+    int started = 0;
+    for (int i = 0; i < count; i++)
+        if (pthread_create(&threads[started], NULL, record, NULL) == 0) started++;
+    for (int i = 0; i < started; i++) pthread_join(threads[i], NULL);
+    return started;
+}
+
+int main(void) {
+    uint64_t before = metrics_counter(METRIC_CACHE_HITS), expected = before;
+
+    // One at a time, so every thread after the first can take over a freed slot
+    for (int i = 0; i < 4 * METRICS_MAX_THREADS; i++) {
+        expected += (uint64_t)run_threads(1) * ADDS_PER_THREAD;
+        uint64_t now = metrics_counter(METRIC_CACHE_HITS);
+        if (now != expected) {
+            CHECK(now == expected, "after %d threads: %llu, expected %llu", i + 1,
+                  (unsigned long long)now, (unsigned long long)expected);
+            break;
+        }
+    }
+    expected += (uint64_t)run_threads(64) * ADDS_PER_THREAD;
+    CHECK(metrics_counter(METRIC_CACHE_HITS) == expected, "after a concurrent burst: %llu, expected %llu",
+          (unsigned long long)metrics_counter(METRIC_CACHE_HITS), (unsigned long long)expected);
+
+    char text[16384];
+    metrics_format(text, sizeof(text));
+    unsigned long long count = 0;
+    const char *line = text;
+    while ((line = strstr(line, "mandelbrot_request_seconds_count ")) != NULL)
+        sscanf(line++, "mandelbrot_request_seconds_count %llu", &count);
+    CHECK(count == (expected - before) / ADDS_PER_THREAD, "request histogram count %llu", count);
+
+    printf("%s: %s\n", __FILE__, failures ? "FAILED" : "passed");
+    return failures ? 1 : 0;
+}
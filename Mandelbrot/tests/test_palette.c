@@ -0,0 +1,116 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "palette.h"
+
+// The shared LUT cache keeps tables that are in use, reuses cached ones and
+// stays bounded in count and in bytes; equalization treats counts past max_iter as interior; the
+// colorize pass matches the table at every length
+static int failures = 0;
+
+#define CHECK(cond, ...) do { \
+    if (!(cond)) { failures++; printf("FAIL %s:%d: ", __FILE__, __LINE__); printf(__VA_ARGS__); printf("\n"); } \
+} while (0)
+
+static int matches_build(const uint32_t *lut, int palette, int max_iter) {
+    uint32_t *expected = palette_lut_build(palette, max_iter);
+    int same = expected && lut && memcmp(expected, lut, ((size_t)max_iter + 1) * sizeof(uint32_t)) == 0;
+    free(expected);
+    return same;
+}
+
+static void test_cache(void) {
+    const uint32_t *a = palette_lut(PALETTE_FIRE, 500), *b = palette_lut(PALETTE_FIRE, 500);
+    CHECK(a && a == b, "second lookup built a new table");
+    palette_lut_release(b);
+
+    // Many other tables come and go while a is held: a must survive them
+    const uint32_t *first = palette_lut(PALETTE_OCEAN, 1000);
+    CHECK(matches_build(first, PALETTE_OCEAN, 1000), "cached table differs from palette_lut_build");
+    palette_lut_release(first);
+    for (int i = 0; i < 4 * PALETTE_CACHE_ENTRIES; i++) {
+        const uint32_t *t = palette_lut(PALETTE_CLASSIC, 2000 + i);
+        CHECK(t != NULL, "palette_lut returned NULL");
+        palette_lut_release(t);
+    }
+    CHECK(matches_build(a, PALETTE_FIRE, 500), "held table changed or was freed");
+    const uint32_t *again = palette_lut(PALETTE_FIRE, 500);
+    CHECK(again == a, "held table was evicted");
+    palette_lut_release(again);
+    palette_lut_release(a);
+
+    // The recent tables are still cached, the old unreferenced one is not
+    const uint32_t *recent = palette_lut(PALETTE_CLASSIC, 2000 + 4 * PALETTE_CACHE_ENTRIES - 1);
+    const uint32_t *old = palette_lut(PALETTE_OCEAN, 1000);
+    CHECK(matches_build(old, PALETTE_OCEAN, 1000), "rebuilt table differs from palette_lut_build");
+    palette_lut_release(recent);
+    palette_lut_release(old);
+}
+
+static void test_cache_bytes(void) {
+    // Two idle tables of just over half the budget cannot both stay, and a
+    // table bigger than the whole budget stays only while it is held
+    int half = (int)(PALETTE_CACHE_BYTES / 2 / sizeof(uint32_t));
+    palette_lut_release(palette_lut(PALETTE_FIRE, half));
+    palette_lut_release(palette_lut(PALETTE_OCEAN, half));
+    CHECK(palette_cache_bytes() <= PALETTE_CACHE_BYTES, "idle tables hold %zu bytes", palette_cache_bytes());
+
+    int over = (int)(PALETTE_CACHE_BYTES / sizeof(uint32_t));
+    const uint32_t *big = palette_lut(PALETTE_GRAY, over);
+    CHECK(big != NULL, "palette_lut returned NULL");
+    CHECK(palette_cache_bytes() > PALETTE_CACHE_BYTES, "held table is not in the cache");
+    palette_lut_release(big);
+    CHECK(palette_cache_bytes() <= PALETTE_CACHE_BYTES, "released table still holds %zu bytes", palette_cache_bytes());
+}
+
+static void test_equalized_clamps(void) {
+    int max_iter = 10;
+    // Out-of-range counts (as from a damaged iteration buffer) land in the interior bin
+    uint32_t iters[] = { 0, 5, 50, 10, 3, 4000000000u, 9, 9 };
+    uint32_t clamped[] = { 0, 5, 10, 10, 3, 10, 9, 9 };
+    size_t count = sizeof(iters) / sizeof(iters[0]);
+    uint32_t *got = palette_lut_equalized(PALETTE_FIRE, iters, count, max_iter);
+    uint32_t *want = palette_lut_equalized(PALETTE_FIRE, clamped, count, max_iter);
+    CHECK(got && want, "palette_lut_equalized failed");
+    if (got && want)
+        CHECK(memcmp(got, want, ((size_t)max_iter + 1) * sizeof(uint32_t)) == 0,
+              "counts above max_iter were not treated as interior");
+    free(got);
+    free(want);
+}
+
+static void test_colorize(void) {
+    // Sizes around the 8-pixel vector step and the work block, with tails
+    static const size_t sizes[] = { 0, 1, 7, 8, 9, 4095, 4096, 4097, 100003 };
+    int max_iter = 700;
+    const uint32_t *lut = palette_lut(PALETTE_OCEAN, max_iter);
+    CHECK(lut != NULL, "palette_lut returned NULL");
+    for (size_t s = 0; lut && s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        size_t n = sizes[s];
+        uint32_t *iters = malloc((n + 1) * sizeof(uint32_t));
+        unsigned char *rgb = malloc(n * 3 + 1);
+        for (size_t i = 0; i < n; i++) iters[i] = (uint32_t)((i * 2654435761u) % (max_iter + 1));
+        rgb[n * 3] = 0xA5;  // guard byte past the end
+        colorize(rgb, iters, n, lut);
+        size_t bad = n;
+        for (size_t i = 0; i < n && bad == n; i++) {
+            uint32_t c = lut[iters[i]];
+            if (rgb[i * 3] != (c & 0xFF) || rgb[i * 3 + 1] != ((c >> 8) & 0xFF) || rgb[i * 3 + 2] != ((c >> 16) & 0xFF))
+                bad = i;
+        }
+        CHECK(bad == n, "colorize of %zu pixels wrong at pixel %zu", n, bad);
+        CHECK(rgb[n * 3] == 0xA5, "colorize of %zu pixels wrote past the end", n);
+        free(iters);
+        free(rgb);
+    }
+    palette_lut_release(lut);
+}
+
+int main(void) {
+    test_cache();
+    test_cache_bytes();
+    test_equalized_clamps();
+    test_colorize();
+    printf("%s: %s\n", __FILE__, failures ? "FAILED" : "passed");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,145 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <omp.h>
+#include "fractal.h"
+#include "palette.h"
+#include "render_async.h"
+
+// Async renders: results match the synchronous tiles, a cancel stops even
+// deep interior pixels quickly, a cancel after the last tile is not
+// reported as a cancelled job, and a palette table that cannot be allocated
+// fails the job instead of passing for a cancel
+static int failures = 0;
+
+#define CHECK(cond, ...) do { \
+    if (!(cond)) { failures++; printf("FAIL %s:%d: ", __FILE__, __LINE__); printf(__VA_ARGS__); printf("\n"); } \
+} while (0)
+
+static void test_matches_render_tile(int julia) {
+    int w = 200, h = 130;
+    FractalView view = { 300, -0.5, 0.0, 3.5, julia, -0.8, 0.156, 0 };
+    unsigned char *expected = malloc((size_t)w * h * 3), *image = calloc((size_t)w * h * 3, 1);
+    render_tile(expected, (size_t)w * 3, w, h, &view, 0, 0, w, h);
+
+    RenderJob *job = render_async_start(image, w, h, &view, NULL, NULL);
+    CHECK(job != NULL, "render_async_start failed");
+    if (job) {
+        CHECK(render_async_wait(job, -1) == RENDER_DONE, "job did not finish");
+        CHECK(render_async_progress(job) == 1.0, "progress %.3f at the end", render_async_progress(job));
+        CHECK(memcmp(expected, image, (size_t)w * h * 3) == 0, "%s async image differs from render_tile",
+              julia ? "julia" : "mandelbrot");
+        render_async_free(job);
+    }
+    free(expected);
+    free(image);
+}
+
+static void test_cancel_latency(void) {
+    // Inside the main cardioid every pixel runs to max_iter, tens of
+    // milliseconds each at this limit, so a poll between pixels alone would
+    // miss the bound below. The palette LUT is built first so the job is
+    // iterating when the cancel arrives
+    int w = 256, h = 256;
+    FractalView view = { 20000000, -0.2, 0.0, 0.2, 0, 0.0, 0.0, 0 };
+    unsigned char *image = malloc((size_t)w * h * 3);
+    const uint32_t *lut = palette_lut(palette_resolve(view.palette, view.julia), view.max_iter);
+    RenderJob *job = render_async_start(image, w, h, &view, NULL, NULL);
+    CHECK(job != NULL, "render_async_start failed");
+    if (job) {
+        struct timespec pause = { 0, 50 * 1000000L };
+        nanosleep(&pause, NULL);
+        double start = omp_get_wtime();
+        render_async_cancel(job);
+        int status = render_async_wait(job, 5.0);
+        double latency = omp_get_wtime() - start;
+        printf("cancel latency %.3f ms\n", latency * 1e3);
+        CHECK(status == RENDER_CANCELLED, "status %d after cancel", status);
+        CHECK(latency < 0.01, "cancel took %.3f ms", latency * 1e3);
+        render_async_free(job);
+    }
+    palette_lut_release(lut);
+    free(image);
+}
+
+typedef struct {
+    RenderJob *job;
+    int tiles, seen;
+} CancelAtEnd;
+
+// Cancels from the last tile's callback, after every tile has completed
+static void cancel_on_last_tile(void *user, int x0, int y0, int tile_w, int tile_h) {
+    (void)x0; (void)y0; (void)tile_w; (void)tile_h;
+    CancelAtEnd *c = user;
+    if (__atomic_add_fetch(&c->seen, 1, __ATOMIC_ACQ_REL) == c->tiles) {
+        RenderJob *job;
+        while (!(job = __atomic_load_n(&c->job, __ATOMIC_ACQUIRE))) {}
+        render_async_cancel(job);
+    }
+}
+
+static void test_cancel_after_last_tile(void) {
+    int w = 3 * RENDER_ASYNC_TILE, h = 2 * RENDER_ASYNC_TILE;
+    FractalView view = { 100, -0.5, 0.0, 3.5, 0, 0.0, 0.0, 0 };
+    unsigned char *image = malloc((size_t)w * h * 3);
+    CancelAtEnd c = { NULL, 6, 0 };
+    RenderJob *job = render_async_start(image, w, h, &view, cancel_on_last_tile, &c);
+    CHECK(job != NULL, "render_async_start failed");
+    if (job) {
+        __atomic_store_n(&c.job, job, __ATOMIC_RELEASE);
+        int status = render_async_wait(job, -1);
+        CHECK(status == RENDER_DONE, "status %d for a job whose tiles all finished", status);
+        render_async_free(job);
+    }
+    free(image);
+}
+
+static void count_tile(void *user, int x0, int y0, int tile_w, int tile_h) {
+    (void)x0; (void)y0; (void)tile_w; (void)tile_h;
+    __atomic_add_fetch((int *)user, 1, __ATOMIC_RELAXED);
+}
+
+static void test_failed_allocation(void) {
+    // The table for this max_iter is 8 GiB; an address space limit just
+    // above what the process already maps makes its allocation fail
+    int w = 4 * RENDER_ASYNC_TILE, h = 4 * RENDER_ASYNC_TILE, tiles = 0;
+    FractalView view = { INT_MAX - 1, -0.5, 0.0, 3.5, 0, 0.0, 0.0, 0 };
+    unsigned char *image = malloc((size_t)w * h * 3);
+    struct rlimit saved, limit;
+    long pages = 0;
+    FILE *f = fopen("/proc/self/statm", "r");
+    if (!f || fscanf(f, "%ld", &pages) != 1 || getrlimit(RLIMIT_AS, &saved) != 0) {
+        printf("skipping the allocation failure test\n");
+        if (f) fclose(f);
+        free(image);
+        return;
+    }
+    fclose(f);
+    limit = saved;
+    limit.rlim_cur = (rlim_t)pages * (rlim_t)sysconf(_SC_PAGESIZE) + ((rlim_t)1 << 30);
+    setrlimit(RLIMIT_AS, &limit);
+    RenderJob *job = render_async_start(image, w, h, &view, count_tile, &tiles);
+    CHECK(job != NULL, "render_async_start failed");
+    if (job) {
+        int status = render_async_wait(job, 5.0);
+        CHECK(status == RENDER_FAILED, "status %d when the palette table cannot be allocated", status);
+        CHECK(tiles == 0, "%d tiles reported as finished", tiles);
+        render_async_free(job);
+    }
+    setrlimit(RLIMIT_AS, &saved);
+    free(image);
+}
+
+int main(void) {
+    test_matches_render_tile(0);
+    test_matches_render_tile(1);
+    test_cancel_latency();
+    test_cancel_after_last_tile();
+    test_failed_allocation();
+    printf("%s: %s\n", __FILE__, failures ? "FAILED" : "passed");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,106 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "shm_ring.h"
+
+// A published frame reads back, and headers whose slot layout does not fit
+// the mapping are rejected by shm_ring_open
+static int failures = 0;
+
+#define CHECK(cond, ...) do { \
+    if (!(cond)) { failures++; printf("FAIL %s:%d: ", __FILE__, __LINE__); printf(__VA_ARGS__); printf("\n"); } \
+} while (0)
+
+static const char *name = "/mandelbrot_test_shm_ring";
+
+// Header fields after magic and slots: width, height (int32), then
+// frame_bytes, slot_stride, data_offset, map_size (uint64)
+typedef struct {
+    int32_t width, height;
+    uint64_t frame_bytes, slot_stride, data_offset, map_size;
+} Layout;
+
+static void patch_header(const Layout *layout) {
+    int fd = shm_open(name, O_RDWR, 0);
+    if (fd < 0) return;
+    unsigned char *map = mmap(NULL, 8 + sizeof(Layout), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return;
+    memcpy(map + 8, layout, sizeof(Layout));
+    munmap(map, 8 + sizeof(Layout));
+}
+
+int main(void) {
+    int w = 64, h = 48;
+    ShmRing *writer = shm_ring_create(name, w, h, SHM_RING_SLOTS);
+    CHECK(writer != NULL, "shm_ring_create failed");
+    if (!writer) {
+        printf("%s: FAILED\n", __FILE__);
+        return 1;
+    }
+    FractalView view = { 100, -0.5, 0.0, 3.5, 0, 0.0, 0.0, 0 };
+    unsigned char *pixels = shm_ring_acquire(writer);
+    memset(pixels, 0x5a, (size_t)w * h * 3);
+    shm_ring_publish(writer, 7, &view);
+
+    ShmRing *reader = shm_ring_open(name);
+    ShmFrame frame;
+    CHECK(reader != NULL, "shm_ring_open rejected a valid ring");
+    if (reader) {
+        CHECK(shm_ring_latest(reader, &frame) && frame.frame == 7 && frame.pixels[0] == 0x5a
+              && shm_ring_valid(reader, &frame), "published frame does not read back");
+        shm_ring_close(reader);
+    }
+
+    Layout good;
+    int fd = shm_open(name, O_RDONLY, 0);
+    struct stat st;
+    CHECK(fd >= 0 && fstat(fd, &st) == 0, "cannot stat the ring");
+    if (fd >= 0) close(fd);
+    uint64_t frame_bytes = (uint64_t)w * h * 3, size = (uint64_t)st.st_size;
+    good.width = w;
+    good.height = h;
+    good.frame_bytes = frame_bytes;
+    good.slot_stride = (frame_bytes + 4095) / 4096 * 4096;
+    good.data_offset = size - good.slot_stride * SHM_RING_SLOTS;
+    good.map_size = size;
+    patch_header(&good);
+    reader = shm_ring_open(name);
+    CHECK(reader != NULL, "restored header rejected");
+    if (reader) shm_ring_close(reader);
+
+    static const struct { const char *what; int field; uint64_t value; } forged[] = {
+        { "data inside the slot metadata", 4, 64 },
+        { "data offset past the end", 4, UINT64_MAX - 4096 },
+        { "slot stride below a frame", 3, 4096 },
+        { "slots past the end", 3, 1 << 20 },
+        { "slot stride overflowing", 3, UINT64_MAX / 2 },
+        { "frame bytes not width * height * 3", 2, 64 * 48 },
+        { "width that disagrees with frame bytes", 0, 4096 },
+        { "negative height", 1, (uint64_t)-48 },
+    };
+    for (size_t i = 0; i < sizeof(forged) / sizeof(forged[0]); i++) {
+        Layout bad = good;
+        switch (forged[i].field) {
+        case 0: bad.width = (int32_t)forged[i].value; break;
+        case 1: bad.height = (int32_t)forged[i].value; break;
+        case 2: bad.frame_bytes = forged[i].value; break;
+        case 3: bad.slot_stride = forged[i].value; break;
+        default: bad.data_offset = forged[i].value; break;
+        }
+        patch_header(&bad);
+        reader = shm_ring_open(name);
+        CHECK(reader == NULL, "header with %s accepted", forged[i].what);
+        if (reader) shm_ring_close(reader);
+    }
+
+    shm_ring_close(writer);
+    shm_ring_unlink(name);
+    printf("%s: %s\n", __FILE__, failures ? "FAILED" : "passed");
+    return failures ? 1 : 0;
+}